@@ -1,6 +1,7 @@
 #include "AudioEngine.h"
 #include "client/audio/AecProcessor.h"
 #include "constants.h"
+#include "utils/Logger.h"
 
 #include <QAudioDevice>
 #include <QAudioSink>
@@ -185,7 +186,7 @@ void AudioEngine::onCaptureReadyRead() {
         }
 
         if (shouldTransmit() && outgoingVoiceCallback_) {
-            qDebug() << "Captured frame size:" << processed.size();
+            VOIP_LOG_DEBUG("Capture", "frame", {{"bytes", processed.size()}});
             outgoingVoiceCallback_(processed);
         }
     }
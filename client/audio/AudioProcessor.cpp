@@ -7,10 +7,20 @@
 #include <cmath>
 #include <speex/speex_echo.h>
 
+#include "shared/protocol/network_packet.h"
+#include "utils/Logger.h"
+
 namespace {
 // Temporary safety switch: disable aggressive input DSP that can suppress
 // near-end speech in same-machine dual-client testing.
 constexpr bool kEnableInputProcessing = false;
+
+// Energy VAD used for the packet's audio level byte: a frame is voice when
+// it is this much louder than the tracked noise floor and not quieter than
+// kVoiceMaxDbov, and voice is held for kVoiceHangoverFrames after that.
+constexpr float kVoiceAboveFloorDb = 12.0f;
+constexpr uint8_t kVoiceMaxDbov = 60;
+constexpr int kVoiceHangoverFrames = 10; // 200 ms
 }
 
 AudioProcessor::AudioProcessor(NetworkMode mode)
@@ -32,6 +42,7 @@ AudioProcessor::AudioProcessor(NetworkMode mode)
     if (preprocessor_enabled_) {
         preprocessor_.setDenoise(true);
         preprocessor_.setNoiseSuppress(-20);
+        preprocessor_.setVAD(true);
     }
 
     // 100 ms tail at 48 kHz (tune 2048..8192 if needed).
@@ -82,9 +93,11 @@ void AudioProcessor::start() {
             if (kEnableInputProcessing) {
                 ns_.process(local, FRAME_SIZE, 1);
             }
+            bool speech = true;
             if (kEnableInputProcessing && preprocessor_enabled_) {
-                preprocessor_.run(local);
+                speech = preprocessor_.run(local);
             }
+            const uint8_t audio_level = measure_audio_level(local, speech);
 
             if (loopback_enabled_.load()) {
                 std::lock_guard<std::mutex> lock(loopback_mutex_);
@@ -106,7 +119,7 @@ void AudioProcessor::start() {
                         std::lock_guard<std::mutex> lock(positional_mutex_);
                         pos = positional_data_;
                     }
-                    if (send_cb_(seq, ts, encoded, static_cast<size_t>(encoded_len), has_pos, pos.data())) {
+                    if (send_cb_(seq, ts, encoded, static_cast<size_t>(encoded_len), has_pos, pos.data(), audio_level)) {
                         ++seq_counter_;
                         timestamp_ += FRAME_SIZE;
                     }
@@ -181,6 +194,28 @@ void AudioProcessor::on_packet(uint32_t ssrc, uint16_t seq, const uint8_t* data,
     }
 }
 
+uint8_t AudioProcessor::measure_audio_level(const int16_t* pcm, bool speech) {
+    const uint8_t level = audio_level_dbov(pcm, FRAME_SIZE);
+
+    // The floor follows quieter frames at once and creeps down (louder)
+    // slowly, so steady background noise becomes the new floor while speech
+    // bursts do not.
+    const float dbov = static_cast<float>(level);
+    if (dbov > noise_floor_dbov_) {
+        noise_floor_dbov_ = dbov;
+    } else {
+        noise_floor_dbov_ -= 0.02f; // 1 dB per second
+    }
+
+    const bool loud = level <= kVoiceMaxDbov && dbov + kVoiceAboveFloorDb <= noise_floor_dbov_;
+    if (speech && loud) {
+        voice_hangover_ = kVoiceHangoverFrames;
+    } else if (voice_hangover_ > 0) {
+        --voice_hangover_;
+    }
+    return make_audio_level(level, voice_hangover_ > 0);
+}
+
 int AudioProcessor::get_encoded_audio(uint8_t* out_buffer) {
     if (!out_buffer) return -1;
     
@@ -214,20 +249,19 @@ void AudioProcessor::get_decoded_audio(int16_t* pcm_out) {
     std::vector<uint8_t> encoded_pkt;
     
     if (jitter_.pop(encoded_pkt)) {
-        std::cout << "[RX-JB] Popped! len=" << encoded_pkt.size()
-                  << " | buffer now=" << jitter_.get_buffer_size()
-                  << " | lost so far=" << jitter_.get_lost_packets() << std::endl;
+        VOIP_LOG_DEBUG("RX-JB", "popped", {{"len", encoded_pkt.size()},
+                                           {"buffered", jitter_.get_buffer_size()},
+                                           {"lost", jitter_.get_lost_packets()}});
         int decoded = codec_.decode(encoded_pkt.data(), encoded_pkt.size(), pcm_out);
         if (decoded < 0) {
-            std::cout << "[RX-DECODE] FAILED! error=" << decoded << " -> silence" << std::endl;
+            VOIP_LOG_WARN_RATE(5, "RX-DECODE", "decode failed, playing silence", {{"error", decoded}});
             std::fill(pcm_out, pcm_out + FRAME_SIZE, 0);
         } else {
-            std::cout << "[RX-DECODE] SUCCESS - decoded " << decoded << " samples" << std::endl;
+            VOIP_LOG_DEBUG("RX-DECODE", "decoded", {{"samples", decoded}});
         }
     } else {
-        std::cout << "[RX-JB] STARVED! No packet available (PLC/silence) | buffer="
-                  << jitter_.get_buffer_size()
-                  << " lost=" << jitter_.get_lost_packets() << std::endl;
+        VOIP_LOG_DEBUG_RATE(5, "RX-JB", "starved, concealing", {{"buffered", jitter_.get_buffer_size()},
+                                                                 {"lost", jitter_.get_lost_packets()}});
         codec_.decode(nullptr, 0, pcm_out);
     }
 
@@ -238,9 +272,9 @@ void AudioProcessor::get_decoded_audio(int16_t* pcm_out) {
     }
     rms = std::sqrt(rms / FRAME_SIZE);
     if (rms > 0.001f) {
-        std::cout << "[PLAY-PCM] Non-silent frame! RMS = " << rms << std::endl;
+        VOIP_LOG_DEBUG("PLAY-PCM", "frame", {{"rms", rms}});
     } else if (rms > 0.00001f) {
-        std::cout << "[PLAY-PCM] Very quiet frame RMS = " << rms << std::endl;
+        VOIP_LOG_DEBUG("PLAY-PCM", "quiet frame", {{"rms", rms}});
     }
     
     // Simple distance attenuation for positional audio
@@ -289,9 +323,11 @@ void AudioProcessor::capture_loop() {
         if (kEnableInputProcessing) {
             ns_.process(pcm, FRAME_SIZE, 1);
         }
+        bool speech = true;
         if (kEnableInputProcessing && preprocessor_enabled_) {
-            preprocessor_.run(pcm);
+            speech = preprocessor_.run(pcm);
         }
+        const uint8_t audio_level = measure_audio_level(pcm, speech);
         
         // Encode
         int encoded_len = codec_.encode(pcm, encoded);
@@ -308,7 +344,7 @@ void AudioProcessor::capture_loop() {
                     std::lock_guard<std::mutex> lock(positional_mutex_);
                     pos = positional_data_;
                 }
-                if (send_cb_(seq, ts, encoded, static_cast<size_t>(encoded_len), has_pos, pos.data())) {
+                if (send_cb_(seq, ts, encoded, static_cast<size_t>(encoded_len), has_pos, pos.data(), audio_level)) {
                     ++seq_counter_;
                     timestamp_ += FRAME_SIZE;
                 }
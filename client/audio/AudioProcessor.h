@@ -46,9 +46,11 @@ public:
     int get_encoded_audio(uint8_t* out_buffer);
     
     // Set callback to send encoded audio to network
+    // audio_level = RFC 6464 style level + VAD byte of the frame (network_packet.h)
     using SendCallback = std::function<bool(uint16_t seq, uint32_t timestamp,
                                             const uint8_t* data, size_t len,
-                                            bool has_positional, const float* position)>;
+                                            bool has_positional, const float* position,
+                                            uint8_t audio_level)>;
     void set_send_callback(SendCallback cb);
 
     // === PLAYBACK SIDE ===
@@ -69,6 +71,10 @@ public:
     bool is_microphone_enabled() const;
 
 private:
+    // Level + voice activity byte for one captured frame. `speech` is the
+    // preprocessor's VAD decision, or true when it did not run.
+    uint8_t measure_audio_level(const int16_t* pcm, bool speech);
+
     OpusCodec codec_;
     JitterBuffer jitter_;
     SpeexEchoState_* aec_state_ = nullptr;
@@ -76,6 +82,8 @@ private:
     NoiseSuppressor ns_;
     AudioPreprocessor preprocessor_;
     bool preprocessor_enabled_ = false;
+    float noise_floor_dbov_ = 60.0f; // Tracked -dBov of the quietest recent frames
+    int voice_hangover_ = 0;         // Frames still reported as voice after speech ends
 
     std::atomic<bool> running_;
     std::thread capture_thread_;
@@ -10,6 +10,7 @@ INCLUDEPATH += \
     $$PWD/audio \
     $$PWD/qt/src \
     $$PWD/webrtc \
+    $$PWD/../shared \
     $$PWD/../shared/protocol \
     $$PWD/../thirdparty/opus \
     $$PWD/../thirdparty/speexdsp/include \
@@ -30,7 +31,8 @@ HEADERS += \
     $$PWD/webrtc/network.h \
     $$PWD/webrtc/control_client.h \
     $$PWD/webrtc/AudioTransportShim.h \
-    $$PWD/../shared/protocol/control_protocol.h
+    $$PWD/../shared/protocol/control_protocol.h \
+    $$PWD/../shared/utils/Logger.h
 
 SOURCES += \
     $$PWD/audio/AudioProcessor.cpp \
@@ -45,7 +47,8 @@ SOURCES += \
     $$PWD/qt/src/main.cpp \
     $$PWD/qt/src/MainWindow.cpp \
     $$PWD/webrtc/network.cpp \
-    $$PWD/webrtc/control_client.cpp
+    $$PWD/webrtc/control_client.cpp \
+    $$PWD/../shared/utils/Logger.cpp
 
 SOURCES += \
     $$PWD/../thirdparty/speexdsp/libspeexdsp/buffer.c \
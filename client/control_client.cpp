@@ -24,6 +24,10 @@ constexpr int kReconnectBackoffMinMs = 1000;
 constexpr int kReconnectBackoffMaxMs = 16000;
 constexpr int kClientKeepaliveIntervalMs = 3000;
 constexpr int kClientKeepaliveMissLimit = 2;
+// Playout runs 40 ms behind the first frame and conceals a frame 20 ms after
+// it is due, so a retransmit has roughly that long to arrive.
+constexpr int kNackMaxRttMs = 50;
+constexpr int kNackMaxFrames = 17; // First sequence plus a 16-bit mask
 } // namespace
 
 ControlClient::ControlClient(QObject *parent)
@@ -567,19 +571,33 @@ void ControlClient::handleIncomingVoice(const ctrlproto::VoicePacket &packet) {
         state.initialized = true;
         state.activeLayer = layer;
         state.expectedSeq = packet.sequence;
+        state.highestSeq = static_cast<uint16_t>(packet.sequence - 1);
         state.nextExpectedTsMs = packet.timestampMs;
     }
 
+    // Frames already played or concealed are of no use, retransmitted or not.
+    if (static_cast<int16_t>(packet.sequence - state.expectedSeq) < 0) {
+        return;
+    }
+    const int ahead = static_cast<int16_t>(packet.sequence - state.highestSeq);
+    if (ahead > 1) {
+        requestRetransmit(packet.ssrc, state, static_cast<uint16_t>(state.highestSeq + 1), ahead - 1);
+    }
+
     const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
-    if (state.havePrevTiming) {
-        const qint64 arrivalDelta = nowMs - state.prevArrivalMs;
-        const qint64 remoteDelta = static_cast<qint64>(static_cast<qint32>(packet.timestampMs - state.prevRemoteTsMs));
-        const double d = std::abs(static_cast<double>(arrivalDelta - remoteDelta));
-        state.jitterMs += (d - state.jitterMs) / 16.0;
+    // Out-of-order frames and retransmits say nothing about path jitter.
+    if (ahead > 0) {
+        state.highestSeq = packet.sequence;
+        if (state.havePrevTiming) {
+            const qint64 arrivalDelta = nowMs - state.prevArrivalMs;
+            const qint64 remoteDelta = static_cast<qint64>(static_cast<qint32>(packet.timestampMs - state.prevRemoteTsMs));
+            const double d = std::abs(static_cast<double>(arrivalDelta - remoteDelta));
+            state.jitterMs += (d - state.jitterMs) / 16.0;
+        }
+        state.havePrevTiming = true;
+        state.prevArrivalMs = nowMs;
+        state.prevRemoteTsMs = packet.timestampMs;
     }
-    state.havePrevTiming = true;
-    state.prevArrivalMs = nowMs;
-    state.prevRemoteTsMs = packet.timestampMs;
 
     if (!state.pendingFrames.contains(packet.sequence)) {
         state.pendingFrames.insert(packet.sequence, QueuedVoiceFrame{
@@ -588,6 +606,29 @@ void ControlClient::handleIncomingVoice(const ctrlproto::VoicePacket &packet) {
     flushJitterBuffer(packet.ssrc, state, nowMs);
 }
 
+void ControlClient::requestRetransmit(uint32_t ssrc, const VoiceJitterState &state, uint16_t firstMissing, int count) {
+    if (rttEstimateMs_ > kNackMaxRttMs || !joined_) {
+        return;
+    }
+    // Only the newest frames of a long gap can still make their playout slot.
+    if (count > kNackMaxFrames) {
+        firstMissing = static_cast<uint16_t>(firstMissing + (count - kNackMaxFrames));
+        count = kNackMaxFrames;
+    }
+    uint32_t mask = 0;
+    for (int i = 1; i < count; ++i) {
+        mask |= 1u << (i - 1);
+    }
+
+    QJsonObject request;
+    request.insert(QStringLiteral("type"), QStringLiteral("nack"));
+    request.insert(QStringLiteral("source_ssrc"), static_cast<double>(ssrc));
+    request.insert(QStringLiteral("layer"), static_cast<int>(state.activeLayer));
+    request.insert(QStringLiteral("seq"), static_cast<int>(firstMissing));
+    request.insert(QStringLiteral("mask"), static_cast<int>(mask));
+    sendPacket(request);
+}
+
 void ControlClient::flushJitterBuffer(uint32_t ssrc, VoiceJitterState &state, qint64 nowMs) {
     auto emitDecoded = [this, ssrc](const QueuedVoiceFrame &frame) {
         QByteArray pcm;
@@ -909,7 +950,8 @@ void ControlClient::trySendDeferredActions() {
 }
 
 void ControlClient::pruneVoiceStateForUsers(const std::vector<CtrlUserInfo> &users) {
-    QSet<uint32_t> activeRemoteSsrcs;
+    // A mixing server's stream belongs to no user but lives as long as the room.
+    QSet<uint32_t> activeRemoteSsrcs{hybridctrl::kMixedSourceSsrc};
     for (const CtrlUserInfo &user : users) {
         if (user.online == 0 || user.ssrc == 0 || user.ssrc == localSsrc_) {
             continue;
@@ -15,6 +15,7 @@
 
 class ControlClient : public QObject {
     Q_OBJECT
+    friend struct HotPathBenchAccess; // tools/bench/hotpath_bench.cpp
 
 public:
     explicit ControlClient(QObject *parent = nullptr);
@@ -85,6 +86,7 @@ private:
         bool initialized = false;
         uint8_t activeLayer = ctrlproto::kVoiceLayerHigh;
         uint16_t expectedSeq = 0;
+        uint16_t highestSeq = 0;
         bool playoutAnchored = false;
         uint32_t anchorRemoteTsMs = 0;
         qint64 anchorLocalMs = 0;
@@ -102,6 +104,7 @@ private:
 
     void handleIncomingVoice(const ctrlproto::VoicePacket &packet);
     void flushJitterBuffer(uint32_t ssrc, VoiceJitterState &state, qint64 nowMs);
+    void requestRetransmit(uint32_t ssrc, const VoiceJitterState &state, uint16_t firstMissing, int count);
     void onPlayoutTick();
     void onFeedbackTick();
     void sendVoiceFeedback(uint32_t sourceSsrc, int lossPct, int jitterMs, int plcPct, int fecPct);
@@ -260,7 +260,8 @@ void MainWindow::initMediaEngine() {
         );
 
         audioEngine_->set_send_callback(
-            [this](uint16_t seq, uint32_t ts, const uint8_t* data, size_t len, bool hasPositional, const float* position) {
+            [this](uint16_t seq, uint32_t ts, const uint8_t* data, size_t len, bool hasPositional, const float* position,
+                   uint8_t audioLevel) {
                 if (!networkEngine_ || !mediaConnected_) {
                     return false;
                 }
@@ -277,7 +278,7 @@ void MainWindow::initMediaEngine() {
                     return false;
                 }
 
-                return networkEngine_->send_audio(seq, ts, data, len, localSsrc_, hasPositional, position);
+                return networkEngine_->send_audio(seq, ts, data, len, localSsrc_, hasPositional, position, audioLevel);
             }
         );
 
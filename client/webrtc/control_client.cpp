@@ -6,6 +6,7 @@
 #include <chrono>
 #include <cstdio>
 #include <limits>
+#include <algorithm>
 #ifndef _WIN32
 #include <cerrno>
 #endif
@@ -290,9 +291,25 @@ void ControlClient::recv_loop() {
             if (sent_at != 0 && now >= sent_at) {
                 last_rtt_ms_.store(static_cast<uint32_t>(now - sent_at));
             }
+            if (hdr.size >= sizeof(CtrlPong) && n >= (int)(sizeof(hdr) + sizeof(CtrlPong))) {
+                CtrlPong pong{};
+                std::memcpy(&pong, buf + sizeof(hdr), sizeof(pong));
+                if (presence_synced_ && pong.presence_version != presence_version_) {
+                    request_presence_resync();
+                }
+            }
             continue;
         }
 
+        const size_t payload_size = std::min<size_t>(hdr.size, static_cast<size_t>(n) - sizeof(hdr));
+        if (hdr.type == CtrlType::USER_SNAPSHOT) {
+            handle_user_snapshot(buf + sizeof(hdr), payload_size);
+        }
+
+        if (hdr.type == CtrlType::USER_DELTA) {
+            handle_user_delta(buf + sizeof(hdr), payload_size);
+        }
+
         if (hdr.type == CtrlType::USER_LIST && hdr.size >= sizeof(CtrlUserList)) {
             const uint8_t* payload = buf + sizeof(hdr);
             CtrlUserList list{};
@@ -342,6 +359,110 @@ void ControlClient::recv_loop() {
     }
 }
 
+void ControlClient::handle_user_snapshot(const uint8_t* payload, size_t size) {
+    if (size < sizeof(CtrlUserSnapshot)) {
+        return;
+    }
+    CtrlUserSnapshot snap{};
+    std::memcpy(&snap, payload, sizeof(snap));
+    if (snap.fragment_count == 0 || snap.fragment >= snap.fragment_count ||
+        size < sizeof(snap) + snap.count * sizeof(CtrlUserInfo)) {
+        return;
+    }
+    if (presence_synced_ && snap.version < presence_version_) {
+        return; // Older than what deltas already gave us.
+    }
+
+    if (snap.version != snapshot_version_ || snap.fragment_count != snapshot_fragment_count_ ||
+        snapshot_seen_.empty()) {
+        snapshot_version_ = snap.version;
+        snapshot_fragment_count_ = snap.fragment_count;
+        snapshot_seen_.assign(snap.fragment_count, 0);
+        snapshot_users_.clear();
+    }
+    if (snapshot_seen_[snap.fragment]) {
+        return;
+    }
+    snapshot_seen_[snap.fragment] = 1;
+
+    const uint8_t* p = payload + sizeof(snap);
+    for (uint16_t i = 0; i < snap.count; ++i) {
+        CtrlUserInfo ui{};
+        std::memcpy(&ui, p, sizeof(ui));
+        snapshot_users_.push_back(ui);
+        p += sizeof(ui);
+    }
+
+    for (uint8_t seen : snapshot_seen_) {
+        if (!seen) {
+            return;
+        }
+    }
+
+    presence_.clear();
+    for (const CtrlUserInfo& ui : snapshot_users_) {
+        presence_[ui.ssrc] = ui;
+    }
+    presence_version_ = snapshot_version_;
+    presence_synced_ = true;
+    snapshot_seen_.clear();
+    snapshot_users_.clear();
+    publish_presence();
+}
+
+void ControlClient::handle_user_delta(const uint8_t* payload, size_t size) {
+    if (size < sizeof(CtrlUserDelta)) {
+        return;
+    }
+    CtrlUserDelta delta{};
+    std::memcpy(&delta, payload, sizeof(delta));
+    if (size < sizeof(delta) + delta.count * sizeof(CtrlUserChange)) {
+        return;
+    }
+    if (!presence_synced_ || delta.base_version != presence_version_) {
+        // Duplicates of deltas already applied are harmless; anything newer
+        // means we missed one.
+        if (!presence_synced_ || delta.version > presence_version_) {
+            request_presence_resync();
+        }
+        return;
+    }
+
+    const uint8_t* p = payload + sizeof(delta);
+    for (uint16_t i = 0; i < delta.count; ++i) {
+        CtrlUserChange change{};
+        std::memcpy(&change, p, sizeof(change));
+        p += sizeof(change);
+        if (change.op == CtrlPresenceOp::LEAVE) {
+            presence_.erase(change.user.ssrc);
+        } else {
+            presence_[change.user.ssrc] = change.user;
+        }
+    }
+    presence_version_ = delta.version;
+    publish_presence();
+}
+
+void ControlClient::request_presence_resync() {
+    // One outstanding LIST per second is plenty; the snapshot answers it.
+    const uint64_t now = now_ms();
+    if (now - last_resync_ms_ < 1000) {
+        return;
+    }
+    last_resync_ms_ = now;
+    request_user_list();
+}
+
+void ControlClient::publish_presence() {
+    std::vector<CtrlUserInfo> users;
+    users.reserve(presence_.size());
+    for (const auto& [_, ui] : presence_) {
+        users.push_back(ui);
+    }
+    std::lock_guard<std::mutex> lock(cb_mutex_);
+    if (user_cb_) user_cb_(users);
+}
+
 void ControlClient::heartbeat_loop() {
     const int interval_ms = 1000;
     const int warn_ms = 8000;
@@ -4,6 +4,7 @@
 
 #include <atomic>
 #include <functional>
+#include <map>
 #include <mutex>
 #include <string>
 #include <thread>
@@ -67,8 +68,23 @@ private:
     UserListCallback user_cb_;
     TalkUpdateCallback talk_cb_;
 
+    // Presence replica, touched only by recv_loop(). Kept in sync through
+    // USER_DELTA; a version gap triggers a LIST and a fresh USER_SNAPSHOT.
+    std::map<uint32_t, CtrlUserInfo> presence_;
+    uint32_t presence_version_ = 0;
+    bool presence_synced_ = false;
+    uint64_t last_resync_ms_ = 0;
+    uint32_t snapshot_version_ = 0;
+    uint16_t snapshot_fragment_count_ = 0;
+    std::vector<uint8_t> snapshot_seen_;
+    std::vector<CtrlUserInfo> snapshot_users_;
+
     bool send_packet(const void* data, size_t size);
     void recv_loop();
+    void handle_user_snapshot(const uint8_t* payload, size_t size);
+    void handle_user_delta(const uint8_t* payload, size_t size);
+    void request_presence_resync();
+    void publish_presence();
     void heartbeat_loop();
     uint64_t now_ms() const;
 };
@@ -26,6 +26,8 @@
 #include <chrono>
 #include <thread>
 
+#include "utils/Logger.h"
+
 NetworkEngine::NetworkEngine()
     : socket_(INVALID_SOCKET),
       remote_port_(0),
@@ -153,7 +155,8 @@ bool NetworkEngine::send_audio(uint16_t seq, uint32_t timestamp,
                               const uint8_t* payload, size_t len,
                               uint32_t ssrc,
                               bool has_positional,
-                              const float* position) {
+                              const float* position,
+                              int audio_level) {
     if (socket_ == INVALID_SOCKET || !payload || len == 0) {
         return false;
     }
@@ -165,6 +168,10 @@ bool NetworkEngine::send_audio(uint16_t seq, uint32_t timestamp,
     pkt.timestamp = timestamp;
     pkt.payload_len = static_cast<uint16_t>(len);
     pkt.flags = has_positional ? AUDIO_FLAG_POSITIONAL : 0;
+    if (audio_level >= 0) {
+        pkt.flags |= AUDIO_FLAG_AUDIO_LEVEL;
+        pkt.audio_level = static_cast<uint8_t>(audio_level);
+    }
     if (has_positional && position) {
         pkt.position[0] = position[0];
         pkt.position[1] = position[1];
@@ -267,15 +274,15 @@ void NetworkEngine::receive_loop() {
         int recv_len = recvfrom(socket_, (char*)&recv_pkt, sizeof(recv_pkt), 0,
                                (sockaddr*)&sender_addr, &sender_len);
         if (recv_len > 0) {
-            std::cout << "[RX-RAW] recvfrom got " << recv_len << " bytes from "
-                      << inet_ntoa(sender_addr.sin_addr) << ":" << ntohs(sender_addr.sin_port)
-                      << std::endl;
+            VOIP_LOG_DEBUG("RX-RAW", "recvfrom", {{"bytes", recv_len},
+                                                  {"from", inet_ntoa(sender_addr.sin_addr)},
+                                                  {"port", ntohs(sender_addr.sin_port)}});
         }
 #ifdef _WIN32
         else if (recv_len < 0) {
             const int wsa_err = WSAGetLastError();
             if (wsa_err != WSAEWOULDBLOCK) {
-                std::cout << "[RX-RAW] recvfrom error: " << wsa_err << std::endl;
+                VOIP_LOG_WARN_RATE(1, "RX-RAW", "recvfrom error", {{"wsa_error", wsa_err}});
             }
         }
 #endif
@@ -290,24 +297,23 @@ void NetworkEngine::receive_loop() {
                 pkts_recv_++;
                 bytes_recv_ += recv_len;
                 ++audio_recv_count;
-                if ((audio_recv_count % 100) == 1) {
-                    std::cout << "[Network] Audio recv: ssrc=" << recv_pkt.ssrc
-                              << " seq=" << recv_pkt.seq
-                              << " payload=" << payload_len
-                              << " total=" << audio_recv_count << "\n";
-                }
+                VOIP_LOG_INFO_RATE(1, "Network", "audio recv", {{"ssrc", recv_pkt.ssrc},
+                                                                {"seq", recv_pkt.seq},
+                                                                {"payload", payload_len},
+                                                                {"total", audio_recv_count}});
 
                 // Callback to audio engine
+                const bool has_pos = (recv_pkt.flags & AUDIO_FLAG_POSITIONAL) != 0;
                 {
                     std::lock_guard<std::mutex> lock(cb_mutex_);
                     if (packet_cb_) {
-                        const bool has_pos = (recv_pkt.flags & AUDIO_FLAG_POSITIONAL) != 0;
                         packet_cb_(recv_pkt.ssrc, recv_pkt.seq, recv_pkt.payload, payload_len, has_pos, recv_pkt.position);
-                        std::cout << "[RX-NET] PACKET ARRIVED! SSRC=" << recv_pkt.ssrc
-                                  << " seq=" << recv_pkt.seq << " payload_len=" << payload_len
-                                  << " has_pos=" << (has_pos ? "yes" : "no") << std::endl;
                     }
                 }
+                VOIP_LOG_DEBUG("RX-NET", "packet", {{"ssrc", recv_pkt.ssrc},
+                                                    {"seq", recv_pkt.seq},
+                                                    {"payload", payload_len},
+                                                    {"has_pos", has_pos}});
             }
         }
 
@@ -43,7 +43,8 @@ public:
                    const uint8_t* payload, size_t len,
                    uint32_t ssrc = 0,
                    bool has_positional = false,
-                   const float* position = nullptr);
+                   const float* position = nullptr,
+                   int audio_level = -1); // -1 = not measured, else the AudioPacket::audio_level byte
 
     // Send a header-only UDP probe so server learns this client's audio endpoint.
     bool send_probe(uint32_t ssrc = 0);
@@ -9,6 +9,7 @@
 #include <QTcpSocket>
 
 #include <algorithm>
+#include <limits>
 
 #include "shared/protocol/control_protocol.h"
 #include "shared/protocol/control_wire.h"
@@ -17,16 +18,99 @@
 namespace {
 constexpr qint64 kStaleMs = 15000;
 constexpr qint64 kActiveSpeakerWindowMs = 2500;
+// A receiver's speaker keeps its slot this long whatever else happens, and
+// after that only gives it up to someone voiced this much more recently.
+constexpr qint64 kSpeakerHoldMs = 2000;
+constexpr qint64 kSpeakerHysteresisMs = 750;
 constexpr qint64 kServerPingIntervalMs = 5000;
 constexpr qint64 kKeepaliveMissWindowMs = (kServerPingIntervalMs * 2) + 500;
+constexpr qint64 kLivenessTickMs = 250;
+constexpr int kForwardIndexRefreshMs = 100;
+constexpr int kNackMaskBits = 16;
+constexpr double kNackRatePerSec = 50.0; // Requested sequences per receiver
+constexpr double kNackBurst = 25.0;
+
+
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+constexpr ControlWireFormat kControlWireFormat = ControlWireFormat::Protobuf;
+constexpr size_t kControlArenaBlockBytes = 4096; // One read's worth of envelopes, usually
+#else
+constexpr ControlWireFormat kControlWireFormat = ControlWireFormat::Json;
+#endif
+
+sockaddr_in toSockaddr(const QHostAddress &addr, quint16 port) {
+    sockaddr_in out{};
+    out.sin_family = AF_INET;
+    out.sin_addr.s_addr = htonl(addr.toIPv4Address());
+    out.sin_port = htons(port);
+    return out;
+}
+
+// Empty if the message cannot be encoded.
+QByteArray controlLine(const QJsonObject &obj) {
+    QByteArray line = controlwire::encode(obj, kControlWireFormat);
+    if (!line.isEmpty()) {
+        line.append('\n');
+    }
+    return line;
+}
+
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+QByteArray controlLine(const nox::control::v1::ControlEnvelope &env) {
+    QByteArray line = controlwire::encode(env, kControlWireFormat);
+    if (!line.isEmpty()) {
+        line.append('\n');
+    }
+    return line;
+}
+
+QByteArray pingLine(quint64 pingId) {
+    nox::control::v1::ControlEnvelope env;
+    env.mutable_ping()->set_ping_id(pingId);
+    return controlLine(env);
+}
+
+QByteArray pongLine(quint64 pingId) {
+    nox::control::v1::ControlEnvelope env;
+    env.mutable_pong()->set_ping_id(pingId);
+    return controlLine(env);
+}
+#else
+QByteArray pingLine(quint64 pingId) {
+    QJsonObject ping;
+    ping.insert(QStringLiteral("type"), QStringLiteral("ping"));
+    ping.insert(QStringLiteral("ping_id"), static_cast<double>(pingId));
+    return controlLine(ping);
+}
+
+QByteArray pongLine(quint64 pingId) {
+    QJsonObject pong;
+    pong.insert(QStringLiteral("type"), QStringLiteral("pong"));
+    pong.insert(QStringLiteral("ping_id"), static_cast<double>(pingId));
+    return controlLine(pong);
+}
+#endif
 }
 
 ControlServer::ControlServer(QObject *parent)
-    : QObject(parent) {
+    : QObject(parent),
+      livenessWheel_(kLivenessTickMs, static_cast<uint64_t>(QDateTime::currentMSecsSinceEpoch())) {
     pruneTimer_.setInterval(2000);
     QObject::connect(&pruneTimer_, &QTimer::timeout, this, &ControlServer::onPruneTick);
     presenceTimer_.setInterval(1000);
     QObject::connect(&presenceTimer_, &QTimer::timeout, this, &ControlServer::broadcastPresence);
+    forwardIndexTimer_.setInterval(kForwardIndexRefreshMs);
+    QObject::connect(&forwardIndexTimer_, &QTimer::timeout, this, [this]() {
+        rebuildForwardIndex(QDateTime::currentMSecsSinceEpoch());
+    });
+}
+
+ControlServer::~ControlServer() {
+    mediaPlane_.stop();
+}
+
+void ControlServer::setMixerOptions(const RoomMixer::Options &options) {
+    mixerOptions_ = options;
 }
 
 bool ControlServer::start(quint16 port) {
@@ -42,14 +126,23 @@ bool ControlServer::start(quint16 port) {
     mediaSessionKeyB64_ = QString::fromLatin1(mediaSessionKeyRaw_.toBase64());
 
     listenPort_ = port;
-    QObject::connect(&mediaSocket_, &QUdpSocket::readyRead, this, &ControlServer::onMediaReadyRead, Qt::UniqueConnection);
     QObject::connect(&controlServer_, &QTcpServer::newConnection, this, &ControlServer::onControlNewConnection, Qt::UniqueConnection);
 
-    const bool mediaOk = mediaSocket_.bind(QHostAddress::AnyIPv4, port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint);
+    const bool mediaOk = mediaPlane_.open(port);
     const bool controlOk = controlServer_.listen(QHostAddress::AnyIPv4, port);
     if (mediaOk && controlOk) {
+        if (mixerOptions_.roomSize > 0) {
+            // Clocked and sent on the media thread; this thread only plans
+            // who hears which mix.
+            mediaPlane_.enableMixing(mixerOptions_);
+        }
+        rebuildForwardIndex(QDateTime::currentMSecsSinceEpoch());
+        mediaPlane_.start(ctrlproto::encode(makeServerAnnounce()), [this]() {
+            QMetaObject::invokeMethod(this, &ControlServer::onMediaEvents, Qt::QueuedConnection);
+        });
         pruneTimer_.start();
         presenceTimer_.start();
+        forwardIndexTimer_.start();
         return true;
     }
     if (!mediaOk) {
@@ -61,51 +154,48 @@ bool ControlServer::start(quint16 port) {
     return false;
 }
 
-void ControlServer::onMediaReadyRead() {
-    while (mediaSocket_.hasPendingDatagrams()) {
-        QByteArray datagram;
-        datagram.resize(static_cast<int>(mediaSocket_.pendingDatagramSize()));
-
-        QHostAddress sender;
-        quint16 senderPort = 0;
-        mediaSocket_.readDatagram(datagram.data(), datagram.size(), &sender, &senderPort);
-        const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
-
-        ctrlproto::VoicePacket voicePacket;
-        if (ctrlproto::decode_voice_packet(datagram, voicePacket)) {
-            auto *source = registry_.find(voicePacket.ssrc);
-            if (!source) {
-                continue;
-            }
-
-            source->online = true;
-            source->mediaAddress = sender;
-            source->mediaPort = senderPort;
-            source->lastSeenMs = nowMs;
-            source->lastAudioMs = nowMs;
-
-            const uint8_t sourceLayer = ctrlproto::voice_layer_from_flags(voicePacket.flags);
-            const QVector<ClientRegistry::ClientState> online = registry_.onlineClients();
-            for (const auto &receiver : online) {
-                if (!shouldForwardToReceiver(*source, receiver, nowMs)) {
-                    continue;
-                }
-                if (sourceLayer != preferredLayerForReceiver(receiver)) {
-                    continue;
-                }
-                sendRaw(datagram, receiver.mediaAddress, receiver.mediaPort);
-            }
-            continue;
-        }
+// Runs whenever the media thread has queued something. Activity arrives at
+// most every few hundred milliseconds per source, or at once on a new
+// address, so this stays off the per-packet path.
+void ControlServer::onMediaEvents() {
+    const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
+    mediaPlane_.takeEvents([&](const MediaPlane::Event &event) {
+        noteVoiceActivity(event.ssrc, QHostAddress(ntohl(event.from.sin_addr.s_addr)), ntohs(event.from.sin_port),
+                          event.voiced, nowMs);
+    });
+    if (forwardIndexDirty_) {
+        rebuildForwardIndex(nowMs);
+    }
+}
 
-        QJsonObject msg;
-        if (!ctrlproto::decode(datagram, msg)) {
-            continue;
-        }
+void ControlServer::noteVoiceActivity(uint32_t ssrc, const QHostAddress &sender, quint16 senderPort, bool voiced,
+                                      qint64 nowMs) {
+    auto *source = registry_.find(ssrc);
+    if (!source) {
+        return;
+    }
 
-        if (msg.value(QStringLiteral("type")).toString() == QStringLiteral("discover_request")) {
-            mediaSocket_.writeDatagram(ctrlproto::encode(makeServerAnnounce()), sender, senderPort);
-        }
+    const bool wasOnline = source->online;
+    const bool wasSending = (nowMs - source->lastAudioMs) <= kActiveSpeakerWindowMs;
+    const bool wasVoiced = (nowMs - source->lastVoicedMs) <= kActiveSpeakerWindowMs;
+    if (!wasOnline || !wasSending || (voiced && !wasVoiced) || source->mediaPort != senderPort
+        || source->mediaAddress != sender) {
+        // A new speaker may fill a free slot at once, so it cannot wait for
+        // the next refresh.
+        forwardIndexDirty_ = true;
+    }
+    registry_.markOnline(source->clientId);
+    if (voiced) {
+        source->lastVoicedMs = nowMs;
+    }
+    source->mediaAddress = sender;
+    source->mediaPort = senderPort;
+    source->lastSeenMs = nowMs;
+    source->lastAudioMs = nowMs;
+    // Activity refreshes only move lastSeenMs; the wheel entry re-checks
+    // it when it fires.
+    if (!wasOnline) {
+        armLiveness(*source);
     }
 }
 
@@ -152,6 +242,19 @@ void ControlServer::onControlSocketReadyRead() {
     buffer.append(socket->readAll());
     const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
 
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+    // Every line of this read is parsed into the same arena-owned envelope;
+    // its strings and repeated fields keep their capacity across Clear(),
+    // and the arena starts on the stack, so a typical read allocates
+    // nothing on the heap.
+    alignas(8) char arenaBlock[kControlArenaBlockBytes];
+    google::protobuf::ArenaOptions arenaOptions;
+    arenaOptions.initial_block = arenaBlock;
+    arenaOptions.initial_block_size = sizeof(arenaBlock);
+    google::protobuf::Arena arena(arenaOptions);
+    auto *env = google::protobuf::Arena::Create<nox::control::v1::ControlEnvelope>(&arena);
+#endif
+
     while (true) {
         const int newline = buffer.indexOf('\n');
         if (newline < 0) {
@@ -162,12 +265,24 @@ void ControlServer::onControlSocketReadyRead() {
         if (line.isEmpty()) {
             continue;
         }
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+        env->Clear();
+        ControlWireFormat format = ControlWireFormat::Json;
+        if (!controlwire::decode(line, *env, format)) {
+            continue;
+        }
+        handleControlEnvelope(socket, *env, nowMs);
+#else
         ControlWireMessage wire;
         if (!controlwire::decode(line, wire)) {
             continue;
         }
-        const QJsonObject msg = wire.json;
-        handleControlMessage(socket, msg, nowMs);
+        handleControlMessage(socket, wire.json, nowMs);
+#endif
+    }
+    // The media thread only sees routing changes once they are published.
+    if (forwardIndexDirty_) {
+        rebuildForwardIndex(nowMs);
     }
 }
 
@@ -177,95 +292,121 @@ void ControlServer::onControlSocketDisconnected() {
         return;
     }
     registry_.markOfflineBySocket(socket);
+    rebuildForwardIndex(QDateTime::currentMSecsSinceEpoch());
     controlBuffers_.remove(socket);
     socket->deleteLater();
     broadcastUsers();
 }
 
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+// Handlers get the generated messages' fields as they are; JSON lines were
+// already converted by the wire codec, so nothing here looks at a type
+// string.
+void ControlServer::handleControlEnvelope(QSslSocket *socket, const nox::control::v1::ControlEnvelope &env, qint64 nowMs) {
+    using nox::control::v1::ControlEnvelope;
+    switch (env.payload_case()) {
+    case ControlEnvelope::kHello:
+        handleHello(socket, static_cast<int>(env.hello().protocol_version()));
+        return;
+    case ControlEnvelope::kPing:
+        handlePing(socket, env.ping().ping_id(), nowMs);
+        return;
+    case ControlEnvelope::kPong:
+        handlePong(socket, nowMs);
+        return;
+    case ControlEnvelope::kJoin: {
+        const auto &join = env.join();
+        handleJoin(socket, join.client_id(), QString::fromStdString(join.name()), QString::fromStdString(join.room()),
+                   static_cast<quint16>(join.udp_port()), nowMs);
+        return;
+    }
+    case ControlEnvelope::kLeave:
+        handleLeave(socket, env.leave().client_id());
+        return;
+    default:
+        break;
+    }
+
+    auto *user = registry_.findBySocket(socket);
+    if (!user) {
+        return;
+    }
+    user->lastSeenMs = nowMs;
+
+    switch (env.payload_case()) {
+    case ControlEnvelope::kTalk: {
+        QVector<uint32_t> targets;
+        targets.reserve(env.talk().targets_size());
+        for (uint32_t t : env.talk().targets()) {
+            if (t != 0) {
+                targets.push_back(t);
+            }
+        }
+        handleTalk(socket, *user, targets);
+        return;
+    }
+    case ControlEnvelope::kSubscribe: {
+        const auto &subscribe = env.subscribe();
+        QSet<uint32_t> sources;
+        sources.reserve(subscribe.sources_size());
+        for (uint32_t src : subscribe.sources()) {
+            if (src != 0 && src != user->clientId) {
+                sources.insert(src);
+            }
+        }
+        const int maxStreams =
+            subscribe.has_max_streams() ? static_cast<int>(subscribe.max_streams()) : user->maxStreams;
+        handleSubscribe(socket, *user, sources, maxStreams, subscribe.filter_enabled(),
+                        QString::fromStdString(subscribe.preferred_layer()));
+        return;
+    }
+    case ControlEnvelope::kVoiceFeedback: {
+        const auto &feedback = env.voice_feedback();
+        handleVoiceFeedback(*user, FeedbackReport{feedback.source_client_id(), static_cast<int>(feedback.loss_pct()),
+                                                  static_cast<int>(feedback.jitter_ms()), static_cast<int>(feedback.plc_pct()),
+                                                  static_cast<int>(feedback.fec_pct()), static_cast<int>(feedback.rtt_ms())});
+        return;
+    }
+    case ControlEnvelope::kNack: {
+        const auto &nack = env.nack();
+        handleNack(*user, nack.source_client_id(), static_cast<uint8_t>(nack.layer()),
+                   static_cast<uint16_t>(nack.sequence()), nack.mask(), nowMs);
+        return;
+    }
+    case ControlEnvelope::kListUsers:
+        handleList(socket);
+        return;
+    default:
+        return;
+    }
+}
+#else
 void ControlServer::handleControlMessage(QSslSocket *socket, const QJsonObject &msg, qint64 nowMs) {
     const QString type = msg.value(QStringLiteral("type")).toString();
-    const QHostAddress senderAddr = socket->peerAddress();
 
     if (type == QStringLiteral("hello")) {
-        const int protocolVersion = msg.value(QStringLiteral("protocol_version")).toInt(-1);
-        if (protocolVersion != hybridctrl::kProtocolVersion) {
-            QJsonObject error;
-            error.insert(QStringLiteral("type"), QStringLiteral("error"));
-            error.insert(QStringLiteral("reason"), QStringLiteral("protocol_version_mismatch"));
-            error.insert(QStringLiteral("expected"), hybridctrl::kProtocolVersion);
-            error.insert(QStringLiteral("received"), protocolVersion);
-            sendToControlSocket(error, socket);
-            socket->disconnectFromHost();
-            return;
-        }
-        const uint32_t assignedId = registry_.assignOrReuseId(socket);
-        hybridctrl::HelloAck ack;
-        ack.clientId = assignedId;
-        ack.mediaSessionKeyB64 = mediaSessionKeyB64_;
-        sendToControlSocket(hybridctrl::to_json(ack), socket);
+        handleHello(socket, msg.value(QStringLiteral("protocol_version")).toInt(-1));
         return;
     }
-
     if (type == QStringLiteral("ping")) {
-        if (auto *u = registry_.findBySocket(socket)) {
-            u->lastSeenMs = nowMs;
-        }
-        QJsonObject reply;
-        reply.insert(QStringLiteral("type"), QStringLiteral("pong"));
-        reply.insert(QStringLiteral("ping_id"), msg.value(QStringLiteral("ping_id")).toDouble(0));
-        sendToControlSocket(reply, socket);
+        handlePing(socket, static_cast<quint64>(msg.value(QStringLiteral("ping_id")).toDouble(0)), nowMs);
         return;
     }
-
     if (type == QStringLiteral("pong")) {
-        if (auto *u = registry_.findBySocket(socket)) {
-            u->lastSeenMs = nowMs;
-        }
+        handlePong(socket, nowMs);
         return;
     }
-
     if (type == QStringLiteral("join")) {
-        const uint32_t ssrc = static_cast<uint32_t>(msg.value(QStringLiteral("ssrc")).toDouble(0));
-        if (ssrc == 0) {
-            return;
-        }
-        for (const auto &existing : registry_.onlineClients()) {
-            if (existing.clientId == ssrc && existing.controlSocket.data() != socket) {
-                QJsonObject error;
-                error.insert(QStringLiteral("type"), QStringLiteral("error"));
-                error.insert(QStringLiteral("reason"), QStringLiteral("duplicate_ssrc"));
-                error.insert(QStringLiteral("ssrc"), static_cast<double>(ssrc));
-                sendToControlSocket(error, socket);
-                return;
-            }
-        }
-        const QString room = msg.value(QStringLiteral("room")).toString(QStringLiteral("default"));
-        registry_.updateJoin(ssrc,
-                             msg.value(QStringLiteral("name")).toString(),
-                             room,
-                             senderAddr,
-                             static_cast<quint16>(msg.value(QStringLiteral("udp_port")).toInt(0)),
-                             socket,
-                             nowMs);
-        QJsonObject ack;
-        ack.insert(QStringLiteral("type"), QStringLiteral("join_ack"));
-        ack.insert(QStringLiteral("ok"), true);
-        ack.insert(QStringLiteral("ssrc"), static_cast<double>(ssrc));
-        ack.insert(QStringLiteral("room"), room);
-        sendToControlSocket(ack, socket);
-        broadcastUsers();
+        handleJoin(socket,
+                   static_cast<uint32_t>(msg.value(QStringLiteral("ssrc")).toDouble(0)),
+                   msg.value(QStringLiteral("name")).toString(),
+                   msg.value(QStringLiteral("room")).toString(QStringLiteral("default")),
+                   static_cast<quint16>(msg.value(QStringLiteral("udp_port")).toInt(0)),
+                   nowMs);
         return;
     }
-
     if (type == QStringLiteral("leave")) {
-        const uint32_t ssrc = static_cast<uint32_t>(msg.value(QStringLiteral("ssrc")).toDouble(0));
-        registry_.markOfflineById(ssrc);
-        QJsonObject ack;
-        ack.insert(QStringLiteral("type"), QStringLiteral("leave_ack"));
-        ack.insert(QStringLiteral("ok"), true);
-        ack.insert(QStringLiteral("ssrc"), static_cast<double>(ssrc));
-        sendToControlSocket(ack, socket);
-        broadcastUsers();
+        handleLeave(socket, static_cast<uint32_t>(msg.value(QStringLiteral("ssrc")).toDouble(0)));
         return;
     }
 
@@ -283,17 +424,7 @@ void ControlServer::handleControlMessage(QSslSocket *socket, const QJsonObject &
                 targets.push_back(t);
             }
         }
-        registry_.setTalkTargets(user->clientId, targets);
-        QJsonObject ack;
-        ack.insert(QStringLiteral("type"), QStringLiteral("talk_ack"));
-        ack.insert(QStringLiteral("ok"), true);
-        ack.insert(QStringLiteral("ssrc"), static_cast<double>(user->clientId));
-        QJsonArray targetsArr;
-        for (uint32_t target : targets) {
-            targetsArr.push_back(static_cast<double>(target));
-        }
-        ack.insert(QStringLiteral("targets"), targetsArr);
-        sendToControlSocket(ack, socket);
+        handleTalk(socket, *user, targets);
         return;
     }
 
@@ -305,82 +436,391 @@ void ControlServer::handleControlMessage(QSslSocket *socket, const QJsonObject &
                 sources.insert(src);
             }
         }
-        registry_.setSubscriptions(user->clientId,
-                                   sources,
-                                   msg.value(QStringLiteral("max_streams")).toInt(user->maxStreams),
-                                   msg.value(QStringLiteral("filter_enabled")).toBool(false),
-                                   msg.value(QStringLiteral("preferred_layer")).toString());
-        QJsonObject ack;
-        ack.insert(QStringLiteral("type"), QStringLiteral("subscribe_ack"));
-        ack.insert(QStringLiteral("ok"), true);
-        ack.insert(QStringLiteral("ssrc"), static_cast<double>(user->clientId));
-        ack.insert(QStringLiteral("max_streams"), user->maxStreams);
-        ack.insert(QStringLiteral("filter_enabled"), user->subscriptionFilterEnabled);
-        ack.insert(QStringLiteral("preferred_layer"), user->preferredLayer);
-        sendToControlSocket(ack, socket);
+        handleSubscribe(socket, *user, sources,
+                        msg.value(QStringLiteral("max_streams")).toInt(user->maxStreams),
+                        msg.value(QStringLiteral("filter_enabled")).toBool(false),
+                        msg.value(QStringLiteral("preferred_layer")).toString());
         return;
     }
 
     if (type == QStringLiteral("voice_feedback")) {
-        const uint32_t sourceSsrc = static_cast<uint32_t>(msg.value(QStringLiteral("source_ssrc")).toDouble(0));
-        auto *source = registry_.find(sourceSsrc);
-        if (!source || !source->online || source->controlSocket.isNull()) {
-            return;
+        handleVoiceFeedback(*user, FeedbackReport{static_cast<uint32_t>(msg.value(QStringLiteral("source_ssrc")).toDouble(0)),
+                                                  msg.value(QStringLiteral("loss_pct")).toInt(0),
+                                                  msg.value(QStringLiteral("jitter_ms")).toInt(0),
+                                                  msg.value(QStringLiteral("plc_pct")).toInt(0),
+                                                  msg.value(QStringLiteral("fec_pct")).toInt(0),
+                                                  msg.value(QStringLiteral("rtt_ms")).toInt(0)});
+        return;
+    }
+
+    if (type == QStringLiteral("nack")) {
+        handleNack(*user,
+                   static_cast<uint32_t>(msg.value(QStringLiteral("source_ssrc")).toDouble(0)),
+                   static_cast<uint8_t>(msg.value(QStringLiteral("layer")).toInt(0)),
+                   static_cast<uint16_t>(msg.value(QStringLiteral("seq")).toInt(0)),
+                   static_cast<uint32_t>(msg.value(QStringLiteral("mask")).toInt(0)),
+                   nowMs);
+        return;
+    }
+
+    if (type == QStringLiteral("list")) {
+        handleList(socket);
+    }
+}
+#endif
+
+void ControlServer::handleHello(QSslSocket *socket, int protocolVersion) {
+    if (protocolVersion != hybridctrl::kProtocolVersion) {
+        QJsonObject error;
+        error.insert(QStringLiteral("type"), QStringLiteral("error"));
+        error.insert(QStringLiteral("reason"), QStringLiteral("protocol_version_mismatch"));
+        error.insert(QStringLiteral("expected"), hybridctrl::kProtocolVersion);
+        error.insert(QStringLiteral("received"), protocolVersion);
+        sendToControlSocket(error, socket);
+        socket->disconnectFromHost();
+        return;
+    }
+    const uint32_t assignedId = registry_.assignOrReuseId(socket);
+    hybridctrl::HelloAck ack;
+    ack.clientId = assignedId;
+    ack.mediaSessionKeyB64 = mediaSessionKeyB64_;
+    sendToControlSocket(hybridctrl::to_json(ack), socket);
+}
+
+void ControlServer::handlePing(QSslSocket *socket, quint64 pingId, qint64 nowMs) {
+    handlePong(socket, nowMs);
+    writeControlLine(pongLine(pingId), socket);
+}
+
+void ControlServer::handlePong(QSslSocket *socket, qint64 nowMs) {
+    if (auto *u = registry_.findBySocket(socket)) {
+        u->lastSeenMs = nowMs;
+        armLiveness(*u);
+    }
+}
+
+void ControlServer::handleJoin(QSslSocket *socket, uint32_t ssrc, const QString &name, const QString &room,
+                               quint16 udpPort, qint64 nowMs) {
+    if (ssrc == 0) {
+        return;
+    }
+    const auto *existing = registry_.find(ssrc);
+    if (existing && existing->online && existing->controlSocket.data() != socket) {
+        QJsonObject error;
+        error.insert(QStringLiteral("type"), QStringLiteral("error"));
+        error.insert(QStringLiteral("reason"), QStringLiteral("duplicate_ssrc"));
+        error.insert(QStringLiteral("ssrc"), static_cast<double>(ssrc));
+        sendToControlSocket(error, socket);
+        return;
+    }
+    registry_.updateJoin(ssrc, name, room, socket->peerAddress(), udpPort, socket, nowMs);
+    if (const auto *joined = registry_.find(ssrc)) {
+        armLiveness(*joined);
+    }
+    forwardIndexDirty_ = true;
+    QJsonObject ack;
+    ack.insert(QStringLiteral("type"), QStringLiteral("join_ack"));
+    ack.insert(QStringLiteral("ok"), true);
+    ack.insert(QStringLiteral("ssrc"), static_cast<double>(ssrc));
+    ack.insert(QStringLiteral("room"), room);
+    sendToControlSocket(ack, socket);
+    broadcastUsers();
+}
+
+void ControlServer::handleLeave(QSslSocket *socket, uint32_t ssrc) {
+    registry_.markOfflineById(ssrc);
+    forwardIndexDirty_ = true;
+    QJsonObject ack;
+    ack.insert(QStringLiteral("type"), QStringLiteral("leave_ack"));
+    ack.insert(QStringLiteral("ok"), true);
+    ack.insert(QStringLiteral("ssrc"), static_cast<double>(ssrc));
+    sendToControlSocket(ack, socket);
+    broadcastUsers();
+}
+
+void ControlServer::handleTalk(QSslSocket *socket, const ClientRegistry::ClientState &user, const QVector<uint32_t> &targets) {
+    registry_.setTalkTargets(user.clientId, targets);
+    forwardIndexDirty_ = true;
+    QJsonObject ack;
+    ack.insert(QStringLiteral("type"), QStringLiteral("talk_ack"));
+    ack.insert(QStringLiteral("ok"), true);
+    ack.insert(QStringLiteral("ssrc"), static_cast<double>(user.clientId));
+    QJsonArray targetsArr;
+    for (uint32_t target : targets) {
+        targetsArr.push_back(static_cast<double>(target));
+    }
+    ack.insert(QStringLiteral("targets"), targetsArr);
+    sendToControlSocket(ack, socket);
+}
+
+void ControlServer::handleSubscribe(QSslSocket *socket, const ClientRegistry::ClientState &user,
+                                    const QSet<uint32_t> &sources, int maxStreams, bool filterEnabled,
+                                    const QString &layer) {
+    registry_.setSubscriptions(user.clientId, sources, maxStreams, filterEnabled, layer);
+    forwardIndexDirty_ = true;
+    QJsonObject ack;
+    ack.insert(QStringLiteral("type"), QStringLiteral("subscribe_ack"));
+    ack.insert(QStringLiteral("ok"), true);
+    ack.insert(QStringLiteral("ssrc"), static_cast<double>(user.clientId));
+    ack.insert(QStringLiteral("max_streams"), user.maxStreams);
+    ack.insert(QStringLiteral("filter_enabled"), user.subscriptionFilterEnabled);
+    ack.insert(QStringLiteral("preferred_layer"), user.preferredLayer);
+    sendToControlSocket(ack, socket);
+}
+
+// Reports on the mixed stream have no sender to relay to, but they are the
+// only loss and jitter a listener in a mixed room reports, and its EWMAs
+// pick the bitrate of its mix.
+void ControlServer::handleVoiceFeedback(ClientRegistry::ClientState &user, const FeedbackReport &report) {
+    const bool mixed = report.sourceSsrc == hybridctrl::kMixedSourceSsrc;
+    const auto *source = mixed ? nullptr : registry_.find(report.sourceSsrc);
+    if (!mixed && (!source || !source->online || source->controlSocket.isNull())) {
+        return;
+    }
+
+    const uint8_t layerBefore = preferredLayerForReceiver(user);
+    user.rxLossEwma = (user.rxLossEwma * 0.8) + (static_cast<double>(report.lossPct) * 0.2);
+    user.rxJitterEwma = (user.rxJitterEwma * 0.8) + (static_cast<double>(report.jitterMs) * 0.2);
+    user.rxRttEwma = (user.rxRttEwma * 0.8) + (static_cast<double>(report.rttMs) * 0.2);
+    // Reports arrive per source every second; only a layer switch changes
+    // routing.
+    if (preferredLayerForReceiver(user) != layerBefore) {
+        forwardIndexDirty_ = true;
+    }
+    if (!source) {
+        return;
+    }
+
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+    nox::control::v1::ControlEnvelope env;
+    auto *feedback = env.mutable_voice_feedback();
+    feedback->set_reporter_client_id(user.clientId);
+    feedback->set_source_client_id(report.sourceSsrc);
+    feedback->set_loss_pct(static_cast<uint32_t>(report.lossPct));
+    feedback->set_jitter_ms(static_cast<uint32_t>(report.jitterMs));
+    feedback->set_plc_pct(static_cast<uint32_t>(report.plcPct));
+    feedback->set_fec_pct(static_cast<uint32_t>(report.fecPct));
+    feedback->set_rtt_ms(static_cast<uint32_t>(report.rttMs));
+    writeControlLine(controlLine(env), source->controlSocket.data());
+#else
+    QJsonObject feedback;
+    feedback.insert(QStringLiteral("type"), QStringLiteral("voice_feedback"));
+    feedback.insert(QStringLiteral("reporter_ssrc"), static_cast<double>(user.clientId));
+    feedback.insert(QStringLiteral("source_ssrc"), static_cast<double>(report.sourceSsrc));
+    feedback.insert(QStringLiteral("loss_pct"), report.lossPct);
+    feedback.insert(QStringLiteral("jitter_ms"), report.jitterMs);
+    feedback.insert(QStringLiteral("plc_pct"), report.plcPct);
+    feedback.insert(QStringLiteral("fec_pct"), report.fecPct);
+    feedback.insert(QStringLiteral("rtt_ms"), report.rttMs);
+    sendToControlSocket(feedback, source->controlSocket.data());
+#endif
+}
+
+void ControlServer::handleList(QSslSocket *socket) {
+    writeControlLine(usersLine(), socket);
+}
+
+// Checked and rate-limited here, answered by the media thread from its
+// cache; the sender never hears about the loss.
+void ControlServer::handleNack(const ClientRegistry::ClientState &receiver, uint32_t sourceSsrc, uint8_t layer,
+                               uint16_t first, uint32_t requested, qint64 nowMs) {
+    // Only what the receiver is being forwarded, in the layer it gets.
+    const auto source = forwardRoutes_->sources.find(sourceSsrc);
+    if (source == forwardRoutes_->sources.end()) {
+        return;
+    }
+    const auto &targets = source->second.targets;
+    const auto target = std::find_if(targets.cbegin(), targets.cend(), [&receiver, layer](const MediaPlane::Target &t) {
+        return t.receiverId == receiver.clientId && t.layer == layer;
+    });
+    if (target == targets.cend()) {
+        return;
+    }
+
+    NackBudget &budget = nackBudgets_[receiver.clientId];
+    if (budget.refillMs == 0) {
+        budget.tokens = kNackBurst;
+    } else {
+        budget.tokens = std::min(kNackBurst, budget.tokens + (static_cast<double>(nowMs - budget.refillMs) * kNackRatePerSec / 1000.0));
+    }
+    budget.refillMs = nowMs;
+
+    // Whether the cache still holds a sequence is only known on the media
+    // thread, so every sequence asked for is charged.
+    if (budget.tokens < 1.0) {
+        return;
+    }
+    budget.tokens -= 1.0;
+    uint32_t mask = 0;
+    for (int bit = 0; bit < kNackMaskBits && budget.tokens >= 1.0; ++bit) {
+        if ((requested & (1u << bit)) != 0) {
+            mask |= 1u << bit;
+            budget.tokens -= 1.0;
         }
+    }
+    mediaPlane_.requestRetransmit(sourceSsrc, layer, first, mask, target->to);
+}
 
-        user->rxLossEwma = (user->rxLossEwma * 0.8) + (static_cast<double>(msg.value(QStringLiteral("loss_pct")).toInt(0)) * 0.2);
-        user->rxJitterEwma = (user->rxJitterEwma * 0.8) + (static_cast<double>(msg.value(QStringLiteral("jitter_ms")).toInt(0)) * 0.2);
-        user->rxRttEwma = (user->rxRttEwma * 0.8) + (static_cast<double>(msg.value(QStringLiteral("rtt_ms")).toInt(0)) * 0.2);
+void ControlServer::pruneMediaState() {
+    for (auto it = nackBudgets_.begin(); it != nackBudgets_.end();) {
+        const auto *u = registry_.find(it.key());
+        if (!u || !u->online) {
+            it = nackBudgets_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
 
-        QJsonObject feedback;
-        feedback.insert(QStringLiteral("type"), QStringLiteral("voice_feedback"));
-        feedback.insert(QStringLiteral("reporter_ssrc"), static_cast<double>(user->clientId));
-        feedback.insert(QStringLiteral("source_ssrc"), static_cast<double>(sourceSsrc));
-        feedback.insert(QStringLiteral("loss_pct"), msg.value(QStringLiteral("loss_pct")).toInt(0));
-        feedback.insert(QStringLiteral("jitter_ms"), msg.value(QStringLiteral("jitter_ms")).toInt(0));
-        feedback.insert(QStringLiteral("plc_pct"), msg.value(QStringLiteral("plc_pct")).toInt(0));
-        feedback.insert(QStringLiteral("fec_pct"), msg.value(QStringLiteral("fec_pct")).toInt(0));
-        feedback.insert(QStringLiteral("rtt_ms"), msg.value(QStringLiteral("rtt_ms")).toInt(0));
-        sendToControlSocket(feedback, source->controlSocket.data());
+// Fills `picked` with up to `limit` of `speakers` that `receiver` can hear,
+// most recently voiced first; a sender never heard voicing anything can
+// still fill a free slot. Speakers it already had keep their slots through
+// the hold and then carry the hysteresis margin, so open mics that fall
+// silent hand their slots on without two live speakers trading places
+// every refresh.
+void ControlServer::pickSpeakers(const ClientRegistry::ClientState &receiver,
+                                 const QVector<const ClientRegistry::ClientState *> &speakers, int limit, qint64 nowMs,
+                                 QVector<uint32_t> &picked) {
+    picked.clear();
+    if (limit <= 0) {
         return;
     }
+    const auto held = speakerSlots_.constFind(receiver.clientId);
+    speakerCandidates_.clear();
+    for (const auto *source : speakers) {
+        if (!canHear(*source, receiver)) {
+            continue;
+        }
+        SpeakerCandidate candidate{source->clientId, source->lastVoicedMs, nowMs};
+        if (held != speakerSlots_.constEnd()) {
+            for (const SpeakerSlot &slot : *held) {
+                if (slot.source != source->clientId) {
+                    continue;
+                }
+                candidate.sinceMs = slot.sinceMs;
+                candidate.rankMs = (nowMs - slot.sinceMs) < kSpeakerHoldMs ? std::numeric_limits<qint64>::max()
+                                                                           : candidate.rankMs + kSpeakerHysteresisMs;
+                break;
+            }
+        }
+        speakerCandidates_.push_back(candidate);
+    }
 
-    if (type == QStringLiteral("list")) {
-        QJsonObject reply;
-        reply.insert(QStringLiteral("type"), QStringLiteral("users"));
-        reply.insert(QStringLiteral("users"), onlineUsersAsJson());
-        sendToControlSocket(reply, socket);
+    const int count = std::min(limit, static_cast<int>(speakerCandidates_.size()));
+    std::partial_sort(speakerCandidates_.begin(), speakerCandidates_.begin() + count, speakerCandidates_.end(),
+                      [](const SpeakerCandidate &a, const SpeakerCandidate &b) {
+                          if (a.rankMs != b.rankMs) {
+                              return a.rankMs > b.rankMs;
+                          }
+                          return a.source < b.source;
+                      });
+    QVector<SpeakerSlot> &holds = nextSpeakerSlots_[receiver.clientId];
+    for (int i = 0; i < count; ++i) {
+        picked.push_back(speakerCandidates_[i].source);
+        holds.push_back(SpeakerSlot{speakerCandidates_[i].source, speakerCandidates_[i].sinceMs});
     }
 }
 
+// The mixes of one room, for the media thread to clock. Each listener hears
+// the speakers it would otherwise be forwarded, itself excluded, picked with
+// the same hold and hysteresis; when its set does change, encoderFor keeps
+// its stream on one encoder. Listeners that end up with the same set share
+// one mix and one encode.
+void ControlServer::planMix(ClientRegistry::RoomId roomId, qint64 nowMs, MediaPlane::Routes &routes) {
+    QVector<const ClientRegistry::ClientState *> members;
+    QVector<const ClientRegistry::ClientState *> speakers;
+    registry_.forEachInRoom(roomId, [&](const ClientRegistry::ClientState &client) {
+        members.push_back(&client);
+        if ((nowMs - client.lastAudioMs) <= kActiveSpeakerWindowMs) {
+            speakers.push_back(&client);
+        }
+    });
+
+    MediaPlane::MixPlan plan;
+    plan.job.roomId = roomId;
+    QHash<QByteArray, int> mixIndex;
+    QSet<uint32_t> heard;
+    for (const auto *receiver : std::as_const(members)) {
+        if (receiver->mediaAddress.isNull() || receiver->mediaPort == 0) {
+            continue;
+        }
+        const int limit = receiver->maxStreams > 0 ? std::min(receiver->maxStreams, mixerOptions_.maxSources)
+                                                   : mixerOptions_.maxSources;
+        RoomMixer::MixSet mix;
+        pickSpeakers(*receiver, speakers, limit, nowMs, mix.sources);
+        if (mix.sources.isEmpty()) {
+            continue;
+        }
+        std::sort(mix.sources.begin(), mix.sources.end());
+        mix.bitrate = preferredLayerForReceiver(*receiver) == ctrlproto::kVoiceLayerLow ? RoomMixer::kLowBitrate
+                                                                                         : RoomMixer::kHighBitrate;
+        routes.mixListeners[receiver->clientId] = toSockaddr(receiver->mediaAddress, receiver->mediaPort);
+
+        const QByteArray key = RoomMixer::mixKey(mix);
+        const auto existing = mixIndex.constFind(key);
+        if (existing != mixIndex.constEnd()) {
+            plan.job.mixes[*existing].receivers.push_back(receiver->clientId);
+            continue;
+        }
+        for (uint32_t ssrc : mix.sources) {
+            heard.insert(ssrc);
+        }
+        mix.receivers.push_back(receiver->clientId);
+        mixIndex.insert(key, plan.job.mixes.size());
+        plan.job.mixes.push_back(std::move(mix));
+    }
+
+    if (plan.job.mixes.isEmpty()) {
+        return;
+    }
+    plan.sources.assign(heard.cbegin(), heard.cend());
+    routes.mixes.push_back(std::move(plan));
+}
+
+qint64 ControlServer::livenessDeadline(const ClientRegistry::ClientState &client) const {
+    return client.lastSeenMs + std::min(kKeepaliveMissWindowMs, kStaleMs);
+}
+
+void ControlServer::armLiveness(const ClientRegistry::ClientState &client) {
+    livenessWheel_.arm(client.clientId, static_cast<uint64_t>(livenessDeadline(client)));
+}
+
 void ControlServer::onPruneTick() {
     const qint64 nowMs = QDateTime::currentMSecsSinceEpoch();
     bool changed = false;
-    for (const auto &u : registry_.onlineClients()) {
-        if ((nowMs - u.lastSeenMs) > kKeepaliveMissWindowMs) {
-            registry_.markOfflineById(u.clientId);
-            changed = true;
+    // Only clients whose deadline came due are visited; anything seen since
+    // it was armed is pushed out again rather than marked offline.
+    expiredClients_.clear();
+    livenessWheel_.advance(static_cast<uint64_t>(nowMs), expiredClients_);
+    for (TimerWheel::Key key : expiredClients_) {
+        const auto *u = registry_.find(static_cast<uint32_t>(key));
+        if (!u || !u->online) {
             continue;
         }
-        if ((nowMs - u.lastSeenMs) > kStaleMs) {
-            registry_.markOfflineById(u.clientId);
-            changed = true;
+        if (livenessDeadline(*u) >= nowMs) {
+            armLiveness(*u);
+            continue;
         }
+        registry_.markOfflineById(u->clientId);
+        forwardIndexDirty_ = true;
+        changed = true;
+    }
+    if (forwardIndexDirty_) {
+        rebuildForwardIndex(nowMs);
     }
 
     static qint64 lastServerPingMs = 0;
     if ((nowMs - lastServerPingMs) >= kServerPingIntervalMs) {
         lastServerPingMs = nowMs;
-        QJsonObject ping;
-        ping.insert(QStringLiteral("type"), QStringLiteral("ping"));
-        ping.insert(QStringLiteral("ping_id"), static_cast<double>(nowMs & 0x7FFFFFFF));
-        for (const auto &u : registry_.onlineClients()) {
+        const QByteArray ping = pingLine(static_cast<quint64>(nowMs & 0x7FFFFFFF));
+        registry_.forEachOnline([&](const ClientRegistry::ClientState &u) {
             if (!u.controlSocket.isNull()) {
-                sendToControlSocket(ping, u.controlSocket.data());
+                writeControlLine(ping, u.controlSocket.data());
             }
-        }
+        });
     }
 
+    pruneMediaState();
     if (changed) {
         broadcastUsers();
     }
@@ -390,16 +830,14 @@ void ControlServer::sendToControlSocket(const QJsonObject &obj, QSslSocket *sock
     if (!socket || socket->state() != QAbstractSocket::ConnectedState) {
         return;
     }
-    QByteArray payload = controlwire::encode(
-        obj,
-#if defined(NOX_HAS_PROTOBUF_CONTROL)
-        ControlWireFormat::Protobuf
-#else
-        ControlWireFormat::Json
-#endif
-    );
-    payload.append('\n');
-    socket->write(payload);
+    writeControlLine(controlLine(obj), socket);
+}
+
+void ControlServer::writeControlLine(const QByteArray &line, QSslSocket *socket) {
+    if (line.isEmpty() || !socket || socket->state() != QAbstractSocket::ConnectedState) {
+        return;
+    }
+    socket->write(line);
 }
 
 bool ControlServer::loadTlsConfiguration() {
@@ -445,11 +883,10 @@ uint8_t ControlServer::preferredLayerForReceiver(const ClientRegistry::ClientSta
     return ctrlproto::kVoiceLayerHigh;
 }
 
-bool ControlServer::shouldForwardToReceiver(const ClientRegistry::ClientState &source, const ClientRegistry::ClientState &receiver, qint64 nowMs) const {
-    if (!receiver.online || receiver.clientId == source.clientId || receiver.mediaAddress.isNull() || receiver.mediaPort == 0) {
-        return false;
-    }
-    if (source.room != receiver.room) {
+// Room, talk targets and subscriptions; the active-speaker cap is applied
+// when the forwarding index is built.
+bool ControlServer::canHear(const ClientRegistry::ClientState &source, const ClientRegistry::ClientState &receiver) {
+    if (receiver.clientId == source.clientId || source.roomId != receiver.roomId) {
         return false;
     }
     if (!source.targets.isEmpty() && !source.targets.contains(receiver.clientId)) {
@@ -458,48 +895,81 @@ bool ControlServer::shouldForwardToReceiver(const ClientRegistry::ClientState &s
     if (receiver.subscriptionFilterEnabled && !receiver.subscriptions.contains(source.clientId)) {
         return false;
     }
-    if (receiver.maxStreams <= 0) {
-        return true;
-    }
-    const QVector<uint32_t> topSources = topForwardableSourcesForReceiver(receiver, nowMs);
-    return topSources.contains(source.clientId);
+    return true;
 }
 
-QVector<uint32_t> ControlServer::topForwardableSourcesForReceiver(const ClientRegistry::ClientState &receiver, qint64 nowMs) const {
-    QVector<ClientRegistry::ClientState> candidates;
-    for (const auto &src : registry_.onlineClients()) {
-        if (!src.online || src.clientId == receiver.clientId || src.mediaAddress.isNull() || src.mediaPort == 0) {
-            continue;
-        }
-        if (src.room != receiver.room) {
-            continue;
-        }
-        if ((nowMs - src.lastAudioMs) > kActiveSpeakerWindowMs) {
-            continue;
-        }
-        if (!src.targets.isEmpty() && !src.targets.contains(receiver.clientId)) {
-            continue;
-        }
-        if (receiver.subscriptionFilterEnabled && !receiver.subscriptions.contains(src.clientId)) {
-            continue;
+// Resolves, for every source, the receivers its packets go to and the layer
+// each wants, so forwarding a packet is one lookup and a walk over its
+// receivers, and publishes it to the media thread as one immutable snapshot
+// together with the mix plans of rooms large enough to be mixed.
+// Rebuilt when membership, routing or a receiver's layer changes, when
+// someone starts speaking, and every kForwardIndexRefreshMs to retire
+// speakers that went quiet and hand their slots on.
+void ControlServer::rebuildForwardIndex(qint64 nowMs) {
+    forwardIndexDirty_ = false;
+    const auto &rooms = registry_.rooms();
+    QSet<ClientRegistry::RoomId> mixedRooms;
+    if (mixerOptions_.roomSize > 0) {
+        for (auto room = rooms.cbegin(); room != rooms.cend(); ++room) {
+            if (room->size() >= mixerOptions_.roomSize) {
+                mixedRooms.insert(room.key());
+            }
         }
-        candidates.push_back(src);
     }
 
-    std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b) {
-        if (a.lastAudioMs != b.lastAudioMs) {
-            return a.lastAudioMs > b.lastAudioMs;
-        }
-        return a.clientId < b.clientId;
+    // Every known client gets an entry, so the media thread can drop
+    // unknown ssrcs on its own.
+    auto routes = std::make_shared<MediaPlane::Routes>();
+    routes->sources.reserve(static_cast<size_t>(registry_.size()));
+    registry_.forEachClient([&](const ClientRegistry::ClientState &client) {
+        routes->sources[client.clientId].mixed = client.online && mixedRooms.contains(client.roomId);
     });
 
-    QVector<uint32_t> result;
-    const int n = std::min(receiver.maxStreams, static_cast<int>(candidates.size()));
-    result.reserve(n);
-    for (int i = 0; i < n; ++i) {
-        result.push_back(candidates[i].clientId);
+    // Rooms are independent, so each is resolved from its own member list
+    // and the scratch vectors are reused across rooms.
+    QVector<const ClientRegistry::ClientState *> members;
+    QVector<const ClientRegistry::ClientState *> speakers;
+    QVector<uint32_t> picked;
+    nextSpeakerSlots_.clear();
+    for (auto room = rooms.cbegin(); room != rooms.cend(); ++room) {
+        if (mixedRooms.contains(room.key())) {
+            planMix(room.key(), nowMs, *routes);
+            continue;
+        }
+        members.clear();
+        speakers.clear();
+        registry_.forEachInRoom(room.key(), [&](const ClientRegistry::ClientState &client) {
+            if (client.mediaAddress.isNull() || client.mediaPort == 0) {
+                return;
+            }
+            members.push_back(&client);
+            if ((nowMs - client.lastAudioMs) <= kActiveSpeakerWindowMs) {
+                speakers.push_back(&client);
+            }
+        });
+
+        for (const auto *receiver : std::as_const(members)) {
+            const MediaPlane::Target target{receiver->clientId, toSockaddr(receiver->mediaAddress, receiver->mediaPort),
+                                            preferredLayerForReceiver(*receiver)};
+            if (receiver->maxStreams <= 0) {
+                for (const auto *source : std::as_const(members)) {
+                    if (canHear(*source, *receiver)) {
+                        routes->sources[source->clientId].targets.push_back(target);
+                    }
+                }
+                continue;
+            }
+            pickSpeakers(*receiver, speakers, receiver->maxStreams, nowMs, picked);
+            for (uint32_t sourceId : std::as_const(picked)) {
+                routes->sources[sourceId].targets.push_back(target);
+            }
+        }
     }
-    return result;
+
+    // Receivers that left or stopped limiting their streams drop out here.
+    speakerSlots_.swap(nextSpeakerSlots_);
+    forwardRoutes_ = routes;
+    mediaPlane_.publish(std::move(routes));
 }
 
 QJsonObject ControlServer::makeServerAnnounce() const {
@@ -515,36 +985,53 @@ QJsonObject ControlServer::makeServerAnnounce() const {
 }
 
 void ControlServer::sendRaw(const QByteArray &payload, const QHostAddress &addr, quint16 port) {
-    mediaSocket_.writeDatagram(payload, addr, port);
+    const sockaddr_in to = toSockaddr(addr, port);
+    mediaPlane_.send(payload.constData(), payload.size(), to);
 }
 
+// Encoded once however many members it goes to.
 void ControlServer::broadcastUsers() {
-    QJsonObject packet;
-    packet.insert(QStringLiteral("type"), QStringLiteral("users"));
-    packet.insert(QStringLiteral("users"), onlineUsersAsJson());
-    for (const auto &u : registry_.onlineClients()) {
+    const QByteArray line = usersLine();
+    registry_.forEachOnline([&](const ClientRegistry::ClientState &u) {
         if (!u.controlSocket.isNull()) {
-            sendToControlSocket(packet, u.controlSocket.data());
+            writeControlLine(line, u.controlSocket.data());
         }
-    }
+    });
 }
 
-QJsonArray ControlServer::onlineUsersAsJson() const {
+QByteArray ControlServer::usersLine() const {
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+    nox::control::v1::ControlEnvelope env;
+    auto *users = env.mutable_users();
+    users->mutable_users()->Reserve(registry_.onlineCount());
+    registry_.forEachOnline([&](const ClientRegistry::ClientState &u) {
+        auto *item = users->add_users();
+        item->set_client_id(u.clientId);
+        item->set_name(u.name.toStdString());
+        item->set_online(true);
+        item->set_room(u.room.toStdString());
+    });
+    return controlLine(env);
+#else
     QJsonArray usersJson;
-    for (const auto &u : registry_.onlineClients()) {
+    registry_.forEachOnline([&](const ClientRegistry::ClientState &u) {
         QJsonObject item;
         item.insert(QStringLiteral("ssrc"), static_cast<double>(u.clientId));
         item.insert(QStringLiteral("name"), u.name);
         item.insert(QStringLiteral("online"), 1);
         item.insert(QStringLiteral("room"), u.room);
         usersJson.push_back(item);
-    }
-    return usersJson;
+    });
+    QJsonObject packet;
+    packet.insert(QStringLiteral("type"), QStringLiteral("users"));
+    packet.insert(QStringLiteral("users"), usersJson);
+    return controlLine(packet);
+#endif
 }
 
 void ControlServer::broadcastPresence() {
     if (listenPort_ == 0) {
         return;
     }
-    mediaSocket_.writeDatagram(ctrlproto::encode(makeServerAnnounce()), QHostAddress::Broadcast, listenPort_);
+    sendRaw(ctrlproto::encode(makeServerAnnounce()), QHostAddress::Broadcast, listenPort_);
 }
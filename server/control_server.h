@@ -5,28 +5,37 @@
 #include <QHostAddress>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QSet>
 #include <QSslCertificate>
 #include <QSslKey>
 #include <QSslSocket>
 #include <QTcpServer>
 #include <QTimer>
-#include <QUdpSocket>
 #include <QVector>
 
 #include <cstdint>
+#include <memory>
 
 #include "server/hybrid/client_registry.h"
+#include "server/hybrid/media_plane.h"
+#include "server/hybrid/room_mixer.h"
+#include "shared/protocol/control_wire.h"
+#include "shared/utils/TimerWheel.h"
 
 class ControlServer : public QObject {
     Q_OBJECT
+    friend struct HotPathBenchAccess; // tools/bench/hotpath_bench.cpp
 
 public:
     explicit ControlServer(QObject *parent = nullptr);
+    ~ControlServer() override;
 
+    // Call before start(); a room size of 0 leaves every room forwarded.
+    void setMixerOptions(const RoomMixer::Options &options);
     bool start(quint16 port);
 
 private slots:
-    void onMediaReadyRead();
+    void onMediaEvents();
     void onControlNewConnection();
     void onControlSocketReadyRead();
     void onControlSocketDisconnected();
@@ -34,27 +43,91 @@ private slots:
     void broadcastPresence();
 
 private:
+    struct FeedbackReport {
+        uint32_t sourceSsrc = 0;
+        int lossPct = 0;
+        int jitterMs = 0;
+        int plcPct = 0;
+        int fecPct = 0;
+        int rttMs = 0;
+    };
+
     bool loadTlsConfiguration();
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+    void handleControlEnvelope(QSslSocket *socket, const nox::control::v1::ControlEnvelope &env, qint64 nowMs);
+#else
     void handleControlMessage(QSslSocket *socket, const QJsonObject &msg, qint64 nowMs);
+#endif
+    // Per message type, on decoded fields; shared by both dispatchers.
+    void handleHello(QSslSocket *socket, int protocolVersion);
+    void handlePing(QSslSocket *socket, quint64 pingId, qint64 nowMs);
+    void handlePong(QSslSocket *socket, qint64 nowMs);
+    void handleJoin(QSslSocket *socket, uint32_t ssrc, const QString &name, const QString &room, quint16 udpPort,
+                    qint64 nowMs);
+    void handleLeave(QSslSocket *socket, uint32_t ssrc);
+    void handleTalk(QSslSocket *socket, const ClientRegistry::ClientState &user, const QVector<uint32_t> &targets);
+    void handleSubscribe(QSslSocket *socket, const ClientRegistry::ClientState &user, const QSet<uint32_t> &sources,
+                         int maxStreams, bool filterEnabled, const QString &layer);
+    void handleVoiceFeedback(ClientRegistry::ClientState &user, const FeedbackReport &report);
+    void handleNack(const ClientRegistry::ClientState &receiver, uint32_t sourceSsrc, uint8_t layer, uint16_t first,
+                    uint32_t requested, qint64 nowMs);
+    void handleList(QSslSocket *socket);
     void sendToControlSocket(const QJsonObject &obj, QSslSocket *socket);
+    void writeControlLine(const QByteArray &line, QSslSocket *socket);
     uint8_t preferredLayerForReceiver(const ClientRegistry::ClientState &receiver) const;
-    bool shouldForwardToReceiver(const ClientRegistry::ClientState &source, const ClientRegistry::ClientState &receiver, qint64 nowMs) const;
-    QVector<uint32_t> topForwardableSourcesForReceiver(const ClientRegistry::ClientState &receiver, qint64 nowMs) const;
+    static bool canHear(const ClientRegistry::ClientState &source, const ClientRegistry::ClientState &receiver);
+    void rebuildForwardIndex(qint64 nowMs);
+    void pickSpeakers(const ClientRegistry::ClientState &receiver,
+                      const QVector<const ClientRegistry::ClientState *> &speakers, int limit, qint64 nowMs,
+                      QVector<uint32_t> &picked);
     QJsonObject makeServerAnnounce() const;
     void sendRaw(const QByteArray &payload, const QHostAddress &addr, quint16 port);
+    void noteVoiceActivity(uint32_t ssrc, const QHostAddress &sender, quint16 senderPort, bool voiced, qint64 nowMs);
     void broadcastUsers();
-    QJsonArray onlineUsersAsJson() const;
+    QByteArray usersLine() const;
+    qint64 livenessDeadline(const ClientRegistry::ClientState &client) const;
+    void armLiveness(const ClientRegistry::ClientState &client);
+    void pruneMediaState();
+    void planMix(ClientRegistry::RoomId roomId, qint64 nowMs, MediaPlane::Routes &routes);
+
+    struct NackBudget {
+        double tokens = 0.0;
+        qint64 refillMs = 0;
+    };
+
+    // A speaker holding one of a receiver's slots, since when.
+    struct SpeakerSlot {
+        uint32_t source = 0;
+        qint64 sinceMs = 0;
+    };
+
+    struct SpeakerCandidate {
+        uint32_t source = 0;
+        qint64 rankMs = 0;
+        qint64 sinceMs = 0;
+    };
 
-    QUdpSocket mediaSocket_;
+    MediaPlane mediaPlane_;
     QTcpServer controlServer_;
     QHash<QSslSocket *, QByteArray> controlBuffers_;
     QTimer pruneTimer_;
     QTimer presenceTimer_;
+    QTimer forwardIndexTimer_;
     quint16 listenPort_ = 0;
     QSslCertificate tlsCertificate_;
     QSslKey tlsPrivateKey_;
     QByteArray mediaSessionKeyRaw_;
     QString mediaSessionKeyB64_;
     ClientRegistry registry_;
+    TimerWheel livenessWheel_;
+    std::vector<TimerWheel::Key> expiredClients_;
+    // Last snapshot handed to the media thread; read here for NACKs.
+    std::shared_ptr<const MediaPlane::Routes> forwardRoutes_;
+    bool forwardIndexDirty_ = true;
+    QHash<uint32_t, QVector<SpeakerSlot>> speakerSlots_;     // Keyed by receiver, from the last rebuild
+    QHash<uint32_t, QVector<SpeakerSlot>> nextSpeakerSlots_;
+    std::vector<SpeakerCandidate> speakerCandidates_;
+    QHash<uint32_t, NackBudget> nackBudgets_;        // Keyed by receiver
+    RoomMixer::Options mixerOptions_;
 };
 
@@ -23,10 +23,11 @@ void ClientRegistry::updateJoin(uint32_t clientId, const QString &name, const QS
         return;
     }
     ClientState &s = byId_[clientId];
+    removeMember(s);
     s.clientId = clientId;
     s.name = name;
     s.room = room.trimmed().isEmpty() ? QStringLiteral("default") : room.trimmed();
-    s.online = true;
+    addMember(s);
     s.mediaAddress = addr;
     s.mediaPort = mediaPort;
     s.controlSocket = socket;
@@ -50,10 +51,18 @@ void ClientRegistry::markOfflineById(uint32_t clientId) {
     if (it == byId_.end()) {
         return;
     }
-    it->online = false;
+    removeMember(*it);
     it->controlSocket = nullptr;
 }
 
+void ClientRegistry::markOnline(uint32_t clientId) {
+    auto it = byId_.find(clientId);
+    if (it == byId_.end()) {
+        return;
+    }
+    addMember(*it);
+}
+
 void ClientRegistry::touch(uint32_t clientId, qint64 nowMs) {
     auto it = byId_.find(clientId);
     if (it == byId_.end()) {
@@ -104,13 +113,42 @@ ClientRegistry::ClientState *ClientRegistry::findBySocket(QSslSocket *socket) {
     return find(*sid);
 }
 
-QVector<ClientRegistry::ClientState> ClientRegistry::onlineClients() const {
-    QVector<ClientState> out;
-    out.reserve(byId_.size());
-    for (auto it = byId_.cbegin(); it != byId_.cend(); ++it) {
-        if (it->online) {
-            out.push_back(*it);
-        }
-    }
-    return out;
+ClientRegistry::RoomId ClientRegistry::internRoom(const QString &room) {
+    auto it = roomIds_.find(room);
+    if (it == roomIds_.end()) {
+        it = roomIds_.insert(room, nextRoomId_++);
+        roomNames_.insert(*it, room);
+    }
+    return *it;
+}
+
+void ClientRegistry::addMember(ClientState &client) {
+    if (client.online) {
+        return;
+    }
+    client.online = true;
+    client.roomId = internRoom(client.room);
+    members_[client.roomId].push_back(client.clientId);
+    ++onlineCount_;
+}
+
+void ClientRegistry::removeMember(ClientState &client) {
+    if (!client.online) {
+        return;
+    }
+    client.online = false;
+    --onlineCount_;
+    const RoomId roomId = client.roomId;
+    client.roomId = kNoRoom;
+    auto members = members_.find(roomId);
+    if (members == members_.end()) {
+        return;
+    }
+    members->removeOne(client.clientId);
+    // Room names come from clients, so one is only kept while someone is in
+    // it; otherwise fresh names on every join would grow the table forever.
+    if (members->isEmpty()) {
+        members_.erase(members);
+        roomIds_.remove(roomNames_.take(roomId));
+    }
 }
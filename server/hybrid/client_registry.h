@@ -12,16 +12,23 @@
 
 class ClientRegistry {
 public:
+    // A room name is interned while it has online members and dropped with
+    // its last one; ids are never reused, so a stale id matches nobody.
+    using RoomId = uint32_t;
+    static constexpr RoomId kNoRoom = 0;
+
     struct ClientState {
         uint32_t clientId = 0;
         QString name;
-        QString room = QStringLiteral("default");
-        bool online = false;
+        QString room = QStringLiteral("default"); // For presence; compare roomId instead
+        RoomId roomId = kNoRoom;                  // kNoRoom while offline
+        bool online = false;                      // Changed through the registry only
         QHostAddress mediaAddress;
         quint16 mediaPort = 0;
         QPointer<QSslSocket> controlSocket;
         qint64 lastSeenMs = 0;
         qint64 lastAudioMs = 0;
+        qint64 lastVoicedMs = 0;                  // Last report of voice rather than silence
         QVector<uint32_t> targets;
         bool subscriptionFilterEnabled = false;
         QSet<uint32_t> subscriptions;
@@ -37,6 +44,8 @@ public:
                     const QHostAddress &addr, quint16 mediaPort, QSslSocket *socket, qint64 nowMs);
     void markOfflineBySocket(QSslSocket *socket);
     void markOfflineById(uint32_t clientId);
+    // Back online in the room it last joined, e.g. on audio after a timeout.
+    void markOnline(uint32_t clientId);
     void touch(uint32_t clientId, qint64 nowMs);
     void setTalkTargets(uint32_t clientId, const QVector<uint32_t> &targets);
     void setSubscriptions(uint32_t clientId, const QSet<uint32_t> &sources, int maxStreams, bool filterEnabled, const QString &layer);
@@ -44,10 +53,51 @@ public:
     ClientState *find(uint32_t clientId);
     const ClientState *find(uint32_t clientId) const;
     ClientState *findBySocket(QSslSocket *socket);
-    QVector<ClientState> onlineClients() const;
+
+    int size() const { return byId_.size(); }
+    int onlineCount() const { return onlineCount_; }
+
+    template <typename Fn>
+    void forEachClient(Fn &&fn) const {
+        for (auto it = byId_.cbegin(); it != byId_.cend(); ++it) {
+            fn(*it);
+        }
+    }
+
+    // Online clients, in place. `fn` must not join, leave or mark anyone
+    // online or offline.
+    template <typename Fn>
+    void forEachOnline(Fn &&fn) const {
+        for (auto room = members_.cbegin(); room != members_.cend(); ++room) {
+            forEachInRoom(room.key(), fn);
+        }
+    }
+
+    template <typename Fn>
+    void forEachInRoom(RoomId room, Fn &&fn) const {
+        const auto members = members_.constFind(room);
+        if (members == members_.cend()) {
+            return;
+        }
+        for (uint32_t clientId : *members) {
+            fn(*byId_.constFind(clientId));
+        }
+    }
+
+    // Ids of the online members of each non-empty room.
+    const QHash<RoomId, QVector<uint32_t>> &rooms() const { return members_; }
 
 private:
+    RoomId internRoom(const QString &room);
+    void addMember(ClientState &client);
+    void removeMember(ClientState &client);
+
     uint32_t nextClientId_ = 1000;
     QHash<uint32_t, ClientState> byId_;
     QHash<QSslSocket *, uint32_t> socketToId_;
+    QHash<QString, RoomId> roomIds_;
+    QHash<RoomId, QString> roomNames_;
+    RoomId nextRoomId_ = kNoRoom + 1;
+    QHash<RoomId, QVector<uint32_t>> members_; // Online clients only
+    int onlineCount_ = 0;
 };
@@ -0,0 +1,469 @@
+#include "media_plane.h"
+
+#include <QJsonObject>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "shared/hybrid/control_messages.h"
+#include "shared/protocol/control_protocol.h"
+
+namespace {
+constexpr size_t kRecvBatch = 32;
+constexpr size_t kRecvSlotBytes = 8192;   // Opus and PCM voice frames alike
+constexpr size_t kSendBatch = 256;        // Flushes itself when full
+constexpr size_t kEventRingSize = 4096;
+constexpr size_t kRetransmitRingSize = 256;
+constexpr size_t kMixedRingSize = 64;      // Batches per mixer worker
+constexpr int kMaxDrainRounds = 8;
+// Activity reaches the control thread at most this often per source,
+// unless the source's address changes. Well inside the liveness and
+// active-speaker windows, and it is what bounds the cross-thread traffic.
+constexpr uint64_t kActivityReportMs = 250;
+constexpr uint32_t kPruneIntervalMs = 2000;
+constexpr uint64_t kSourceIdleMs = 15000;
+// Older than this, a retransmit would land after the receiver concealed the
+// frame anyway.
+constexpr uint64_t kRetransmitMaxAgeMs = 500;
+constexpr int kNackMaskBits = 16;
+constexpr uint32_t kMixIntervalMs = 20; // One Opus frame
+constexpr size_t kMixInputFrames = 3;   // Queued per source; older frames are dropped
+// Voice packets carry no level. With VBR and DTX off the client's encoder
+// spends a few bytes a frame on silence and room noise and several times
+// that on speech, so a frame counts as voiced well above its source's
+// quiet floor.
+constexpr int kMinVoicedPayloadBytes = 16;
+constexpr float kVoicedFloorRatio = 2.0f;
+
+uint64_t steadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+uint64_t retransmitKey(uint32_t ssrc, uint8_t layer) {
+    return (static_cast<uint64_t>(ssrc) << 8) | layer;
+}
+
+bool sameEndpoint(const sockaddr_in &a, const sockaddr_in &b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+QByteArray view(const uint8_t *data, int len) {
+    return QByteArray::fromRawData(reinterpret_cast<const char *>(data), len);
+}
+
+// encode_voice_packet is the one definition of the voice framing, so where
+// it keeps the sequence is read off two encodings rather than assumed here.
+// -1 unless the sequence is a plain two-byte field.
+int locateVoiceSequence(bool &bigEndian) {
+    ctrlproto::VoicePacket packet;
+    packet.ssrc = hybridctrl::kMixedSourceSsrc;
+    packet.flags = ctrlproto::kVoiceFlagOpus;
+    packet.payload = QByteArray(4, '\0');
+    packet.sequence = 0;
+    const QByteArray zero = ctrlproto::encode_voice_packet(packet);
+    packet.sequence = 0x1234;
+    const QByteArray probe = ctrlproto::encode_voice_packet(packet);
+    if (zero.isEmpty() || zero.size() != probe.size()) {
+        return -1;
+    }
+    int first = -1;
+    int differing = 0;
+    for (int i = 0; i < zero.size(); ++i) {
+        if (zero[i] != probe[i]) {
+            first = first < 0 ? i : first;
+            ++differing;
+        }
+    }
+    if (differing != 2 || first + 1 >= probe.size() || zero[first] != 0 || zero[first + 1] != 0) {
+        return -1;
+    }
+    const uint8_t high = static_cast<uint8_t>(probe[first]);
+    const uint8_t low = static_cast<uint8_t>(probe[first + 1]);
+    if (high == 0x12 && low == 0x34) {
+        bigEndian = true;
+    } else if (high == 0x34 && low == 0x12) {
+        bigEndian = false;
+    } else {
+        return -1;
+    }
+    return first;
+}
+} // namespace
+
+MediaPlane::MediaPlane()
+    : events_(kEventRingSize),
+      retransmits_(kRetransmitRingSize) {}
+
+MediaPlane::~MediaPlane() {
+    stop();
+    if (socket_ != INVALID_SOCKET) {
+        closesocket(socket_);
+    }
+}
+
+bool MediaPlane::open(uint16_t port) {
+#ifdef _WIN32
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+#endif
+    socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (socket_ == INVALID_SOCKET) {
+        return false;
+    }
+    // The control listener shares the port number over TCP; discovery
+    // announcements go out as broadcasts.
+    const int on = 1;
+    setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&on), sizeof(on));
+    setsockopt(socket_, SOL_SOCKET, SO_BROADCAST, reinterpret_cast<const char *>(&on), sizeof(on));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(socket_, reinterpret_cast<const sockaddr *>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(socket_);
+        socket_ = INVALID_SOCKET;
+        return false;
+    }
+
+#ifdef _WIN32
+    u_long nonBlocking = 1;
+    ioctlsocket(socket_, FIONBIO, &nonBlocking);
+#else
+    fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL, 0) | O_NONBLOCK);
+#endif
+    return reactor_.open([this]() { onWake(); });
+}
+
+void MediaPlane::enableMixing(const RoomMixer::Options &options) {
+    // The rings exist before any worker can deliver into one.
+    for (int i = 0; i < std::max(1, options.workers); ++i) {
+        mixedFrames_.push_back(std::make_unique<SpscRing<MixedBatch>>(kMixedRingSize));
+    }
+    mixSequenceOffset_ = locateVoiceSequence(mixSequenceBigEndian_);
+    mixer_ = std::make_unique<RoomMixer>(options, [this](size_t worker, MixedBatch &&frames) {
+        if (mixedFrames_[worker]->try_push(frames)) {
+            reactor_.wake();
+        }
+    });
+}
+
+void MediaPlane::start(const QByteArray &announce, WakeFn wake) {
+    announce_ = announce;
+    wake_ = std::move(wake);
+    if (!std::atomic_load(&routes_)) {
+        publish(std::make_shared<Routes>());
+    }
+    running_ = true;
+    thread_ = std::thread([this]() { run(); });
+}
+
+void MediaPlane::stop() {
+    if (!running_.exchange(false)) {
+        return;
+    }
+    reactor_.wake();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    mixer_.reset();
+}
+
+void MediaPlane::publish(std::shared_ptr<const Routes> routes) {
+    std::atomic_store(&routes_, std::move(routes));
+    routesVersion_.fetch_add(1, std::memory_order_release);
+}
+
+bool MediaPlane::requestRetransmit(uint32_t ssrc, uint8_t layer, uint16_t first, uint32_t mask, const sockaddr_in &to) {
+    if (!retransmits_.try_push(RetransmitRequest{ssrc, layer, first, mask, to})) {
+        return false;
+    }
+    reactor_.wake();
+    return true;
+}
+
+void MediaPlane::send(const char *data, int len, const sockaddr_in &to) {
+    sendto(socket_, data, len, 0, reinterpret_cast<const sockaddr *>(&to), sizeof(to));
+}
+
+void MediaPlane::run() {
+    BatchReceiver rx(kRecvBatch, kRecvSlotBytes);
+    BatchSender tx(kSendBatch);
+    reactor_.add_socket(socket_, [&]() { drainSocket(rx, tx); });
+    reactor_.add_timer(kPruneIntervalMs, [this]() { pruneSources(steadyMs()); });
+    if (mixer_) {
+        reactor_.add_timer(kMixIntervalMs, [this]() { mixTick(); });
+    }
+    while (running_) {
+        reactor_.run_once();
+    }
+}
+
+// view_ keeps the snapshot alive between publishes.
+const MediaPlane::Routes &MediaPlane::refreshRoutes() {
+    const uint64_t version = routesVersion_.load(std::memory_order_acquire);
+    if (version != viewVersion_ || !view_) {
+        view_ = std::atomic_load(&routes_);
+        viewVersion_ = version;
+    }
+    return *view_;
+}
+
+void MediaPlane::onWake() {
+    serveRetransmits();
+    if (mixer_) {
+        sendMixedFrames();
+    }
+}
+
+void MediaPlane::drainSocket(BatchReceiver &rx, BatchSender &tx) {
+    // Bounded so a flood cannot starve retransmits and pruning; the
+    // level-triggered reactor calls back at once if datagrams remain.
+    for (int round = 0; round < kMaxDrainRounds; ++round) {
+        const int received = rx.receive(socket_);
+        if (received == 0) {
+            return;
+        }
+        const uint64_t nowMs = steadyMs();
+        const Routes &routes = refreshRoutes();
+        for (int i = 0; i < received; ++i) {
+            const Datagram &dgram = rx.datagram(i);
+            if (dgram.len <= 0) {
+                continue;
+            }
+            // Discovery is JSON and always opens with '{'; anything else is
+            // taken as voice, so each datagram is decoded once.
+            if (dgram.data[0] == '{') {
+                handleDiscovery(dgram.data, dgram.len, dgram.from);
+                continue;
+            }
+
+            ctrlproto::VoicePacket packet;
+            if (!ctrlproto::decode_voice_packet(view(dgram.data, dgram.len), packet)) {
+                continue;
+            }
+            const auto route = routes.sources.find(packet.ssrc);
+            if (route == routes.sources.end()) {
+                continue;
+            }
+
+            const uint8_t layer = ctrlproto::voice_layer_from_flags(packet.flags);
+            const bool opus = (packet.flags & ctrlproto::kVoiceFlagOpus) != 0;
+            SourceState &source = sources_[packet.ssrc];
+            source.lastPacketMs = nowMs;
+            const bool voicedFrame =
+                layer == ctrlproto::kVoiceLayerHigh && opus && classifyFrame(source, packet.payload.size());
+            // Reported early when voice starts, so a new speaker is routed
+            // without waiting out the interval.
+            if (!sameEndpoint(source.reported, dgram.from) || nowMs - source.reportedMs >= kActivityReportMs
+                || (voicedFrame && !source.reportedVoiced)) {
+                Event event;
+                event.ssrc = packet.ssrc;
+                event.from = dgram.from;
+                event.voiced = (voicedFrame && !source.reportedVoiced)
+                               || (source.voicedFrames > 0 && source.voicedFrames * 4 >= source.frames);
+                if (postEvent(event)) {
+                    source.reported = dgram.from;
+                    source.reportedMs = nowMs;
+                    source.reportedVoiced = event.voiced;
+                    source.frames = 0;
+                    source.voicedFrames = 0;
+                }
+            }
+
+            remember(packet.ssrc, layer, packet.sequence, dgram.data, dgram.len, nowMs);
+            if (route->second.mixed) {
+                // The mixer decodes the high layer only.
+                if (layer == ctrlproto::kVoiceLayerHigh && opus) {
+                    queueMixInput(packet.ssrc, packet.payload);
+                }
+                continue;
+            }
+            for (const Target &target : route->second.targets) {
+                if (target.layer == layer) {
+                    tx.queue(socket_, dgram.data, dgram.len, target.to);
+                }
+            }
+        }
+        // Copies reference the receive slots, so they must leave before the
+        // next receive() reuses them.
+        tx.flush(socket_);
+    }
+}
+
+void MediaPlane::handleDiscovery(const uint8_t *data, int len, const sockaddr_in &from) {
+    QJsonObject msg;
+    if (!ctrlproto::decode(view(data, len), msg)) {
+        return;
+    }
+    if (msg.value(QStringLiteral("type")).toString() == QStringLiteral("discover_request")) {
+        send(announce_.constData(), announce_.size(), from);
+    }
+}
+
+// The floor drops quickly to quiet frames and creeps up slowly, so a long
+// talk spurt barely moves it while a louder room raises it within a minute.
+bool MediaPlane::classifyFrame(SourceState &source, int bytes) {
+    const float size = static_cast<float>(bytes);
+    const bool voiced = bytes >= kMinVoicedPayloadBytes && size >= source.quietBytes * kVoicedFloorRatio;
+    source.quietBytes += (size - source.quietBytes) * (size < source.quietBytes ? 0.125f : 0.0005f);
+    if (source.frames < UINT16_MAX) {
+        ++source.frames;
+        source.voicedFrames += voiced ? 1 : 0;
+    }
+    return voiced;
+}
+
+void MediaPlane::queueMixInput(uint32_t ssrc, const QByteArray &opus) {
+    std::deque<QByteArray> &queued = mixInput_[ssrc];
+    if (queued.size() >= kMixInputFrames) {
+        queued.pop_front();
+    }
+    // Deep copy: the payload may still point into the receive slot.
+    queued.emplace_back(opus.constData(), opus.size());
+}
+
+// One job per planned room, with the oldest queued frame of each source its
+// mixes use. The mixes themselves are shared with the snapshot, not copied.
+void MediaPlane::mixTick() {
+    const Routes &routes = refreshRoutes();
+    const uint32_t timestampMs = static_cast<uint32_t>(steadyMs() & 0xFFFFFFFFULL);
+    for (const MixPlan &plan : routes.mixes) {
+        RoomMixer::Job job = plan.job;
+        job.timestampMs = timestampMs;
+        for (uint32_t ssrc : plan.sources) {
+            const auto queued = mixInput_.find(ssrc);
+            if (queued == mixInput_.end() || queued->second.empty()) {
+                continue;
+            }
+            job.frames.push_back(RoomMixer::SourceFrame{ssrc, std::move(queued->second.front())});
+            queued->second.pop_front();
+        }
+        if (!job.frames.isEmpty()) {
+            mixer_->submit(std::move(job));
+        }
+    }
+}
+
+// Each frame is encoded once; listeners differ only in their sequence,
+// which is patched into the same datagram before each send.
+void MediaPlane::sendMixedFrames() {
+    const Routes &routes = refreshRoutes();
+    MixedBatch frames;
+    for (const auto &ring : mixedFrames_) {
+        while (ring->try_pop(frames)) {
+            for (const RoomMixer::MixedFrame &frame : frames) {
+                ctrlproto::VoicePacket packet;
+                packet.ssrc = hybridctrl::kMixedSourceSsrc;
+                packet.timestampMs = frame.timestampMs;
+                packet.flags = ctrlproto::voice_flags_with_layer(
+                    ctrlproto::kVoiceFlagOpus,
+                    frame.bitrate == RoomMixer::kLowBitrate ? ctrlproto::kVoiceLayerLow : ctrlproto::kVoiceLayerHigh);
+                packet.payload = frame.opus;
+                mixDatagram_ = ctrlproto::encode_voice_packet(packet);
+                if (mixDatagram_.isEmpty()) {
+                    continue;
+                }
+                for (uint32_t receiverId : frame.receivers) {
+                    const auto to = routes.mixListeners.find(receiverId);
+                    if (to == routes.mixListeners.end()) {
+                        continue;
+                    }
+                    const uint16_t sequence = mixSequence_[receiverId]++;
+                    if (mixSequenceOffset_ < 0) {
+                        packet.sequence = sequence;
+                        const QByteArray datagram = ctrlproto::encode_voice_packet(packet);
+                        send(datagram.constData(), datagram.size(), to->second);
+                        continue;
+                    }
+                    char *field = mixDatagram_.data() + mixSequenceOffset_;
+                    field[mixSequenceBigEndian_ ? 0 : 1] = static_cast<char>(sequence >> 8);
+                    field[mixSequenceBigEndian_ ? 1 : 0] = static_cast<char>(sequence & 0xFF);
+                    send(mixDatagram_.constData(), mixDatagram_.size(), to->second);
+                }
+            }
+        }
+    }
+}
+
+void MediaPlane::remember(uint32_t ssrc, uint8_t layer, uint16_t sequence, const uint8_t *data, int len,
+                          uint64_t nowMs) {
+    RetransmitSlot &slot = retransmitCache_[retransmitKey(ssrc, layer)][sequence % kRetransmitSlots];
+    slot.sequence = sequence;
+    slot.storedMs = nowMs;
+    slot.datagram.assign(data, data + len);
+}
+
+// Answered from the cache alone; the sender never hears about the loss.
+void MediaPlane::serveRetransmits() {
+    const uint64_t nowMs = steadyMs();
+    RetransmitRequest request;
+    while (retransmits_.try_pop(request)) {
+        const auto ring = retransmitCache_.find(retransmitKey(request.ssrc, request.layer));
+        if (ring == retransmitCache_.end()) {
+            continue;
+        }
+        for (int i = 0; i <= kNackMaskBits; ++i) {
+            if (i > 0 && (request.mask & (1u << (i - 1))) == 0) {
+                continue;
+            }
+            const uint16_t sequence = static_cast<uint16_t>(request.first + i);
+            const RetransmitSlot &slot = ring->second[sequence % kRetransmitSlots];
+            if (slot.datagram.empty() || slot.sequence != sequence || nowMs - slot.storedMs > kRetransmitMaxAgeMs) {
+                continue;
+            }
+            send(reinterpret_cast<const char *>(slot.datagram.data()), static_cast<int>(slot.datagram.size()),
+                 request.to);
+        }
+    }
+}
+
+void MediaPlane::pruneSources(uint64_t nowMs) {
+    for (auto it = sources_.begin(); it != sources_.end();) {
+        if (nowMs - it->second.lastPacketMs > kSourceIdleMs) {
+            it = sources_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    for (auto it = retransmitCache_.begin(); it != retransmitCache_.end();) {
+        if (sources_.find(static_cast<uint32_t>(it->first >> 8)) == sources_.end()) {
+            it = retransmitCache_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+
+    const Routes &routes = refreshRoutes();
+    for (auto it = mixInput_.begin(); it != mixInput_.end();) {
+        const auto route = routes.sources.find(it->first);
+        if (route == routes.sources.end() || !route->second.mixed || sources_.find(it->first) == sources_.end()) {
+            it = mixInput_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    for (auto it = mixSequence_.begin(); it != mixSequence_.end();) {
+        if (routes.mixListeners.find(it->first) == routes.mixListeners.end()) {
+            it = mixSequence_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+bool MediaPlane::postEvent(const Event &event) {
+    if (!events_.try_push(event)) {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!wakePending_.exchange(true, std::memory_order_acq_rel) && wake_) {
+        wake_();
+    }
+    return true;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <QByteArray>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "server/hybrid/room_mixer.h"
+#include "sfu/batch_io.h"
+#include "sfu/reactor.h"
+#include "sfu/sfu_socket.h"
+#include "sfu/spsc_ring.h"
+
+// The control server's UDP media path, on a thread of its own so TLS
+// handshakes, JSON parsing and presence broadcasts on the Qt event loop
+// never sit in front of audio. The thread owns a native socket and
+// preallocated receive slots, classifies each datagram by its first byte,
+// and forwards voice through the last Routes snapshot the control thread
+// published; it reads no other server state. What it observes goes back
+// as Events, and retransmit requests come in through a ring of their own.
+// Mixed rooms are clocked here too: the thread hands each 20 ms job to the
+// mixer and sends what the workers return, so mixed audio never waits on
+// the Qt event loop either.
+class MediaPlane {
+public:
+    // One receiver a source's packets go to, resolved by the control thread.
+    struct Target {
+        uint32_t receiverId = 0;
+        sockaddr_in to{};
+        uint8_t layer = 0;
+    };
+
+    struct Source {
+        std::vector<Target> targets;
+        bool mixed = false; // Listeners get the room mix instead
+    };
+
+    // What one mixed room hears: the control thread fills in the mixes and
+    // their listeners, and the media thread adds the frames each tick.
+    struct MixPlan {
+        RoomMixer::Job job;
+        std::vector<uint32_t> sources; // Every source some mix in `job` uses
+    };
+
+    // Immutable once published. Every registered client has an entry, so
+    // an ssrc the registry does not know is dropped without a lookup miss
+    // on the control thread.
+    struct Routes {
+        std::unordered_map<uint32_t, Source> sources;
+        std::vector<MixPlan> mixes;
+        std::unordered_map<uint32_t, sockaddr_in> mixListeners;
+    };
+
+    // Media thread -> control thread: `ssrc` is sending from `from`, and
+    // whether it has been sending voice or only silence since the last one.
+    struct Event {
+        uint32_t ssrc = 0;
+        sockaddr_in from{};
+        bool voiced = false;
+    };
+
+    // Runs on the media thread when events are waiting and no wake is
+    // outstanding; it should schedule takeEvents() on the control thread.
+    using WakeFn = std::function<void()>;
+
+    MediaPlane();
+    ~MediaPlane();
+
+    MediaPlane(const MediaPlane &) = delete;
+    MediaPlane &operator=(const MediaPlane &) = delete;
+
+    bool open(uint16_t port);
+    // Before start(). Mixes the rooms the published routes plan for.
+    void enableMixing(const RoomMixer::Options &options);
+    // `announce` answers discovery requests.
+    void start(const QByteArray &announce, WakeFn wake);
+    void stop();
+
+    // Control thread. Readers pick the new snapshot up on their next batch.
+    void publish(std::shared_ptr<const Routes> routes);
+
+    // Control thread. Resends what the cache still holds of `first` and the
+    // sequences set in `mask` (bit i = first + i + 1).
+    bool requestRetransmit(uint32_t ssrc, uint8_t layer, uint16_t first, uint32_t mask, const sockaddr_in &to);
+
+    // Control thread.
+    template <typename Fn>
+    void takeEvents(Fn &&fn) {
+        // Cleared first: an event pushed while draining wakes us again. The
+        // fence pairs with the one in postEvent(), so either the first pop
+        // sees the producer's event or the producer sees the flag cleared.
+        wakePending_.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        Event event;
+        while (events_.try_pop(event)) {
+            fn(event);
+        }
+    }
+
+    // Any thread; plain datagram sends on the media socket.
+    void send(const char *data, int len, const sockaddr_in &to);
+
+private:
+    struct RetransmitRequest {
+        uint32_t ssrc = 0;
+        uint8_t layer = 0;
+        uint16_t first = 0;
+        uint32_t mask = 0;
+        sockaddr_in to{};
+    };
+
+    // Everything below is touched by the media thread only.
+    struct RetransmitSlot {
+        uint16_t sequence = 0;
+        uint64_t storedMs = 0;
+        std::vector<uint8_t> datagram; // Capacity is kept across reuse
+    };
+    static constexpr int kRetransmitSlots = 64;
+    using RetransmitRing = std::array<RetransmitSlot, kRetransmitSlots>;
+
+    struct SourceState {
+        sockaddr_in reported{};
+        uint64_t reportedMs = 0;
+        uint64_t lastPacketMs = 0;
+        float quietBytes = 16.0f; // Running floor of high-layer frame sizes
+        uint16_t frames = 0;      // High-layer frames since the last report
+        uint16_t voicedFrames = 0;
+        bool reportedVoiced = false;
+    };
+
+    using MixedBatch = QVector<RoomMixer::MixedFrame>;
+
+    void run();
+    void onWake();
+    void drainSocket(BatchReceiver &rx, BatchSender &tx);
+    void handleDiscovery(const uint8_t *data, int len, const sockaddr_in &from);
+    static bool classifyFrame(SourceState &source, int bytes);
+    void queueMixInput(uint32_t ssrc, const QByteArray &opus);
+    void mixTick();
+    void sendMixedFrames();
+    void remember(uint32_t ssrc, uint8_t layer, uint16_t sequence, const uint8_t *data, int len, uint64_t nowMs);
+    void serveRetransmits();
+    void pruneSources(uint64_t nowMs);
+    bool postEvent(const Event &event);
+    const Routes &refreshRoutes();
+
+    SocketHandle socket_ = INVALID_SOCKET;
+    Reactor reactor_;
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    QByteArray announce_;
+    WakeFn wake_;
+
+    std::shared_ptr<const Routes> routes_; // Accessed via std::atomic_load/store
+    std::atomic<uint64_t> routesVersion_{0};
+    SpscRing<Event> events_;
+    std::atomic<bool> wakePending_{false};
+    SpscRing<RetransmitRequest> retransmits_;
+    std::unique_ptr<RoomMixer> mixer_;
+    std::vector<std::unique_ptr<SpscRing<MixedBatch>>> mixedFrames_; // One per mixer worker
+
+    std::shared_ptr<const Routes> view_;
+    uint64_t viewVersion_ = 0;
+    std::unordered_map<uint32_t, SourceState> sources_;
+    std::unordered_map<uint64_t, RetransmitRing> retransmitCache_; // Keyed by ssrc and layer
+    std::unordered_map<uint32_t, std::deque<QByteArray>> mixInput_;  // Opus frames waiting per source
+    std::unordered_map<uint32_t, uint16_t> mixSequence_;             // Next mixed-stream sequence per listener
+    QByteArray mixDatagram_;         // The frame being sent, patched per listener
+    int mixSequenceOffset_ = -1;     // Sequence position in an encoded voice packet, -1 if unknown
+    bool mixSequenceBigEndian_ = true;
+};
@@ -0,0 +1,298 @@
+#include "room_mixer.h"
+
+#include "constants.h"
+
+#include <opus.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ROOM_MIXER_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define ROOM_MIXER_NEON 1
+#endif
+
+namespace {
+constexpr int kFrameSamples = FRAME_SIZE * CHANNELS; // 960
+constexpr int kMaxOpusPacketBytes = 512;
+constexpr size_t kMaxQueuedJobs = 8;      // Per worker; a late mix is a useless mix
+constexpr int64_t kIdleCodecMs = 5000;    // Free a room's codecs this long after last use
+constexpr int64_t kSweepIntervalMs = 1000;
+
+int64_t steadyMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+using Frame = std::array<opus_int16, kFrameSamples>;
+
+// dst += src, saturating at the int16 range.
+void mixSaturating(opus_int16 *dst, const opus_int16 *src, int n) {
+    int i = 0;
+#if defined(ROOM_MIXER_SSE2)
+    for (; i + 8 <= n; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_adds_epi16(a, b));
+    }
+#elif defined(ROOM_MIXER_NEON)
+    for (; i + 8 <= n; i += 8) {
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vld1q_s16(src + i)));
+    }
+#endif
+    for (; i < n; ++i) {
+        const int sum = static_cast<int>(dst[i]) + static_cast<int>(src[i]);
+        dst[i] = static_cast<opus_int16>(std::clamp(sum, -32768, 32767));
+    }
+}
+
+OpusEncoder *createEncoder(int bitrate) {
+    int err = 0;
+    OpusEncoder *enc = opus_encoder_create(SAMPLE_RATE, CHANNELS, OPUS_APPLICATION_VOIP, &err);
+    if (!enc || err != OPUS_OK) {
+        return nullptr;
+    }
+    opus_encoder_ctl(enc, OPUS_SET_BITRATE(bitrate));
+    opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(4));
+    opus_encoder_ctl(enc, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(1));
+    opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(10));
+    opus_encoder_ctl(enc, OPUS_SET_DTX(0));
+    return enc;
+}
+} // namespace
+
+QByteArray RoomMixer::mixKey(const MixSet &mix) {
+    QByteArray key;
+    key.reserve(static_cast<int>(sizeof(int) + mix.sources.size() * sizeof(uint32_t)));
+    key.append(reinterpret_cast<const char *>(&mix.bitrate), sizeof(mix.bitrate));
+    key.append(reinterpret_cast<const char *>(mix.sources.constData()),
+               static_cast<int>(mix.sources.size() * sizeof(uint32_t)));
+    return key;
+}
+
+RoomMixer::RoomMixer(const Options &options, DeliverFn deliver)
+    : options_(options),
+      deliver_(std::move(deliver)) {
+    const int count = std::max(1, options_.workers);
+    for (int i = 0; i < count; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+        workers_.back()->index = static_cast<size_t>(i);
+    }
+    for (auto &worker : workers_) {
+        Worker *w = worker.get();
+        w->thread = std::thread([this, w]() { run(*w); });
+    }
+}
+
+RoomMixer::~RoomMixer() {
+    for (auto &worker : workers_) {
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            worker->stopping = true;
+        }
+        worker->wake.notify_one();
+    }
+    for (auto &worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+        for (RoomCodecs &codecs : worker->rooms) {
+            releaseCodecs(codecs, INT64_MAX);
+        }
+    }
+}
+
+void RoomMixer::submit(Job &&job) {
+    Worker &worker = *workers_[job.roomId % workers_.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.queue.size() >= kMaxQueuedJobs) {
+            worker.queue.pop_front();
+        }
+        worker.queue.push_back(std::move(job));
+    }
+    worker.wake.notify_one();
+}
+
+void RoomMixer::run(Worker &worker) {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.wake.wait(lock, [&worker]() { return worker.stopping || !worker.queue.empty(); });
+            if (worker.stopping) {
+                return;
+            }
+            job = std::move(worker.queue.front());
+            worker.queue.pop_front();
+        }
+        const int64_t nowMs = steadyMs();
+        mixRoom(worker, job, nowMs);
+        if (nowMs - worker.lastSweepMs >= kSweepIntervalMs) {
+            worker.lastSweepMs = nowMs;
+            sweepIdle(worker, nowMs);
+        }
+    }
+}
+
+void RoomMixer::mixRoom(Worker &worker, const Job &job, int64_t nowMs) {
+    RoomCodecs &codecs = worker.rooms[job.roomId];
+
+    // Each source is decoded once, whatever number of mixes it is in.
+    QHash<uint32_t, int> decodedIndex;
+    std::vector<Frame> decoded;
+    decoded.reserve(static_cast<size_t>(job.frames.size()));
+    for (const SourceFrame &frame : job.frames) {
+        Decoder &decoder = codecs.decoders[frame.ssrc];
+        if (!decoder.decoder) {
+            int err = 0;
+            decoder.decoder = opus_decoder_create(SAMPLE_RATE, CHANNELS, &err);
+            if (!decoder.decoder || err != OPUS_OK) {
+                codecs.decoders.remove(frame.ssrc);
+                continue;
+            }
+        }
+        decoder.lastUsedMs = nowMs;
+        Frame pcm{};
+        const int n = opus_decode(decoder.decoder,
+                                  reinterpret_cast<const unsigned char *>(frame.opus.constData()),
+                                  static_cast<opus_int32>(frame.opus.size()),
+                                  pcm.data(), kFrameSamples, 0);
+        if (n != kFrameSamples) {
+            continue;
+        }
+        decodedIndex.insert(frame.ssrc, static_cast<int>(decoded.size()));
+        decoded.push_back(pcm);
+    }
+
+    QVector<MixedFrame> out;
+    out.reserve(job.mixes.size());
+    QSet<uint32_t> claimed; // Encoders already used for this frame
+    std::array<unsigned char, kMaxOpusPacketBytes> packet{};
+    for (const MixSet &mix : job.mixes) {
+        Frame sum{};
+        bool audible = false;
+        for (uint32_t ssrc : mix.sources) {
+            const auto index = decodedIndex.constFind(ssrc);
+            if (index == decodedIndex.constEnd()) {
+                continue;
+            }
+            mixSaturating(sum.data(), decoded[static_cast<size_t>(*index)].data(), kFrameSamples);
+            audible = true;
+        }
+        if (!audible) {
+            continue;
+        }
+
+        uint32_t encoderId = 0;
+        Encoder *encoder = encoderFor(codecs, mix, claimed, encoderId);
+        if (!encoder) {
+            continue;
+        }
+        claimed.insert(encoderId);
+        for (uint32_t receiver : mix.receivers) {
+            codecs.listenerEncoder.insert(receiver, encoderId);
+        }
+        encoder->lastUsedMs = nowMs;
+        const opus_int32 n = opus_encode(encoder->encoder, sum.data(), kFrameSamples, packet.data(), kMaxOpusPacketBytes);
+        if (n <= 0) {
+            continue;
+        }
+        MixedFrame mixed;
+        mixed.timestampMs = job.timestampMs;
+        mixed.bitrate = mix.bitrate;
+        mixed.opus = QByteArray(reinterpret_cast<const char *>(packet.data()), static_cast<int>(n));
+        mixed.receivers = mix.receivers;
+        out.push_back(std::move(mixed));
+    }
+
+    if (!out.isEmpty()) {
+        deliver_(worker.index, std::move(out));
+    }
+}
+
+// Continues the encoder most of the mix's listeners had last frame, unless
+// another mix of this frame already took it; a cold encoder is only created
+// when listeners split off into a new mix.
+RoomMixer::Encoder *RoomMixer::encoderFor(RoomCodecs &codecs, const MixSet &mix, const QSet<uint32_t> &claimed,
+                                          uint32_t &id) {
+    QHash<uint32_t, int> votes;
+    uint32_t best = 0;
+    int bestVotes = 0;
+    for (uint32_t receiver : mix.receivers) {
+        const auto previous = codecs.listenerEncoder.constFind(receiver);
+        if (previous == codecs.listenerEncoder.constEnd() || claimed.contains(*previous) ||
+            !codecs.encoders.contains(*previous)) {
+            continue;
+        }
+        const int count = ++votes[*previous];
+        if (count > bestVotes) {
+            best = *previous;
+            bestVotes = count;
+        }
+    }
+
+    if (bestVotes > 0) {
+        Encoder &encoder = codecs.encoders[best];
+        if (encoder.bitrate != mix.bitrate) {
+            opus_encoder_ctl(encoder.encoder, OPUS_SET_BITRATE(mix.bitrate));
+            encoder.bitrate = mix.bitrate;
+        }
+        id = best;
+        return &encoder;
+    }
+
+    Encoder fresh;
+    fresh.encoder = createEncoder(mix.bitrate);
+    if (!fresh.encoder) {
+        return nullptr;
+    }
+    fresh.bitrate = mix.bitrate;
+    id = codecs.nextEncoderId++;
+    return &codecs.encoders.insert(id, fresh).value();
+}
+
+// Mix sets change as people start and stop talking, and rooms stop being
+// mixed when they shrink; their codecs are freed once unused for a while.
+void RoomMixer::sweepIdle(Worker &worker, int64_t nowMs) {
+    for (auto it = worker.rooms.begin(); it != worker.rooms.end();) {
+        releaseCodecs(it.value(), nowMs - kIdleCodecMs);
+        if (it->decoders.isEmpty() && it->encoders.isEmpty()) {
+            it = worker.rooms.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
+
+void RoomMixer::releaseCodecs(RoomCodecs &codecs, int64_t usedBeforeMs) {
+    for (auto it = codecs.decoders.begin(); it != codecs.decoders.end();) {
+        if (it->lastUsedMs < usedBeforeMs) {
+            opus_decoder_destroy(it->decoder);
+            it = codecs.decoders.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    for (auto it = codecs.encoders.begin(); it != codecs.encoders.end();) {
+        if (it->lastUsedMs < usedBeforeMs) {
+            opus_encoder_destroy(it->encoder);
+            it = codecs.encoders.erase(it);
+            continue;
+        }
+        ++it;
+    }
+    for (auto it = codecs.listenerEncoder.begin(); it != codecs.listenerEncoder.end();) {
+        if (!codecs.encoders.contains(*it)) {
+            it = codecs.listenerEncoder.erase(it);
+            continue;
+        }
+        ++it;
+    }
+}
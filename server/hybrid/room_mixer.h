@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct OpusDecoder;
+struct OpusEncoder;
+
+// Server-side mixing for large rooms. Every 20 ms the control server hands
+// over one job per mixed room: the Opus frame each active source sent, and
+// the distinct sets of sources its listeners should hear. A worker decodes
+// each source once, sums every set and encodes it once, however many
+// listeners share it. Each set is encoded by the encoder most of its
+// listeners used for the previous frame, so a listener's stream keeps one
+// encoder state while the sources in it change. Rooms are pinned to one
+// worker, so the stateful Opus decoders and encoders of a room are only
+// ever touched by one thread.
+class RoomMixer {
+public:
+    struct Options {
+        int roomSize = 0;   // Mix rooms with at least this many online clients; 0 = off
+        int maxSources = 4; // Sources per mix
+        int workers = 2;
+    };
+
+    // Per listener, from the layer it would otherwise be forwarded.
+    static constexpr int kLowBitrate = 16000;
+    static constexpr int kHighBitrate = 32000;
+
+    struct SourceFrame {
+        uint32_t ssrc = 0;
+        QByteArray opus;
+    };
+
+    struct MixSet {
+        QVector<uint32_t> sources; // Sorted
+        int bitrate = kHighBitrate;
+        QVector<uint32_t> receivers;
+    };
+
+    struct Job {
+        uint32_t roomId = 0; // ClientRegistry::RoomId
+        uint32_t timestampMs = 0;
+        QVector<SourceFrame> frames;
+        QVector<MixSet> mixes;
+    };
+
+    struct MixedFrame {
+        uint32_t timestampMs = 0;
+        int bitrate = kHighBitrate;
+        QByteArray opus;
+        QVector<uint32_t> receivers;
+    };
+
+    // Runs on worker `worker` (0 .. workerCount() - 1), so a consumer can
+    // give each worker a single-producer queue of its own.
+    using DeliverFn = std::function<void(size_t worker, QVector<MixedFrame> &&)>;
+
+    RoomMixer(const Options &options, DeliverFn deliver);
+    ~RoomMixer();
+
+    RoomMixer(const RoomMixer &) = delete;
+    RoomMixer &operator=(const RoomMixer &) = delete;
+
+    // Listeners whose mixes share a key hear the same mix.
+    static QByteArray mixKey(const MixSet &mix);
+
+    const Options &options() const { return options_; }
+    size_t workerCount() const { return workers_.size(); }
+    void submit(Job &&job);
+
+private:
+    struct Encoder {
+        OpusEncoder *encoder = nullptr;
+        int bitrate = 0;
+        int64_t lastUsedMs = 0;
+    };
+
+    struct Decoder {
+        OpusDecoder *decoder = nullptr;
+        int64_t lastUsedMs = 0;
+    };
+
+    struct RoomCodecs {
+        QHash<uint32_t, Decoder> decoders;
+        QHash<uint32_t, Encoder> encoders;     // Keyed by an id local to the room
+        QHash<uint32_t, uint32_t> listenerEncoder; // Receiver -> encoder of its last mix
+        uint32_t nextEncoderId = 1;
+    };
+
+    struct Worker {
+        size_t index = 0;
+        std::thread thread;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<Job> queue;
+        bool stopping = false;
+        QHash<uint32_t, RoomCodecs> rooms; // Worker thread only
+        int64_t lastSweepMs = 0;           // Worker thread only
+    };
+
+    void run(Worker &worker);
+    void mixRoom(Worker &worker, const Job &job, int64_t nowMs);
+    static void sweepIdle(Worker &worker, int64_t nowMs);
+    static Encoder *encoderFor(RoomCodecs &codecs, const MixSet &mix, const QSet<uint32_t> &claimed, uint32_t &id);
+    static void releaseCodecs(RoomCodecs &codecs, int64_t usedBeforeMs);
+
+    Options options_;
+    DeliverFn deliver_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+};
@@ -7,21 +7,45 @@ int main(int argc, char *argv[]) {
     QCoreApplication app(argc, argv);
 
     quint16 port = DEFAULT_CONTROL_PORT;
-    if (argc > 1) {
+    RoomMixer::Options mixer;
+    for (int i = 1; i < argc; ++i) {
+        const QString arg = QString::fromLocal8Bit(argv[i]);
         bool ok = false;
-        const int parsed = QString::fromLocal8Bit(argv[1]).toInt(&ok);
-        if (ok && parsed > 0 && parsed <= 65535) {
-            port = static_cast<quint16>(parsed);
+        if (arg == QStringLiteral("--mix-room-size") && i + 1 < argc) {
+            const int parsed = QString::fromLocal8Bit(argv[++i]).toInt(&ok);
+            if (ok && parsed >= 0) {
+                mixer.roomSize = parsed;
+            }
+        } else if (arg == QStringLiteral("--mix-sources") && i + 1 < argc) {
+            const int parsed = QString::fromLocal8Bit(argv[++i]).toInt(&ok);
+            if (ok && parsed >= 1 && parsed <= 16) {
+                mixer.maxSources = parsed;
+            }
+        } else if (arg == QStringLiteral("--mix-workers") && i + 1 < argc) {
+            const int parsed = QString::fromLocal8Bit(argv[++i]).toInt(&ok);
+            if (ok && parsed >= 1 && parsed <= 64) {
+                mixer.workers = parsed;
+            }
+        } else {
+            const int parsed = arg.toInt(&ok);
+            if (ok && parsed > 0 && parsed <= 65535) {
+                port = static_cast<quint16>(parsed);
+            }
         }
     }
 
     ControlServer server;
+    server.setMixerOptions(mixer);
     if (!server.start(port)) {
         qCritical() << "Failed to start hybrid control/media server on port" << port;
         return 1;
     }
 
     qInfo() << "VoIP server listening: TCP control + UDP media on port" << port;
+    if (mixer.roomSize > 0) {
+        qInfo() << "Mixing rooms of" << mixer.roomSize << "or more clients:" << mixer.maxSources
+                << "sources per mix," << mixer.workers << "mixer threads";
+    }
     return app.exec();
 }
 
@@ -1,44 +1,239 @@
 #include "permission_manager.h"
 
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PERMISSION_HAS_SSE2 1
+#endif
+
+namespace {
+void set_bit(PermissionManager::Bitset& bits, uint32_t slot) {
+    bits[slot / 64] |= (uint64_t{1} << (slot % 64));
+}
+
+void clear_bit(PermissionManager::Bitset& bits, uint32_t slot) {
+    bits[slot / 64] &= ~(uint64_t{1} << (slot % 64));
+}
+
+bool test_bit(const PermissionManager::Bitset& bits, uint32_t slot) {
+    return slot / 64 < bits.size() && (bits[slot / 64] >> (slot % 64)) & 1u;
+}
+
+// out = (a | b) & ~mask, two words per step where SSE2 is available.
+template <bool HasB, bool HasMask>
+void combine(uint64_t* out, const uint64_t* a, const uint64_t* b, const uint64_t* mask, size_t words) {
+    size_t i = 0;
+#ifdef PERMISSION_HAS_SSE2
+    for (; i + 2 <= words; i += 2) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        if (HasB) {
+            v = _mm_or_si128(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        }
+        if (HasMask) {
+            v = _mm_andnot_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask + i)), v);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), v);
+    }
+#endif
+    for (; i < words; ++i) {
+        uint64_t v = a[i];
+        if (HasB) {
+            v |= b[i];
+        }
+        if (HasMask) {
+            v &= ~mask[i];
+        }
+        out[i] = v;
+    }
+}
+}
+
+uint32_t PermissionManager::slot_of(uint32_t ssrc) const {
+    auto it = slot_by_ssrc_.find(ssrc);
+    return it != slot_by_ssrc_.end() ? it->second : kNoSlot;
+}
+
+uint32_t PermissionManager::channel_of(uint32_t ssrc) const {
+    const uint32_t slot = slot_of(ssrc);
+    return slot != kNoSlot ? channel_by_slot_[slot] : kNoChannel;
+}
+
+void PermissionManager::grow_bitsets(size_t words) {
+    if (words <= words_) {
+        return;
+    }
+    words_ = words;
+    live_.resize(words_, 0);
+    unassigned_.resize(words_, 0);
+    for (auto& [_, members] : members_by_channel_) {
+        members.resize(words_, 0);
+    }
+    for (Bitset& row : muted_by_) {
+        if (!row.empty()) {
+            row.resize(words_, 0);
+        }
+    }
+}
+
+uint32_t PermissionManager::acquire_slot(uint32_t ssrc) {
+    const uint32_t existing = slot_of(ssrc);
+    if (existing != kNoSlot) {
+        return existing;
+    }
+
+    uint32_t slot;
+    if (!free_slots_.empty()) {
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        ssrc_by_slot_[slot] = ssrc;
+        channel_by_slot_[slot] = kNoChannel;
+    } else {
+        slot = static_cast<uint32_t>(ssrc_by_slot_.size());
+        ssrc_by_slot_.push_back(ssrc);
+        channel_by_slot_.push_back(kNoChannel);
+        muted_by_.emplace_back();
+        muting_.emplace_back();
+        grow_bitsets((ssrc_by_slot_.size() + 63) / 64);
+    }
+    slot_by_ssrc_[ssrc] = slot;
+    set_bit(live_, slot);
+    set_bit(unassigned_, slot);
+    return slot;
+}
+
+PermissionManager::Bitset& PermissionManager::channel_members(uint32_t channel_id) {
+    Bitset& members = members_by_channel_[channel_id];
+    members.resize(words_, 0);
+    return members;
+}
+
+void PermissionManager::add_user(uint32_t ssrc) {
+    acquire_slot(ssrc);
+}
+
 void PermissionManager::set_channel(uint32_t ssrc, uint32_t channel_id) {
-    channel_by_user_[ssrc] = channel_id;
+    const uint32_t slot = acquire_slot(ssrc);
+    const uint32_t previous = channel_by_slot_[slot];
+    if (previous == channel_id) {
+        return;
+    }
+    if (previous == kNoChannel) {
+        clear_bit(unassigned_, slot);
+    } else {
+        clear_bit(channel_members(previous), slot);
+    }
+    set_bit(channel_members(channel_id), slot);
+    channel_by_slot_[slot] = channel_id;
 }
 
+// Only known users: a mute must never be what allocates a slot, or every
+// stray ssrc pair would cost a row that is never given back.
 void PermissionManager::mute(uint32_t listener, uint32_t target) {
-    muted_by_listener_[listener].insert(target);
+    const uint32_t listener_slot = slot_of(listener);
+    const uint32_t target_slot = slot_of(target);
+    if (listener_slot == kNoSlot || target_slot == kNoSlot) {
+        return;
+    }
+    Bitset& row = muted_by_[target_slot];
+    if (row.empty()) {
+        row.assign(words_, 0);
+    }
+    if (!test_bit(row, listener_slot)) {
+        set_bit(row, listener_slot);
+        muting_[listener_slot].push_back(target_slot);
+    }
 }
 
 void PermissionManager::unmute(uint32_t listener, uint32_t target) {
-    auto it = muted_by_listener_.find(listener);
-    if (it == muted_by_listener_.end()) {
+    const uint32_t listener_slot = slot_of(listener);
+    const uint32_t target_slot = slot_of(target);
+    if (listener_slot == kNoSlot || target_slot == kNoSlot) {
         return;
     }
-    it->second.erase(target);
-    if (it->second.empty()) {
-        muted_by_listener_.erase(it);
+    Bitset& row = muted_by_[target_slot];
+    if (!test_bit(row, listener_slot)) {
+        return;
     }
+    clear_bit(row, listener_slot);
+    auto& muted = muting_[listener_slot];
+    muted.erase(std::remove(muted.begin(), muted.end(), target_slot), muted.end());
 }
 
 bool PermissionManager::can_receive(uint32_t listener, uint32_t sender) const {
-    auto mute_it = muted_by_listener_.find(listener);
-    if (mute_it != muted_by_listener_.end()) {
-        if (mute_it->second.find(sender) != mute_it->second.end()) {
-            return false;
-        }
+    const uint32_t listener_slot = slot_of(listener);
+    const uint32_t sender_slot = slot_of(sender);
+    if (listener_slot == kNoSlot || sender_slot == kNoSlot) {
+        return true;
+    }
+    if (test_bit(muted_by_[sender_slot], listener_slot)) {
+        return false;
     }
 
-    auto sender_ch = channel_by_user_.find(sender);
-    auto listener_ch = channel_by_user_.find(listener);
-    if (sender_ch != channel_by_user_.end() && listener_ch != channel_by_user_.end()) {
-        return sender_ch->second == listener_ch->second;
+    const uint32_t sender_ch = channel_by_slot_[sender_slot];
+    const uint32_t listener_ch = channel_by_slot_[listener_slot];
+    if (sender_ch != kNoChannel && listener_ch != kNoChannel) {
+        return sender_ch == listener_ch;
     }
     return true;
 }
 
+void PermissionManager::eligible_listeners(uint32_t sender, Bitset& out) const {
+    out.resize(words_);
+    const uint32_t sender_slot = slot_of(sender);
+    if (sender_slot == kNoSlot) {
+        std::copy(live_.begin(), live_.end(), out.begin());
+        return;
+    }
+
+    const Bitset& muted = muted_by_[sender_slot];
+    const uint64_t* mask = muted.empty() ? nullptr : muted.data();
+    const uint32_t channel_id = channel_by_slot_[sender_slot];
+    if (channel_id == kNoChannel) {
+        // A sender without a channel reaches everyone.
+        if (mask) {
+            combine<false, true>(out.data(), live_.data(), nullptr, mask, words_);
+        } else {
+            combine<false, false>(out.data(), live_.data(), nullptr, nullptr, words_);
+        }
+    } else {
+        const uint64_t* members = members_by_channel_.at(channel_id).data();
+        if (mask) {
+            combine<true, true>(out.data(), members, unassigned_.data(), mask, words_);
+        } else {
+            combine<true, false>(out.data(), members, unassigned_.data(), nullptr, words_);
+        }
+    }
+    clear_bit(out, sender_slot);
+}
+
 void PermissionManager::remove_user(uint32_t ssrc) {
-    channel_by_user_.erase(ssrc);
-    muted_by_listener_.erase(ssrc);
-    for (auto& [listener, muted] : muted_by_listener_) {
-        muted.erase(ssrc);
+    const uint32_t slot = slot_of(ssrc);
+    if (slot == kNoSlot) {
+        return;
+    }
+
+    const uint32_t channel_id = channel_by_slot_[slot];
+    if (channel_id == kNoChannel) {
+        clear_bit(unassigned_, slot);
+    } else {
+        clear_bit(channel_members(channel_id), slot);
     }
+    clear_bit(live_, slot);
+
+    // Mutes this user set on others...
+    for (uint32_t target_slot : muting_[slot]) {
+        clear_bit(muted_by_[target_slot], slot);
+    }
+    muting_[slot].clear();
+    // ...and mutes others set on this user.
+    for_each_set_bit(muted_by_[slot], [&](uint32_t listener_slot) {
+        auto& muted = muting_[listener_slot];
+        muted.erase(std::remove(muted.begin(), muted.end(), slot), muted.end());
+    });
+    Bitset().swap(muted_by_[slot]);
+
+    channel_by_slot_[slot] = kNoChannel;
+    slot_by_ssrc_.erase(ssrc);
+    free_slots_.push_back(slot);
 }
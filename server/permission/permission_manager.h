@@ -1,18 +1,94 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Users are assigned dense slots; channel membership and mutes are bitsets
+// over those slots, so "who may hear sender S" is a few word-wide AND/ANDNOT
+// passes instead of one hash probe per listener.
 class PermissionManager {
 public:
+    static constexpr uint32_t kNoSlot = 0xFFFFFFFFu;
+    static constexpr uint32_t kNoChannel = 0xFFFFFFFFu;
+    using Bitset = std::vector<uint64_t>;
+
+    void add_user(uint32_t ssrc);
     void set_channel(uint32_t ssrc, uint32_t channel_id);
+    // Ignored unless both users are already known.
     void mute(uint32_t listener, uint32_t target);
     void unmute(uint32_t listener, uint32_t target);
     bool can_receive(uint32_t listener, uint32_t sender) const;
     void remove_user(uint32_t ssrc);
 
+    // Fills `out` with one bit per slot for every known user allowed to hear
+    // `sender`, excluding the sender itself. Map bits back with ssrc_at().
+    void eligible_listeners(uint32_t sender, Bitset& out) const;
+
+    uint32_t slot_of(uint32_t ssrc) const;
+    // kNoChannel for unknown users and users without a channel.
+    uint32_t channel_of(uint32_t ssrc) const;
+    uint32_t ssrc_at(uint32_t slot) const { return ssrc_by_slot_[slot]; }
+
+    // Visit every known user as fn(ssrc, channel_id), and every mute in
+    // effect as fn(listener, sender); enough to rebuild an equal instance.
+    template <typename Fn>
+    void for_each_user(Fn&& fn) const {
+        for (const auto& entry : slot_by_ssrc_) {
+            fn(entry.first, channel_by_slot_[entry.second]);
+        }
+    }
+    template <typename Fn>
+    void for_each_mute(Fn&& fn) const {
+        for (const auto& entry : slot_by_ssrc_) {
+            for (uint32_t sender_slot : muting_[entry.second]) {
+                fn(entry.first, ssrc_by_slot_[sender_slot]);
+            }
+        }
+    }
+
+    template <typename Fn>
+    static void for_each_set_bit(const Bitset& bits, Fn&& fn) {
+        for (size_t w = 0; w < bits.size(); ++w) {
+            uint64_t word = bits[w];
+            while (word != 0) {
+                fn(static_cast<uint32_t>(w * 64 + lowest_bit(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
 private:
-    std::unordered_map<uint32_t, uint32_t> channel_by_user_;
-    std::unordered_map<uint32_t, std::unordered_set<uint32_t>> muted_by_listener_;
+    static unsigned lowest_bit(uint64_t word) {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward64(&index, word);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctzll(word));
+#endif
+    }
+
+    uint32_t acquire_slot(uint32_t ssrc);
+    void grow_bitsets(size_t words);
+    Bitset& channel_members(uint32_t channel_id);
+
+    std::unordered_map<uint32_t, uint32_t> slot_by_ssrc_;
+    std::vector<uint32_t> ssrc_by_slot_;
+    std::vector<uint32_t> channel_by_slot_;
+    std::vector<uint32_t> free_slots_;
+    size_t words_ = 0;
+
+    Bitset live_;       // Every assigned slot
+    Bitset unassigned_; // Live slots without a channel; they hear every channel
+    std::unordered_map<uint32_t, Bitset> members_by_channel_;
+    // Indexed by sender slot: listeners that muted it. Empty until first mute.
+    std::vector<Bitset> muted_by_;
+    // Indexed by listener slot: sender slots it muted, to undo on removal.
+    std::vector<std::vector<uint32_t>> muting_;
 };
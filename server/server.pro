@@ -8,16 +8,36 @@ CONFIG += c++20
 
 INCLUDEPATH += \
     $$PWD/.. \
+    $$PWD \
+    $$PWD/../shared \
     $$PWD/../shared/protocol
 
 HEADERS += \
     $$PWD/../constants.h \
     $$PWD/permission/permission_manager.h \
-    $$PWD/../shared/protocol/control_protocol.h
+    $$PWD/sfu/sfu_socket.h \
+    $$PWD/sfu/batch_io.h \
+    $$PWD/sfu/reactor.h \
+    $$PWD/sfu/sharding.h \
+    $$PWD/sfu/spsc_ring.h \
+    $$PWD/sfu/peer_table.h \
+    $$PWD/sfu/uring_io.h \
+    $$PWD/sfu/metrics.h \
+    $$PWD/../shared/protocol/control_protocol.h \
+    $$PWD/../shared/utils/Logger.h \
+    $$PWD/../shared/utils/TimerWheel.h
 
 SOURCES += \
     $$PWD/sfu/sfu.cpp \
-    $$PWD/permission/permission_manager.cpp
+    $$PWD/sfu/batch_io.cpp \
+    $$PWD/sfu/reactor.cpp \
+    $$PWD/sfu/sharding.cpp \
+    $$PWD/sfu/peer_table.cpp \
+    $$PWD/sfu/uring_io.cpp \
+    $$PWD/sfu/metrics.cpp \
+    $$PWD/permission/permission_manager.cpp \
+    $$PWD/../shared/utils/Logger.cpp \
+    $$PWD/../shared/utils/TimerWheel.cpp
 
 DEFINES += SERVER_PORT=5004
 DEFINES += CONTROL_PORT=5005
@@ -0,0 +1,219 @@
+#include "sfu/batch_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef NOX_SFU_HAS_MMSG
+#include <netinet/udp.h>
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+#endif
+
+namespace {
+// A GRO super-datagram can carry up to 64 KiB of coalesced segments.
+constexpr size_t kGroSlotSize = 65535;
+
+#ifdef NOX_SFU_HAS_MMSG
+// Errors that describe the one datagram sendmmsg stopped at (its
+// destination or its size), not the socket, so the rest can still go.
+bool rejects_one_datagram(int err) {
+    switch (err) {
+    case EHOSTUNREACH:
+    case ENETUNREACH:
+    case EPERM:
+    case EACCES:
+    case EINVAL:
+    case EMSGSIZE:
+    case EDESTADDRREQ:
+        return true;
+    default:
+        return false;
+    }
+}
+#endif
+}
+
+BatchReceiver::BatchReceiver(size_t batch_size, size_t slot_size)
+    : batch_size_(std::max<size_t>(1, batch_size)),
+      slot_size_(slot_size),
+      storage_(batch_size_ * slot_size),
+      addrs_(batch_size_) {
+    views_.reserve(batch_size_);
+#ifdef NOX_SFU_HAS_MMSG
+    msgs_.resize(batch_size_);
+    iovs_.resize(batch_size_);
+#endif
+}
+
+bool BatchReceiver::enable_gro(SocketHandle socket) {
+#ifdef NOX_SFU_HAS_MMSG
+    int on = 1;
+    if (setsockopt(socket, SOL_UDP, UDP_GRO, &on, sizeof(on)) != 0) {
+        return false;
+    }
+    gro_ = true;
+    slot_size_ = kGroSlotSize;
+    storage_.assign(batch_size_ * slot_size_, 0);
+    control_.assign(batch_size_ * CMSG_SPACE(sizeof(int)), 0);
+    return true;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+int BatchReceiver::receive(SocketHandle socket) {
+    views_.clear();
+
+#ifdef NOX_SFU_HAS_MMSG
+    const size_t cmsg_len = gro_ ? CMSG_SPACE(sizeof(int)) : 0;
+    for (size_t i = 0; i < batch_size_; ++i) {
+        iovs_[i].iov_base = storage_.data() + i * slot_size_;
+        iovs_[i].iov_len = slot_size_;
+        std::memset(&msgs_[i], 0, sizeof(msgs_[i]));
+        msgs_[i].msg_hdr.msg_name = &addrs_[i];
+        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        if (gro_) {
+            msgs_[i].msg_hdr.msg_control = control_.data() + i * cmsg_len;
+            msgs_[i].msg_hdr.msg_controllen = cmsg_len;
+        }
+    }
+
+    const int n = recvmmsg(socket, msgs_.data(), static_cast<unsigned int>(batch_size_),
+                           MSG_DONTWAIT, nullptr);
+    if (n <= 0) {
+        return 0;
+    }
+    ++stats_.recv_calls;
+
+    for (int i = 0; i < n; ++i) {
+        const uint8_t* base = storage_.data() + static_cast<size_t>(i) * slot_size_;
+        const int total = static_cast<int>(msgs_[i].msg_len);
+
+        int segment = total;
+        if (gro_) {
+            for (cmsghdr* cm = CMSG_FIRSTHDR(&msgs_[i].msg_hdr); cm != nullptr;
+                 cm = CMSG_NXTHDR(&msgs_[i].msg_hdr, cm)) {
+                if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO) {
+                    int gso_size = 0;
+                    std::memcpy(&gso_size, CMSG_DATA(cm), sizeof(gso_size));
+                    if (gso_size > 0) {
+                        segment = gso_size;
+                    }
+                }
+            }
+        }
+
+        for (int offset = 0; offset < total; offset += segment) {
+            Datagram d;
+            d.data = base + offset;
+            d.len = std::min(segment, total - offset);
+            d.from = addrs_[static_cast<size_t>(i)];
+            views_.push_back(d);
+        }
+    }
+#else
+    for (size_t i = 0; i < batch_size_; ++i) {
+        uint8_t* slot = storage_.data() + i * slot_size_;
+        socklen_t from_len = sizeof(sockaddr_in);
+        const int len = recvfrom(socket, (char*)slot, (int)slot_size_, 0,
+                                 (sockaddr*)&addrs_[i], &from_len);
+        ++stats_.recv_calls;
+        if (len <= 0) {
+            break;
+        }
+        Datagram d;
+        d.data = slot;
+        d.len = len;
+        d.from = addrs_[i];
+        views_.push_back(d);
+    }
+#endif
+
+    stats_.recv_packets += views_.size();
+    return static_cast<int>(views_.size());
+}
+
+BatchSender::BatchSender(size_t capacity)
+    : capacity_(std::max<size_t>(1, capacity)),
+      entries_(capacity_) {
+#ifdef NOX_SFU_HAS_MMSG
+    msgs_.resize(capacity_);
+    iovs_.resize(capacity_);
+#endif
+}
+
+void BatchSender::queue(SocketHandle socket, const uint8_t* data, int len, const sockaddr_in& to) {
+    if (count_ == capacity_) {
+        flush(socket);
+    }
+    entries_[count_++] = Entry{data, len, to};
+}
+
+int BatchSender::flush(SocketHandle socket) {
+    if (count_ == 0) {
+        return 0;
+    }
+
+    int sent_total = 0;
+#ifdef NOX_SFU_HAS_MMSG
+    for (size_t i = 0; i < count_; ++i) {
+        iovs_[i].iov_base = const_cast<uint8_t*>(entries_[i].data);
+        iovs_[i].iov_len = static_cast<size_t>(entries_[i].len);
+        std::memset(&msgs_[i], 0, sizeof(msgs_[i]));
+        msgs_[i].msg_hdr.msg_name = &entries_[i].to;
+        msgs_[i].msg_hdr.msg_namelen = sizeof(sockaddr_in);
+        msgs_[i].msg_hdr.msg_iov = &iovs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    size_t offset = 0;
+    while (offset < count_) {
+        const int n = sendmmsg(socket, msgs_.data() + offset,
+                               static_cast<unsigned int>(count_ - offset), MSG_DONTWAIT);
+        ++stats_.send_calls;
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && rejects_one_datagram(errno)) {
+            // Only the datagram at `offset` was rejected; skip it so one bad
+            // destination or size cannot stall the rest of the batch.
+            ++stats_.send_errors;
+            ++offset;
+            continue;
+        }
+        if (n <= 0) {
+            // A full socket buffer (EAGAIN, ENOBUFS) or a broken socket
+            // fails every remaining copy the same way; retrying one at a
+            // time would only add a syscall per copy under overload.
+            stats_.send_errors += count_ - offset;
+            break;
+        }
+        sent_total += n;
+        offset += static_cast<size_t>(n);
+    }
+#else
+    for (size_t i = 0; i < count_; ++i) {
+        const Entry& e = entries_[i];
+        const int sent = sendto(socket, (const char*)e.data, e.len, 0,
+                                (const sockaddr*)&e.to, sizeof(e.to));
+        ++stats_.send_calls;
+        if (sent == SOCKET_ERROR) {
+            ++stats_.send_errors;
+        } else {
+            ++sent_total;
+        }
+    }
+#endif
+
+    stats_.send_packets += static_cast<uint64_t>(sent_total);
+    count_ = 0;
+    return sent_total;
+}
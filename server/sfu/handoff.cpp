@@ -0,0 +1,230 @@
+#include "sfu/handoff.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/un.h>
+#endif
+
+namespace sfuhandoff {
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr char kRequest = 'T';
+constexpr char kAck = 'A';
+constexpr size_t kMaxSockets = 80;
+
+struct Preamble {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t state_len;
+};
+
+bool wait_readable(SocketHandle socket, int timeout_ms) {
+    pollfd pfd{};
+    pfd.fd = socket;
+    pfd.events = POLLIN;
+    return poll(&pfd, 1, timeout_ms) > 0;
+}
+
+bool fill_address(const std::string& path, sockaddr_un& addr, std::string& error) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        error = "handoff socket path is empty or too long";
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+bool send_all(SocketHandle conn, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t n = send(conn, data, len, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool recv_all(SocketHandle conn, char* data, size_t len, int timeout_ms) {
+    while (len > 0) {
+        if (!wait_readable(conn, timeout_ms)) {
+            return false;
+        }
+        const ssize_t n = recv(conn, data, len, 0);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+bool supported() { return true; }
+
+SocketHandle listen_at(const std::string& path, std::string& error) {
+    sockaddr_un addr{};
+    if (!fill_address(path, addr, error)) {
+        return INVALID_SOCKET;
+    }
+    SocketHandle listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) {
+        error = std::strerror(errno);
+        return INVALID_SOCKET;
+    }
+    unlink(path.c_str());
+    if (bind(listener, (const sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 1) != 0) {
+        error = std::strerror(errno);
+        closesocket(listener);
+        return INVALID_SOCKET;
+    }
+    fcntl(listener, F_SETFL, fcntl(listener, F_GETFL, 0) | O_NONBLOCK);
+    return listener;
+}
+
+SocketHandle connect_to(const std::string& path, std::string& error) {
+    sockaddr_un addr{};
+    if (!fill_address(path, addr, error)) {
+        return INVALID_SOCKET;
+    }
+    SocketHandle conn = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (conn == INVALID_SOCKET) {
+        error = std::strerror(errno);
+        return INVALID_SOCKET;
+    }
+    if (connect(conn, (const sockaddr*)&addr, sizeof(addr)) != 0) {
+        error = std::strerror(errno);
+        closesocket(conn);
+        return INVALID_SOCKET;
+    }
+    return conn;
+}
+
+SocketHandle accept_from(SocketHandle listener) {
+    SocketHandle conn = accept(listener, nullptr, nullptr);
+    if (conn != INVALID_SOCKET) {
+        // Accepted sockets do not inherit O_NONBLOCK on Linux, but may elsewhere.
+        fcntl(conn, F_SETFL, fcntl(conn, F_GETFL, 0) & ~O_NONBLOCK);
+    }
+    return conn;
+}
+
+bool send_state(SocketHandle conn, const std::vector<SocketHandle>& sockets, const std::string& state,
+                int timeout_ms) {
+    char request = 0;
+    if (sockets.empty() || sockets.size() > kMaxSockets ||
+        !recv_all(conn, &request, 1, timeout_ms) || request != kRequest) {
+        return false;
+    }
+
+    // The descriptors ride on the preamble; the state follows as plain
+    // stream data.
+    Preamble preamble{kMagic, kVersion, static_cast<uint32_t>(state.size())};
+    iovec iov{};
+    iov.iov_base = &preamble;
+    iov.iov_len = sizeof(preamble);
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * sockets.size()), 0);
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * sockets.size());
+    std::memcpy(CMSG_DATA(cmsg), sockets.data(), sizeof(int) * sockets.size());
+
+    if (sendmsg(conn, &msg, MSG_NOSIGNAL) != static_cast<ssize_t>(sizeof(preamble))) {
+        return false;
+    }
+    return send_all(conn, state.data(), state.size());
+}
+
+bool receive_state(SocketHandle conn, std::vector<SocketHandle>& sockets, std::string& state,
+                   int timeout_ms) {
+    if (!send_all(conn, &kRequest, 1) || !wait_readable(conn, timeout_ms)) {
+        return false;
+    }
+
+    Preamble preamble{};
+    iovec iov{};
+    iov.iov_base = &preamble;
+    iov.iov_len = sizeof(preamble);
+    std::vector<char> control(CMSG_SPACE(sizeof(int) * kMaxSockets), 0);
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.data();
+    msg.msg_controllen = control.size();
+    if (recvmsg(conn, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL) != static_cast<ssize_t>(sizeof(preamble))) {
+        return false;
+    }
+
+    sockets.clear();
+    for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            sockets.resize(count);
+            std::memcpy(sockets.data(), CMSG_DATA(cmsg), sizeof(int) * count);
+        }
+    }
+    if (preamble.magic != kMagic || preamble.version != kVersion || (msg.msg_flags & MSG_CTRUNC)) {
+        for (SocketHandle socket : sockets) {
+            closesocket(socket);
+        }
+        sockets.clear();
+        return false;
+    }
+
+    state.resize(preamble.state_len);
+    return recv_all(conn, &state[0], state.size(), timeout_ms);
+}
+
+bool send_ack(SocketHandle conn) {
+    return send_all(conn, &kAck, 1);
+}
+
+bool wait_ack(SocketHandle conn, int timeout_ms) {
+    char ack = 0;
+    return recv_all(conn, &ack, 1, timeout_ms) && ack == kAck;
+}
+
+#else // _WIN32
+
+bool supported() { return false; }
+
+SocketHandle listen_at(const std::string&, std::string& error) {
+    error = "not supported on this platform";
+    return INVALID_SOCKET;
+}
+
+SocketHandle connect_to(const std::string&, std::string& error) {
+    error = "not supported on this platform";
+    return INVALID_SOCKET;
+}
+
+SocketHandle accept_from(SocketHandle) { return INVALID_SOCKET; }
+
+bool send_state(SocketHandle, const std::vector<SocketHandle>&, const std::string&, int) { return false; }
+
+bool receive_state(SocketHandle, std::vector<SocketHandle>&, std::string&, int) { return false; }
+
+bool send_ack(SocketHandle) { return false; }
+
+bool wait_ack(SocketHandle, int) { return false; }
+
+#endif
+
+} // namespace sfuhandoff
@@ -0,0 +1,94 @@
+// 📁 server/sfu/handoff.h
+// HOT-UPGRADE HANDOFF between two voip_sfu processes
+// The running process listens on a Unix socket. A new binary started with
+// --takeover connects, receives the live UDP sockets (SCM_RIGHTS) together
+// with a snapshot of the control-plane state, starts forwarding and acks;
+// only then does the old process stop. Both read the shared sockets for the
+// moment in between, so nothing queued in them is lost. POSIX only.
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "sfu/sfu_socket.h"
+
+namespace sfuhandoff {
+
+constexpr uint32_t kMagic = 0x4E584846; // "FHXN"
+constexpr uint32_t kVersion = 1;
+
+bool supported();
+
+// Binds a listening Unix socket at `path`, replacing a stale socket file.
+// Non-blocking, so it can sit in a Reactor.
+SocketHandle listen_at(const std::string& path, std::string& error);
+SocketHandle connect_to(const std::string& path, std::string& error);
+// Returns INVALID_SOCKET when no connection is pending.
+SocketHandle accept_from(SocketHandle listener);
+
+// Old process: answers one takeover request with `sockets` and `state`.
+bool send_state(SocketHandle conn, const std::vector<SocketHandle>& sockets, const std::string& state,
+                int timeout_ms);
+// New process: asks for and receives them.
+bool receive_state(SocketHandle conn, std::vector<SocketHandle>& sockets, std::string& state,
+                   int timeout_ms);
+
+bool send_ack(SocketHandle conn);
+bool wait_ack(SocketHandle conn, int timeout_ms);
+
+// Flat encoding of the state snapshot, in host byte order: both ends run on
+// the same machine.
+class StateWriter {
+public:
+    template <typename T>
+    void put(const T& value) {
+        out_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void put_string(const std::string& value) {
+        put(static_cast<uint32_t>(value.size()));
+        out_ += value;
+    }
+    const std::string& data() const { return out_; }
+
+private:
+    std::string out_;
+};
+
+// Reads past the end yield zeroes and make ok() false, so a truncated
+// snapshot is caught once at the end instead of after every field.
+class StateReader {
+public:
+    explicit StateReader(const std::string& in) : in_(in) {}
+
+    template <typename T>
+    T get() {
+        T value{};
+        if (pos_ + sizeof(T) > in_.size()) {
+            failed_ = true;
+            return value;
+        }
+        std::memcpy(&value, in_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return value;
+    }
+    std::string get_string() {
+        const uint32_t len = get<uint32_t>();
+        if (failed_ || pos_ + len > in_.size()) {
+            failed_ = true;
+            return std::string();
+        }
+        std::string value = in_.substr(pos_, len);
+        pos_ += len;
+        return value;
+    }
+    bool ok() const { return !failed_; }
+
+private:
+    const std::string& in_;
+    size_t pos_ = 0;
+    bool failed_ = false;
+};
+
+} // namespace sfuhandoff
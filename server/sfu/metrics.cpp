@@ -0,0 +1,326 @@
+#include "sfu/metrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+namespace sfumetrics {
+
+namespace {
+
+constexpr int kRequestTimeoutMs = 200; // Silent connections are closed after this
+constexpr size_t kMaxRequestBytes = 4096;
+constexpr int kMaxPendingScrapes = 8;
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL; // A scraper hanging up must not raise SIGPIPE
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+struct CounterInfo {
+    const char* name;
+    const char* labels; // Empty, or the label set for this series
+    const char* help;
+};
+
+// Indexed by Counter. Series sharing a name must be adjacent.
+constexpr CounterInfo kCounterInfo[kCounterCount] = {
+    {"sfu_rx_packets_total", "", "Audio datagrams received"},
+    {"sfu_rx_bytes_total", "", "Audio bytes received"},
+    {"sfu_tx_packets_total", "", "Audio copies queued for sending"},
+    {"sfu_tx_bytes_total", "", "Audio bytes queued for sending"},
+    {"sfu_tx_errors_total", "", "Audio copies the kernel refused"},
+    {"sfu_tx_delayed_total", "", "Audio copies held back by egress pacing"},
+    {"sfu_dropped_packets_total", "reason=\"malformed\"", "Audio datagrams not forwarded, by reason"},
+    {"sfu_dropped_packets_total", "reason=\"not_joined\"", nullptr},
+    {"sfu_dropped_packets_total", "reason=\"keepalive\"", nullptr},
+    {"sfu_dropped_packets_total", "reason=\"no_target\"", nullptr},
+    {"sfu_dropped_packets_total", "reason=\"not_selected\"", nullptr},
+    {"sfu_dropped_packets_total", "reason=\"paced\"", nullptr},
+};
+
+struct HistogramInfo {
+    const char* name;
+    const char* help;
+    double scale; // Recorded unit -> exported unit
+};
+
+// Indexed by Histogram.
+constexpr HistogramInfo kHistogramInfo[kHistogramCount] = {
+    {"sfu_fanout_copies", "Copies sent per forwarded audio packet", 1.0},
+    {"sfu_batch_duration_seconds", "Time from receiving an I/O batch to flushing its copies", 1e-6},
+};
+
+void append(std::string& out, const char* format, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, format);
+    const int n = std::vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (n > 0) {
+        out.append(line, std::min<size_t>(static_cast<size_t>(n), sizeof(line) - 1));
+    }
+}
+
+void append_header(std::string& out, const char* name, const char* help, const char* type) {
+    append(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+uint64_t steady_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool would_block() {
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+void set_non_blocking(SocketHandle socket) {
+#ifdef _WIN32
+    u_long non_blocking = 1;
+    ioctlsocket(socket, FIONBIO, &non_blocking);
+#else
+    int flags = fcntl(socket, F_GETFL, 0);
+    fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+#endif
+}
+
+} // namespace
+
+MetricsShard& MetricsRegistry::add_shard() {
+    shards_.push_back(std::make_unique<MetricsShard>());
+    return *shards_.back();
+}
+
+void MetricsRegistry::add_gauge(std::string name, std::string help, std::function<double()> read) {
+    gauges_.push_back(Gauge{std::move(name), std::move(help), std::move(read)});
+}
+
+std::string MetricsRegistry::render() const {
+    std::string out;
+    out.reserve(4096);
+
+    for (size_t c = 0; c < kCounterCount; ++c) {
+        const CounterInfo& info = kCounterInfo[c];
+        if (info.help) {
+            append_header(out, info.name, info.help, "counter");
+        }
+        uint64_t total = 0;
+        for (const auto& shard : shards_) {
+            total += shard->counter(static_cast<Counter>(c));
+        }
+        if (info.labels[0] != '\0') {
+            append(out, "%s{%s} %llu\n", info.name, info.labels, static_cast<unsigned long long>(total));
+        } else {
+            append(out, "%s %llu\n", info.name, static_cast<unsigned long long>(total));
+        }
+    }
+
+    for (size_t h = 0; h < kHistogramCount; ++h) {
+        const HistogramInfo& info = kHistogramInfo[h];
+        const HistogramBounds& bounds = kHistogramBounds[h];
+        const Histogram histogram = static_cast<Histogram>(h);
+        append_header(out, info.name, info.help, "histogram");
+
+        // Buckets are read before the sum, so a concurrent observe() can
+        // only make the sum run slightly ahead of the counts.
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= bounds.count; ++b) {
+            for (const auto& shard : shards_) {
+                cumulative += shard->bucket(histogram, b);
+            }
+            if (b < bounds.count) {
+                append(out, "%s_bucket{le=\"%g\"} %llu\n", info.name,
+                       static_cast<double>(bounds.values[b]) * info.scale,
+                       static_cast<unsigned long long>(cumulative));
+            } else {
+                append(out, "%s_bucket{le=\"+Inf\"} %llu\n", info.name,
+                       static_cast<unsigned long long>(cumulative));
+            }
+        }
+        uint64_t sum = 0;
+        for (const auto& shard : shards_) {
+            sum += shard->sum(histogram);
+        }
+        append(out, "%s_sum %g\n", info.name, static_cast<double>(sum) * info.scale);
+        append(out, "%s_count %llu\n", info.name, static_cast<unsigned long long>(cumulative));
+    }
+
+    // Steering keeps each sender on one worker, but flow hashing or a
+    // restart can split it; merge by SSRC either way.
+    std::map<uint32_t, SsrcTotals> by_ssrc;
+    for (const auto& shard : shards_) {
+        const std::shared_ptr<const SsrcSnapshot> snapshot = shard->ssrc();
+        if (!snapshot) {
+            continue;
+        }
+        for (const SsrcTotals& totals : *snapshot) {
+            SsrcTotals& merged = by_ssrc[totals.ssrc];
+            merged.ssrc = totals.ssrc;
+            merged.packets += totals.packets;
+            merged.bytes += totals.bytes;
+        }
+    }
+    append_header(out, "sfu_ssrc_rx_packets_total", "Audio datagrams received per sender (updated every second)", "counter");
+    for (const auto& entry : by_ssrc) {
+        append(out, "sfu_ssrc_rx_packets_total{ssrc=\"%u\"} %llu\n", entry.first,
+               static_cast<unsigned long long>(entry.second.packets));
+    }
+    append_header(out, "sfu_ssrc_rx_bytes_total", "Audio bytes received per sender (updated every second)", "counter");
+    for (const auto& entry : by_ssrc) {
+        append(out, "sfu_ssrc_rx_bytes_total{ssrc=\"%u\"} %llu\n", entry.first,
+               static_cast<unsigned long long>(entry.second.bytes));
+    }
+
+    for (const Gauge& gauge : gauges_) {
+        append_header(out, gauge.name.c_str(), gauge.help.c_str(), "gauge");
+        append(out, "%s %g\n", gauge.name.c_str(), gauge.read());
+    }
+    return out;
+}
+
+MetricsEndpoint::~MetricsEndpoint() {
+    for (const PendingScrape& pending : pending_) {
+        closesocket(pending.socket);
+    }
+    if (listen_socket_ != INVALID_SOCKET) {
+        closesocket(listen_socket_);
+    }
+}
+
+bool MetricsEndpoint::open(uint16_t port) {
+    listen_socket_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listen_socket_ == INVALID_SOCKET) {
+        return false;
+    }
+    int reuse = 1;
+    setsockopt(listen_socket_, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(listen_socket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+        listen(listen_socket_, kMaxPendingScrapes) == SOCKET_ERROR) {
+        closesocket(listen_socket_);
+        listen_socket_ = INVALID_SOCKET;
+        return false;
+    }
+    set_non_blocking(listen_socket_);
+    return true;
+}
+
+bool MetricsEndpoint::attach(Reactor& reactor, std::function<std::string()> render) {
+    reactor_ = &reactor;
+    render_ = std::move(render);
+    timeout_timer_ = reactor.add_oneshot_timer([this]() { expire_pending(); });
+    return reactor.add_socket(listen_socket_, [this]() { accept_pending(); });
+}
+
+void MetricsEndpoint::accept_pending() {
+    for (int i = 0; i < kMaxPendingScrapes; ++i) {
+        SocketHandle client = accept(listen_socket_, nullptr, nullptr);
+        if (client == INVALID_SOCKET) {
+            return;
+        }
+        if (pending_.size() >= static_cast<size_t>(kMaxPendingScrapes)) {
+            closesocket(client);
+            continue;
+        }
+        set_non_blocking(client);
+        if (!reactor_->add_socket(client, [this, client]() { read_request(client); })) {
+            closesocket(client);
+            continue;
+        }
+        pending_.push_back(PendingScrape{client, std::string{}, steady_ms() + kRequestTimeoutMs});
+        reactor_->arm_timer(timeout_timer_, kRequestTimeoutMs);
+    }
+}
+
+// Takes only what is already buffered; the reactor calls back when more
+// arrives.
+void MetricsEndpoint::read_request(SocketHandle client) {
+    const auto it = std::find_if(pending_.begin(), pending_.end(),
+                                 [client](const PendingScrape& p) { return p.socket == client; });
+    if (it == pending_.end()) {
+        return;
+    }
+    const size_t index = static_cast<size_t>(it - pending_.begin());
+    std::string& request = it->request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < kMaxRequestBytes) {
+        const int n = recv(client, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            request.append(buffer, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && would_block()) {
+            return;
+        }
+        close_pending(index);
+        return;
+    }
+    respond(client, request);
+    close_pending(index);
+}
+
+void MetricsEndpoint::expire_pending() {
+    const uint64_t now = steady_ms();
+    uint64_t next_deadline = 0;
+    for (size_t i = pending_.size(); i-- > 0;) {
+        if (pending_[i].deadline_ms <= now) {
+            close_pending(i);
+        } else if (next_deadline == 0 || pending_[i].deadline_ms < next_deadline) {
+            next_deadline = pending_[i].deadline_ms;
+        }
+    }
+    if (next_deadline != 0) {
+        reactor_->arm_timer(timeout_timer_, static_cast<uint32_t>(next_deadline - now));
+    }
+}
+
+void MetricsEndpoint::close_pending(size_t index) {
+    const SocketHandle client = pending_[index].socket;
+    reactor_->remove_socket(client);
+    closesocket(client);
+    pending_.erase(pending_.begin() + static_cast<std::ptrdiff_t>(index));
+}
+
+// The response is written without waiting: the send buffer is sized to hold
+// it, and a scraper that does not drain a loopback socket gets a short read.
+void MetricsEndpoint::respond(SocketHandle client, const std::string& request) {
+    std::string body;
+    const char* status = "200 OK";
+    if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+        body = render_();
+    } else {
+        status = "404 Not Found";
+        body = "try /metrics\n";
+    }
+
+    std::string response;
+    append(response, "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, body.size());
+    response += body;
+
+    const int buffer_size = static_cast<int>(response.size());
+    setsockopt(client, SOL_SOCKET, SO_SNDBUF, (const char*)&buffer_size, sizeof(buffer_size));
+    size_t sent = 0;
+    while (sent < response.size()) {
+        const int n = send(client, response.data() + sent, static_cast<int>(response.size() - sent), kSendFlags);
+        if (n <= 0) {
+            return;
+        }
+        sent += static_cast<size_t>(n);
+    }
+}
+
+} // namespace sfumetrics
@@ -0,0 +1,195 @@
+// 📁 server/sfu/metrics.h
+// MEDIA METRICS for the SFU
+// Every media worker owns one cache-line aligned shard of counters and
+// histograms and is its only writer, so the hot path does plain relaxed
+// stores: no locked instructions and no cache line shared between cores.
+// Nothing is summed until a scrape asks for it; the control thread then reads
+// the shards with relaxed loads and renders Prometheus text, served over a
+// loopback HTTP endpoint.
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sfu/reactor.h"
+#include "sfu/sfu_socket.h"
+
+namespace sfumetrics {
+
+enum class Counter : uint32_t {
+    RxPackets,
+    RxBytes,
+    TxPackets,     // Fan-out copies queued
+    TxBytes,
+    TxErrors,      // Mirrors the I/O back end's running total
+    TxDelayed,     // Copies held back by egress pacing (mirrored)
+    DropMalformed,
+    DropNotJoined, // Sender has no JOIN+PING yet
+    DropKeepalive, // Zero-length endpoint probes
+    DropNoTarget,
+    DropNotSelected, // Outside its channel's loudest --max-speakers
+    DropPaced,       // Receiver over its egress budget (mirrored)
+    Count
+};
+
+enum class Histogram : uint32_t {
+    FanOut,         // Copies per media packet
+    BatchLatencyUs, // Receive-to-flush time of one I/O batch
+    Count
+};
+
+constexpr size_t kCounterCount = static_cast<size_t>(Counter::Count);
+constexpr size_t kHistogramCount = static_cast<size_t>(Histogram::Count);
+constexpr size_t kMaxBuckets = 12; // Finite bounds per histogram; +Inf is extra
+
+// Upper bounds ("le") of each histogram's buckets, in recorded units.
+struct HistogramBounds {
+    uint64_t values[kMaxBuckets];
+    size_t count;
+};
+
+inline constexpr HistogramBounds kHistogramBounds[kHistogramCount] = {
+    {{0, 1, 2, 4, 8, 16, 32, 64, 128}, 9},
+    {{5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000}, 11},
+};
+
+// Running totals for one sender, published by the worker that owns it.
+struct SsrcTotals {
+    uint32_t ssrc = 0;
+    uint64_t packets = 0;
+    uint64_t bytes = 0;
+};
+using SsrcSnapshot = std::vector<SsrcTotals>;
+
+class alignas(64) MetricsShard {
+public:
+    MetricsShard() = default;
+    MetricsShard(const MetricsShard&) = delete;
+    MetricsShard& operator=(const MetricsShard&) = delete;
+
+    // Writer side: only the owning thread may call these. A single writer
+    // needs no read-modify-write, just a store other threads can read whole.
+    uint64_t add(Counter counter, uint64_t n = 1) {
+        return bump(counters_[static_cast<size_t>(counter)], n);
+    }
+
+    void set(Counter counter, uint64_t value) {
+        counters_[static_cast<size_t>(counter)].store(value, std::memory_order_relaxed);
+    }
+
+    void observe(Histogram histogram, uint64_t value) {
+        const size_t h = static_cast<size_t>(histogram);
+        const HistogramBounds& bounds = kHistogramBounds[h];
+        size_t bucket = 0;
+        while (bucket < bounds.count && value > bounds.values[bucket]) {
+            ++bucket;
+        }
+        bump(histograms_[h].buckets[bucket], 1);
+        bump(histograms_[h].sum, value);
+    }
+
+    // Replaces the per-SSRC totals seen by scrapes. Off the hot path: the
+    // worker calls it from its periodic timer.
+    void publish_ssrc(std::shared_ptr<const SsrcSnapshot> snapshot) {
+        std::atomic_store(&ssrc_, std::move(snapshot));
+    }
+
+    // Reader side, safe from any thread.
+    uint64_t counter(Counter counter) const {
+        return counters_[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+    uint64_t bucket(Histogram histogram, size_t index) const {
+        return histograms_[static_cast<size_t>(histogram)].buckets[index].load(std::memory_order_relaxed);
+    }
+    uint64_t sum(Histogram histogram) const {
+        return histograms_[static_cast<size_t>(histogram)].sum.load(std::memory_order_relaxed);
+    }
+    std::shared_ptr<const SsrcSnapshot> ssrc() const { return std::atomic_load(&ssrc_); }
+
+private:
+    static uint64_t bump(std::atomic<uint64_t>& cell, uint64_t n) {
+        const uint64_t value = cell.load(std::memory_order_relaxed) + n;
+        cell.store(value, std::memory_order_relaxed);
+        return value;
+    }
+
+    struct HistogramCells {
+        std::atomic<uint64_t> buckets[kMaxBuckets + 1] = {};
+        std::atomic<uint64_t> sum{0};
+    };
+
+    std::atomic<uint64_t> counters_[kCounterCount] = {};
+    HistogramCells histograms_[kHistogramCount];
+    std::shared_ptr<const SsrcSnapshot> ssrc_; // Accessed via std::atomic_load/store
+};
+
+class MetricsRegistry {
+public:
+    // Shards must all be added before any worker starts writing.
+    MetricsShard& add_shard();
+
+    // Gauges are sampled during render(), on the thread that calls it.
+    void add_gauge(std::string name, std::string help, std::function<double()> read);
+
+    // Sums every shard and returns the Prometheus text exposition.
+    std::string render() const;
+
+private:
+    struct Gauge {
+        std::string name;
+        std::string help;
+        std::function<double()> read;
+    };
+
+    std::vector<std::unique_ptr<MetricsShard>> shards_;
+    std::vector<Gauge> gauges_;
+};
+
+// Minimal HTTP/1.0 responder for scrapes. Listens on loopback only and is
+// driven by the caller's reactor; each accepted connection gets one response
+// and is closed.
+class MetricsEndpoint {
+public:
+    MetricsEndpoint() = default;
+    ~MetricsEndpoint();
+
+    MetricsEndpoint(const MetricsEndpoint&) = delete;
+    MetricsEndpoint& operator=(const MetricsEndpoint&) = delete;
+
+    bool open(uint16_t port);
+    // Serves on a socket that is already listening (handed over by a
+    // process being replaced).
+    void adopt(SocketHandle listen_socket) { listen_socket_ = listen_socket; }
+    SocketHandle socket() const { return listen_socket_; }
+
+    // Serves scrapes on `reactor`'s thread. Each connection is read as its
+    // request arrives and answered once it is complete, so a silent client
+    // never holds the thread up; `render` runs once per request.
+    bool attach(Reactor& reactor, std::function<std::string()> render);
+
+private:
+    struct PendingScrape {
+        SocketHandle socket = INVALID_SOCKET;
+        std::string request;
+        uint64_t deadline_ms = 0;
+    };
+
+    void accept_pending();
+    void read_request(SocketHandle client);
+    void expire_pending();
+    void close_pending(size_t index);
+    void respond(SocketHandle client, const std::string& request);
+
+    SocketHandle listen_socket_ = INVALID_SOCKET;
+    Reactor* reactor_ = nullptr;
+    std::function<std::string()> render_;
+    std::vector<PendingScrape> pending_;
+    int timeout_timer_ = -1;
+};
+
+} // namespace sfumetrics
@@ -0,0 +1,91 @@
+#include "sfu/pacing.h"
+
+#include <algorithm>
+
+namespace {
+uint64_t receiver_key(const sockaddr_in& addr) {
+    return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
+}
+
+void EgressPacer::refill(Receiver& receiver, uint64_t now_us) const {
+    if (now_us <= receiver.refill_us) {
+        return;
+    }
+    const double earned = static_cast<double>(now_us - receiver.refill_us) *
+                          static_cast<double>(options_.rate_bytes_per_s) / 1e6;
+    receiver.tokens = std::min(static_cast<double>(options_.burst_bytes), receiver.tokens + earned);
+    receiver.refill_us = now_us;
+}
+
+void EgressPacer::drop_front(Receiver& receiver, size_t cls) {
+    spare_.push_back(std::move(receiver.queues[cls].front().bytes));
+    receiver.queues[cls].pop_front();
+    --receiver.depth;
+    --depth_;
+    ++dropped_;
+}
+
+void EgressPacer::recycle_released() {
+    for (auto& bytes : released_) {
+        spare_.push_back(std::move(bytes));
+    }
+    released_.clear();
+}
+
+std::vector<uint8_t> EgressPacer::take_buffer() {
+    if (spare_.empty()) {
+        return std::vector<uint8_t>();
+    }
+    std::vector<uint8_t> bytes = std::move(spare_.back());
+    spare_.pop_back();
+    return bytes;
+}
+
+EgressPacer::Verdict EgressPacer::admit(const sockaddr_in& to, EgressClass cls, const uint8_t* data, size_t len,
+                                        uint64_t now_us) {
+    auto inserted = receivers_.try_emplace(receiver_key(to));
+    Receiver& receiver = inserted.first->second;
+    if (inserted.second) {
+        receiver.to = to;
+        receiver.tokens = options_.burst_bytes;
+        receiver.refill_us = now_us;
+    }
+    receiver.last_active_us = now_us;
+    refill(receiver, now_us);
+
+    // Nothing may overtake copies already waiting for this receiver.
+    if (receiver.depth == 0 && receiver.tokens >= static_cast<double>(len)) {
+        receiver.tokens -= static_cast<double>(len);
+        return Verdict::Send;
+    }
+    const size_t incoming = static_cast<size_t>(cls);
+    if (cls == EgressClass::Background) {
+        ++dropped_;
+        return Verdict::Dropped;
+    }
+    if (receiver.depth >= options_.queue_limit) {
+        size_t victim = kEgressClassCount;
+        for (size_t c = kEgressClassCount; c-- > incoming + 1;) {
+            if (!receiver.queues[c].empty()) {
+                victim = c;
+                break;
+            }
+        }
+        if (victim == kEgressClassCount) {
+            ++dropped_;
+            return Verdict::Dropped;
+        }
+        drop_front(receiver, victim);
+    }
+
+    Queued queued;
+    queued.bytes = take_buffer();
+    queued.bytes.assign(data, data + len);
+    queued.enqueued_us = now_us;
+    receiver.queues[incoming].push_back(std::move(queued));
+    ++receiver.depth;
+    ++depth_;
+    ++delayed_;
+    return Verdict::Queued;
+}
@@ -0,0 +1,115 @@
+// 📁 server/sfu/pacing.h
+// PER-RECEIVER EGRESS PACING for one media worker
+// Each receiver endpoint gets a token bucket. A copy that fits the bucket
+// goes out at once; otherwise it waits in that receiver's queue for its
+// class, and release() lets queued copies out as tokens accrue, highest
+// class first. Background copies are never queued: with the bucket empty
+// they are dropped, so they are what gives way first. A full queue evicts
+// its lowest-class copy to admit a higher one. Worker-local, so unlocked.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "sfu/sfu_socket.h"
+
+enum class EgressClass : uint8_t {
+    Talk,       // Targeted TALK routes
+    Voice,      // Broadcast audio marked voiced, or carrying no level
+    Background, // Broadcast audio marked unvoiced
+    Count
+};
+
+constexpr size_t kEgressClassCount = static_cast<size_t>(EgressClass::Count);
+
+struct PacerOptions {
+    uint64_t rate_bytes_per_s = 0; // Per receiver; 0 = pacing off
+    uint32_t burst_bytes = 0;      // Bucket depth
+    size_t queue_limit = 32;       // Copies waiting per receiver, all classes
+    uint32_t max_delay_ms = 100;   // Queued longer than this: too late to play
+};
+
+class EgressPacer {
+public:
+    enum class Verdict { Send, Queued, Dropped };
+
+    explicit EgressPacer(const PacerOptions& options) : options_(options) {}
+
+    bool enabled() const { return options_.rate_bytes_per_s > 0; }
+
+    // Send: the caller sends `data` now. Queued: the pacer copied it and
+    // will hand it to a later release(). Dropped: counted in dropped().
+    Verdict admit(const sockaddr_in& to, EgressClass cls, const uint8_t* data, size_t len, uint64_t now_us);
+
+    // Passes every copy whose tokens have accrued to send(to, data, len).
+    // `data` stays valid until the next release().
+    template <typename Send>
+    void release(uint64_t now_us, Send&& send) {
+        recycle_released();
+        for (auto it = receivers_.begin(); it != receivers_.end();) {
+            Receiver& receiver = it->second;
+            refill(receiver, now_us);
+            for (size_t c = 0; c < kEgressClassCount; ++c) {
+                std::deque<Queued>& queue = receiver.queues[c];
+                while (!queue.empty()) {
+                    Queued& head = queue.front();
+                    if (now_us - head.enqueued_us > options_.max_delay_ms * 1000ull) {
+                        drop_front(receiver, c);
+                        continue;
+                    }
+                    if (receiver.tokens < static_cast<double>(head.bytes.size())) {
+                        break;
+                    }
+                    receiver.tokens -= static_cast<double>(head.bytes.size());
+                    released_.push_back(std::move(head.bytes));
+                    queue.pop_front();
+                    --receiver.depth;
+                    --depth_;
+                    send(receiver.to, released_.back().data(), released_.back().size());
+                }
+            }
+            if (receiver.depth == 0 && now_us - receiver.last_active_us > kIdleUs) {
+                it = receivers_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    size_t depth() const { return depth_; }          // Copies waiting, all receivers
+    uint64_t delayed() const { return delayed_; }    // Copies that had to wait
+    uint64_t dropped() const { return dropped_; }    // Copies never sent
+
+private:
+    static constexpr uint64_t kIdleUs = 10000000; // Forget receivers idle this long
+
+    struct Queued {
+        std::vector<uint8_t> bytes;
+        uint64_t enqueued_us = 0;
+    };
+
+    struct Receiver {
+        sockaddr_in to{};
+        double tokens = 0;
+        uint64_t refill_us = 0;
+        uint64_t last_active_us = 0;
+        size_t depth = 0;
+        std::deque<Queued> queues[kEgressClassCount];
+    };
+
+    void refill(Receiver& receiver, uint64_t now_us) const;
+    void drop_front(Receiver& receiver, size_t cls);
+    void recycle_released();
+    std::vector<uint8_t> take_buffer();
+
+    PacerOptions options_;
+    std::unordered_map<uint64_t, Receiver> receivers_;
+    std::vector<std::vector<uint8_t>> released_; // Handed out by the last release()
+    std::vector<std::vector<uint8_t>> spare_;    // Reused copy buffers
+    size_t depth_ = 0;
+    uint64_t delayed_ = 0;
+    uint64_t dropped_ = 0;
+};
@@ -0,0 +1,122 @@
+#include "sfu/peer_table.h"
+
+#include <utility>
+
+SsrcIndex::SsrcIndex(size_t expected) {
+    size_t buckets = 8;
+    while (buckets < expected * 2) {
+        buckets <<= 1;
+    }
+    rehash(buckets);
+}
+
+void SsrcIndex::rehash(size_t bucket_count) {
+    std::vector<Bucket> old = std::move(buckets_);
+    buckets_.assign(bucket_count, Bucket{});
+    mask_ = bucket_count - 1;
+    shift_ = 32;
+    for (size_t n = bucket_count; n > 1; n >>= 1) {
+        --shift_;
+    }
+    size_ = 0;
+    for (const Bucket& b : old) {
+        if (b.slot != kNoSlot) {
+            set(b.ssrc, b.slot);
+        }
+    }
+}
+
+void SsrcIndex::set(uint32_t ssrc, uint32_t slot) {
+    // Keep the load factor at or below 1/2 so probe runs stay short.
+    if ((size_ + 1) * 2 > buckets_.size()) {
+        rehash(buckets_.size() * 2);
+    }
+    size_t i = bucket_for(ssrc);
+    while (buckets_[i].slot != kNoSlot) {
+        if (buckets_[i].ssrc == ssrc) {
+            buckets_[i].slot = slot;
+            return;
+        }
+        i = (i + 1) & mask_;
+    }
+    buckets_[i].ssrc = ssrc;
+    buckets_[i].slot = slot;
+    ++size_;
+}
+
+bool SsrcIndex::erase(uint32_t ssrc) {
+    size_t i = bucket_for(ssrc);
+    while (buckets_[i].ssrc != ssrc || buckets_[i].slot == kNoSlot) {
+        if (buckets_[i].slot == kNoSlot) {
+            return false;
+        }
+        i = (i + 1) & mask_;
+    }
+
+    // Backward-shift: pull later members of the probe run into the hole
+    // unless they already sit at or after their home bucket.
+    size_t hole = i;
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & mask_;
+        if (buckets_[j].slot == kNoSlot) {
+            break;
+        }
+        const size_t home = bucket_for(buckets_[j].ssrc);
+        const bool movable = (hole <= j) ? (home <= hole || home > j)
+                                         : (home <= hole && home > j);
+        if (movable) {
+            buckets_[hole] = buckets_[j];
+            hole = j;
+        }
+    }
+    buckets_[hole] = Bucket{};
+    --size_;
+    return true;
+}
+
+void SsrcIndex::clear() {
+    buckets_.assign(buckets_.size(), Bucket{});
+    size_ = 0;
+}
+
+uint32_t PeerTable::insert(uint32_t ssrc) {
+    const uint32_t existing = index_.find(ssrc);
+    if (existing != kNoSlot) {
+        return existing;
+    }
+    const uint32_t slot = static_cast<uint32_t>(ssrc_.size());
+    ssrc_.push_back(ssrc);
+    addr_.push_back(sockaddr_in{});
+    last_packet_ms_.push_back(0);
+    last_control_ms_.push_back(0);
+    has_control_.push_back(0);
+    cold_.emplace_back();
+    index_.set(ssrc, slot);
+    return slot;
+}
+
+bool PeerTable::erase(uint32_t ssrc) {
+    const uint32_t slot = index_.find(ssrc);
+    if (slot == kNoSlot) {
+        return false;
+    }
+    const uint32_t last = static_cast<uint32_t>(ssrc_.size() - 1);
+    if (slot != last) {
+        ssrc_[slot] = ssrc_[last];
+        addr_[slot] = addr_[last];
+        last_packet_ms_[slot] = last_packet_ms_[last];
+        last_control_ms_[slot] = last_control_ms_[last];
+        has_control_[slot] = has_control_[last];
+        cold_[slot] = std::move(cold_[last]);
+        index_.set(ssrc_[slot], slot);
+    }
+    ssrc_.pop_back();
+    addr_.pop_back();
+    last_packet_ms_.pop_back();
+    last_control_ms_.pop_back();
+    has_control_.pop_back();
+    cold_.pop_back();
+    index_.erase(ssrc);
+    return true;
+}
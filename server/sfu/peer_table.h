@@ -0,0 +1,109 @@
+// 📁 server/sfu/peer_table.h
+// DENSE PEER TABLE for the SFU
+// Peers live in slot-indexed parallel arrays (structure-of-arrays) so the
+// fields touched per packet sit next to each other in memory, with an
+// open-addressing SSRC -> slot index in front. Removal swaps the last slot
+// into the hole, which keeps iteration a linear walk but means a slot is only
+// valid until the next erase().
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sfu/sfu_socket.h"
+
+// Open-addressing SSRC -> slot map. Linear probing with backward-shift
+// deletion, so lookups never wade through tombstones.
+class SsrcIndex {
+public:
+    static constexpr uint32_t kNoSlot = 0xFFFFFFFFu;
+
+    explicit SsrcIndex(size_t expected = 16);
+
+    uint32_t find(uint32_t ssrc) const {
+        size_t i = bucket_for(ssrc);
+        while (true) {
+            const Bucket& b = buckets_[i];
+            if (b.slot == kNoSlot) {
+                return kNoSlot;
+            }
+            if (b.ssrc == ssrc) {
+                return b.slot;
+            }
+            i = (i + 1) & mask_;
+        }
+    }
+
+    // Inserts or overwrites the slot for `ssrc`.
+    void set(uint32_t ssrc, uint32_t slot);
+    bool erase(uint32_t ssrc);
+    void clear();
+    size_t size() const { return size_; }
+
+private:
+    struct Bucket {
+        uint32_t ssrc = 0;
+        uint32_t slot = kNoSlot;
+    };
+
+    size_t bucket_for(uint32_t ssrc) const {
+        // Fibonacci hashing spreads sequential SSRCs across the table.
+        return static_cast<size_t>((ssrc * 0x9E3779B1u) >> shift_);
+    }
+    void rehash(size_t bucket_count);
+
+    std::vector<Bucket> buckets_;
+    size_t mask_ = 0;
+    unsigned shift_ = 0;
+    size_t size_ = 0;
+};
+
+// Fields that only the control plane reads, kept out of the hot arrays.
+struct PeerColdData {
+    static constexpr uint32_t kLocal = 0xFFFFFFFFu;
+
+    sockaddr_in control_addr{};
+    uint64_t join_ms = 0;
+    std::string name;
+    uint32_t trunk = kLocal; // Index of the trunk the peer is reached through
+};
+
+class PeerTable {
+public:
+    static constexpr uint32_t kNoSlot = SsrcIndex::kNoSlot;
+
+    uint32_t find(uint32_t ssrc) const { return index_.find(ssrc); }
+    bool contains(uint32_t ssrc) const { return find(ssrc) != kNoSlot; }
+
+    // Returns the slot for `ssrc`, appending a zeroed peer if it is new.
+    uint32_t insert(uint32_t ssrc);
+    bool erase(uint32_t ssrc);
+
+    size_t size() const { return ssrc_.size(); }
+    bool empty() const { return ssrc_.empty(); }
+
+    // Hot columns, indexed by slot in [0, size()).
+    uint32_t ssrc(uint32_t slot) const { return ssrc_[slot]; }
+    sockaddr_in& addr(uint32_t slot) { return addr_[slot]; }
+    const sockaddr_in& addr(uint32_t slot) const { return addr_[slot]; }
+    uint64_t& last_packet_ms(uint32_t slot) { return last_packet_ms_[slot]; }
+    uint64_t last_packet_ms(uint32_t slot) const { return last_packet_ms_[slot]; }
+    uint64_t& last_control_ms(uint32_t slot) { return last_control_ms_[slot]; }
+    uint64_t last_control_ms(uint32_t slot) const { return last_control_ms_[slot]; }
+    bool has_control(uint32_t slot) const { return has_control_[slot] != 0; }
+    void set_has_control(uint32_t slot, bool value) { has_control_[slot] = value ? 1 : 0; }
+
+    PeerColdData& cold(uint32_t slot) { return cold_[slot]; }
+    const PeerColdData& cold(uint32_t slot) const { return cold_[slot]; }
+
+private:
+    SsrcIndex index_;
+    std::vector<uint32_t> ssrc_;
+    std::vector<sockaddr_in> addr_;
+    std::vector<uint64_t> last_packet_ms_;
+    std::vector<uint64_t> last_control_ms_;
+    std::vector<uint8_t> has_control_;
+    std::vector<PeerColdData> cold_;
+};
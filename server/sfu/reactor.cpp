@@ -0,0 +1,303 @@
+#include "sfu/reactor.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef NOX_SFU_HAS_EPOLL
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+namespace {
+#ifdef NOX_SFU_HAS_EPOLL
+constexpr int kMaxEvents = 16;
+#endif
+}
+
+Reactor::Reactor() = default;
+
+Reactor::~Reactor() {
+#ifdef NOX_SFU_HAS_EPOLL
+    for (const Source& source : sources_) {
+        if (source.kind != SourceKind::Socket) {
+            close(source.fd);
+        }
+    }
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+#else
+    if (wake_fd_ != INVALID_SOCKET) {
+        closesocket(wake_fd_);
+    }
+#endif
+}
+
+uint64_t Reactor::now_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool Reactor::open(Handler on_wake) {
+#ifdef NOX_SFU_HAS_EPOLL
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        return false;
+    }
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ < 0) {
+        return false;
+    }
+#else
+    // Portable self-pipe: a UDP socket on loopback that wake() sends to.
+    wake_fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (wake_fd_ == INVALID_SOCKET) {
+        return false;
+    }
+    wake_addr_.sin_family = AF_INET;
+    wake_addr_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    wake_addr_.sin_port = 0;
+    socklen_t len = sizeof(wake_addr_);
+    if (bind(wake_fd_, (sockaddr*)&wake_addr_, sizeof(wake_addr_)) == SOCKET_ERROR ||
+        getsockname(wake_fd_, (sockaddr*)&wake_addr_, &len) == SOCKET_ERROR) {
+        return false;
+    }
+#ifdef _WIN32
+    u_long non_blocking = 1;
+    ioctlsocket(wake_fd_, FIONBIO, &non_blocking);
+#else
+    int flags = fcntl(wake_fd_, F_GETFL, 0);
+    fcntl(wake_fd_, F_SETFL, flags | O_NONBLOCK);
+#endif
+#endif
+    return register_source(Source{SourceKind::Wake, wake_fd_, std::move(on_wake)});
+}
+
+bool Reactor::register_source(Source source) {
+#ifdef NOX_SFU_HAS_EPOLL
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = static_cast<uint32_t>(sources_.size());
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, source.fd, &ev) != 0) {
+        return false;
+    }
+#endif
+    sources_.push_back(std::move(source));
+    return true;
+}
+
+bool Reactor::add_socket(SocketHandle socket, Handler on_readable) {
+    if (free_slots_.empty()) {
+        return register_source(Source{SourceKind::Socket, socket, std::move(on_readable)});
+    }
+    const uint32_t slot = free_slots_.back();
+#ifdef NOX_SFU_HAS_EPOLL
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u32 = slot;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket, &ev) != 0) {
+        return false;
+    }
+#endif
+    free_slots_.pop_back();
+    sources_[slot] = Source{SourceKind::Socket, socket, std::move(on_readable)};
+    return true;
+}
+
+void Reactor::remove_socket(SocketHandle socket) {
+    for (size_t i = 0; i < sources_.size(); ++i) {
+        Source& source = sources_[i];
+        if (source.kind != SourceKind::Socket || source.fd != socket) {
+            continue;
+        }
+#ifdef NOX_SFU_HAS_EPOLL
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket, nullptr);
+#endif
+        // The handler may be the one running; it is released after dispatch.
+        source.kind = SourceKind::Free;
+        source.fd = INVALID_SOCKET;
+        released_.push_back(static_cast<uint32_t>(i));
+        return;
+    }
+}
+
+void Reactor::recycle_released() {
+    for (uint32_t slot : released_) {
+        sources_[slot].handler = nullptr;
+        free_slots_.push_back(slot);
+    }
+    released_.clear();
+}
+
+bool Reactor::add_timer(uint32_t interval_ms, Handler on_expire) {
+    Source source{SourceKind::Timer, INVALID_SOCKET, std::move(on_expire)};
+    source.interval_ms = std::max<uint32_t>(1, interval_ms);
+    source.next_due_ms = now_ms() + source.interval_ms;
+    source.armed = true;
+#ifdef NOX_SFU_HAS_EPOLL
+    source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (source.fd < 0) {
+        return false;
+    }
+    itimerspec spec{};
+    spec.it_interval.tv_sec = source.interval_ms / 1000;
+    spec.it_interval.tv_nsec = static_cast<long>(source.interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(source.fd, 0, &spec, nullptr) != 0) {
+        close(source.fd);
+        return false;
+    }
+#endif
+    return register_source(std::move(source));
+}
+
+int Reactor::add_oneshot_timer(Handler on_expire) {
+    Source source{SourceKind::Timer, INVALID_SOCKET, std::move(on_expire)};
+#ifdef NOX_SFU_HAS_EPOLL
+    source.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (source.fd < 0) {
+        return -1;
+    }
+#endif
+    const int id = static_cast<int>(sources_.size());
+    return register_source(std::move(source)) ? id : -1;
+}
+
+void Reactor::arm_timer(int id, uint32_t delay_ms) {
+    if (id < 0 || static_cast<size_t>(id) >= sources_.size()) {
+        return;
+    }
+    Source& source = sources_[static_cast<size_t>(id)];
+    if (source.kind != SourceKind::Timer || source.interval_ms != 0 || source.armed) {
+        return;
+    }
+    source.armed = true;
+    source.next_due_ms = now_ms() + delay_ms;
+#ifdef NOX_SFU_HAS_EPOLL
+    itimerspec spec{};
+    // A zero it_value would disarm the timerfd; 1 ns fires immediately.
+    spec.it_value.tv_sec = delay_ms / 1000;
+    spec.it_value.tv_nsec = delay_ms ? static_cast<long>(delay_ms % 1000) * 1000000L : 1;
+    timerfd_settime(source.fd, 0, &spec, nullptr);
+#endif
+}
+
+void Reactor::fire_timer(Source& source) {
+    if (source.interval_ms == 0) {
+        // Disarm first so the handler can re-arm.
+        source.armed = false;
+    }
+    source.handler();
+}
+
+void Reactor::wake() {
+#ifdef NOX_SFU_HAS_EPOLL
+    const uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = write(wake_fd_, &one, sizeof(one));
+#else
+    const char byte = 0;
+    sendto(wake_fd_, &byte, 1, 0, (const sockaddr*)&wake_addr_, sizeof(wake_addr_));
+#endif
+}
+
+void Reactor::drain_wake() {
+#ifdef NOX_SFU_HAS_EPOLL
+    uint64_t value = 0;
+    [[maybe_unused]] ssize_t n = read(wake_fd_, &value, sizeof(value));
+#else
+    char buf[64];
+    while (recv(wake_fd_, buf, sizeof(buf), 0) > 0) {
+    }
+#endif
+}
+
+void Reactor::run_once() {
+#ifdef NOX_SFU_HAS_EPOLL
+    epoll_event events[kMaxEvents];
+    const int n = epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+    for (int i = 0; i < n; ++i) {
+        Source& source = sources_[events[i].data.u32];
+        switch (source.kind) {
+        case SourceKind::Wake:
+            drain_wake();
+            if (source.handler) {
+                source.handler();
+            }
+            break;
+        case SourceKind::Timer: {
+            uint64_t expirations = 0;
+            if (read(source.fd, &expirations, sizeof(expirations)) > 0) {
+                fire_timer(source);
+            }
+            break;
+        }
+        case SourceKind::Socket:
+            source.handler();
+            break;
+        case SourceKind::Free:
+            // Removed by an earlier handler of this round.
+            break;
+        }
+    }
+    recycle_released();
+#else
+    int timeout_ms = -1;
+    const uint64_t now = now_ms();
+    for (const Source& source : sources_) {
+        if (source.kind == SourceKind::Timer && source.armed) {
+            const int remaining = source.next_due_ms > now
+                                      ? static_cast<int>(source.next_due_ms - now)
+                                      : 0;
+            timeout_ms = (timeout_ms < 0) ? remaining : std::min(timeout_ms, remaining);
+        }
+    }
+
+#ifdef _WIN32
+    std::vector<WSAPOLLFD> fds;
+#else
+    std::vector<pollfd> fds;
+#endif
+    std::vector<size_t> owners;
+    for (size_t i = 0; i < sources_.size(); ++i) {
+        if (sources_[i].kind == SourceKind::Timer || sources_[i].kind == SourceKind::Free) {
+            continue;
+        }
+        fds.push_back({sources_[i].fd, POLLIN, 0});
+        owners.push_back(i);
+    }
+
+#ifdef _WIN32
+    const int n = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout_ms);
+#else
+    const int n = poll(fds.data(), static_cast<nfds_t>(fds.size()), timeout_ms);
+#endif
+    if (n > 0) {
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if ((fds[i].revents & POLLIN) == 0) {
+                continue;
+            }
+            Source& source = sources_[owners[i]];
+            if (source.kind == SourceKind::Wake) {
+                drain_wake();
+                if (source.handler) {
+                    source.handler();
+                }
+            } else if (source.kind == SourceKind::Socket) {
+                source.handler();
+            }
+        }
+    }
+
+    const uint64_t after = now_ms();
+    for (Source& source : sources_) {
+        if (source.kind == SourceKind::Timer && source.armed && source.next_due_ms <= after) {
+            source.next_due_ms = after + source.interval_ms;
+            fire_timer(source);
+        }
+    }
+    recycle_released();
+#endif
+}
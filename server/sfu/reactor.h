@@ -0,0 +1,84 @@
+// 📁 server/sfu/reactor.h
+// EVENT REACTOR for the SFU loops
+// Blocks until a registered socket is readable or a timer is due, then runs
+// the matching handler. Linux uses epoll + timerfd + eventfd; other platforms
+// use poll()/WSAPoll with deadline-driven timeouts and a loopback wake socket.
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "sfu/sfu_socket.h"
+
+#if defined(__linux__)
+#define NOX_SFU_HAS_EPOLL 1
+#endif
+
+class Reactor {
+public:
+    using Handler = std::function<void()>;
+
+    Reactor();
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator=(const Reactor&) = delete;
+
+    // `on_wake`, if set, runs on the reactor thread after each wake().
+    bool open(Handler on_wake = nullptr);
+
+    // Level-triggered: the handler should drain the socket, but anything it
+    // leaves behind wakes the next run_once() immediately.
+    bool add_socket(SocketHandle socket, Handler on_readable);
+
+    // Stops watching `socket`; the caller still owns and closes it. Safe from
+    // inside any handler, including the socket's own.
+    void remove_socket(SocketHandle socket);
+
+    // Periodic timer; the first expiry is one interval from now.
+    bool add_timer(uint32_t interval_ms, Handler on_expire);
+
+    // One-shot timer, created disarmed. Returns an id for arm_timer(), or -1.
+    int add_oneshot_timer(Handler on_expire);
+
+    // Fires the one-shot timer `delay_ms` from now. A timer that is already
+    // armed keeps its original deadline, so repeated calls coalesce.
+    void arm_timer(int id, uint32_t delay_ms);
+
+    // Waits for at least one event (or wake()) and dispatches handlers.
+    void run_once();
+
+    // Interrupts a blocked run_once() from another thread.
+    void wake();
+
+private:
+    enum class SourceKind { Socket, Timer, Wake, Free };
+
+    struct Source {
+        SourceKind kind;
+        SocketHandle fd;
+        Handler handler;
+        uint32_t interval_ms = 0; // 0 for one-shot timers
+        uint64_t next_due_ms = 0;
+        bool armed = false;
+    };
+
+    // A deque so handlers can add sources without moving the one running.
+    std::deque<Source> sources_;
+    std::vector<uint32_t> released_;   // Removed this round; handlers still alive
+    std::vector<uint32_t> free_slots_; // Reusable by add_socket()
+    SocketHandle wake_fd_ = INVALID_SOCKET;
+#ifdef NOX_SFU_HAS_EPOLL
+    int epoll_fd_ = -1;
+#else
+    sockaddr_in wake_addr_{};
+#endif
+
+    bool register_source(Source source);
+    void recycle_released();
+    void fire_timer(Source& source);
+    void drain_wake();
+    static uint64_t now_ms();
+};
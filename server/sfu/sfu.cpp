@@ -8,56 +8,140 @@
 #include <string>
 #include <thread>
 #include <chrono>
-#include <mutex>
+#include <atomic>
 #include <vector>
 #include <cstring>
 #include <set>
 #include <cstdio>
+#include <cstdlib>
 #include <algorithm>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "constants.h"
 #include "shared/protocol/control_protocol.h"
 #include "shared/protocol/network_packet.h"
 #include "permission/permission_manager.h"
-#ifdef _WIN32
-    #include <winsock2.h>
-    #include <ws2tcpip.h>
-#ifdef _MSC_VER
-    #pragma comment(lib, "ws2_32.lib")
-#endif
-    typedef int socklen_t;
-    using SocketHandle = SOCKET;
-#else
-    #include <sys/socket.h>
-    #include <netinet/in.h>
-    #include <arpa/inet.h>
-    #include <fcntl.h>
-    #include <unistd.h>
-    #define closesocket close
-    #define INVALID_SOCKET -1
-    #define SOCKET_ERROR -1
-    using SocketHandle = int;
-#endif
+#include "sfu/sfu_socket.h"
+#include "sfu/batch_io.h"
+#include "sfu/reactor.h"
+#include "sfu/sharding.h"
+#include "sfu/spsc_ring.h"
+#include "sfu/peer_table.h"
+#include "sfu/uring_io.h"
+#include "sfu/metrics.h"
+#include "sfu/trunk.h"
+#include "sfu/handoff.h"
+#include "sfu/pacing.h"
+#include "utils/Logger.h"
+#include "utils/TimerWheel.h"
 
 #define AUDIO_PORT 5004
 #define MAX_PEERS 100
 #define RECV_BUFFER_SIZE 8192
+#define DEFAULT_IO_BATCH 32
+#define MAX_DRAIN_ROUNDS 64
+#define MAX_MEDIA_WORKERS 64
+#define LIVENESS_TICK_MS 250
+#define PEER_TIMEOUT_MS 10000
+#define LIVENESS_FLUSH_INTERVAL_MS 1000
+#define IO_STATS_INTERVAL_MS 10000
+#define MEDIA_EVENT_RING_SIZE 1024
+#define URING_RECV_BUFFERS 1024
+#define URING_RECV_HEADROOM 64 // io_uring_recvmsg_out + source address ahead of each payload
+#define PRESENCE_COALESCE_MS 50
+#define SPEAKER_SELECT_INTERVAL_MS 100
+#define SPEAKER_REPORT_MS 100      // Min gap between one sender's level reports
+#define SPEAKER_REFRESH_MS 1000    // Quiet senders still report this often
+#define SPEAKER_STALE_MS 2500      // No report for this long: not a candidate
+#define SPEAKER_HOLD_MS 1000       // A voiced sender outranks unvoiced ones this long
+#define SPEAKER_LEVEL_STEP_DB 3    // Level change worth reporting early
+#define SPEAKER_LEVEL_SMOOTHING 0.2f
+#define TRUNK_SYNC_MS 1000         // Full user list to every trunk
+#define TRUNK_TIMEOUT_MS 3500      // Silent trunk: forget the users it announced
+#define HANDOFF_TIMEOUT_MS 5000    // Each step of a hot upgrade
+#define PACER_TICK_MS 5
+#define PACER_MIN_BURST_BYTES 1500
+
+struct SfuOptions {
+    size_t io_batch = DEFAULT_IO_BATCH; // Datagrams per recvmmsg/sendmmsg (1 = classic per-packet I/O)
+    bool udp_gro = false;               // Ask the kernel to coalesce inbound datagrams (Linux)
+    size_t workers = 1;                 // Media worker threads sharing AUDIO_PORT via SO_REUSEPORT
+    bool pin_workers = false;           // Pin worker i to CPU i
+    bool io_uring = false;              // io_uring media path instead of recvmmsg/sendmmsg (Linux 6.0+)
+    uint16_t metrics_port = 0;          // Loopback Prometheus endpoint (0 = off)
+    size_t max_speakers = 0;            // Broadcast senders forwarded per channel (0 = all)
+    uint16_t control_port = DEFAULT_CONTROL_PORT;
+    uint32_t node_id = 0;               // Identifies this node to trunks (0 = the control port)
+    std::vector<std::string> trunks;    // host:control_port of the other SFU nodes
+    std::string handoff_path;           // Unix socket a replacement process can take over from
+    bool takeover = false;              // Take over from the process listening on handoff_path
+    uint32_t pace_kbps = 0;             // Egress budget per receiver (0 = no pacing)
+    uint32_t pace_burst_ms = 60;        // Bucket depth, in time at that rate
+    size_t pace_queue = 32;             // Copies held per receiver
+};
 
-struct Peer {
-    sockaddr_in addr;
-    sockaddr_in control_addr;
-    uint32_t ssrc;           // Unique identifier
-    uint64_t last_packet_ms; // For timeout detection
-    uint64_t last_control_ms; // Control heartbeat
-    uint64_t join_ms;        // Join time (for strict mode)
-    std::string name;
-    bool has_control = false;
+struct RouteInfo {
+    bool broadcast = true;
+    std::set<uint32_t> targets;
+};
+
+// Destinations for one sender's audio, already filtered by route and
+// permissions, in the order the copies are sent.
+using FanOutList = std::vector<sockaddr_in>;
+
+// Immutable copy of everything the forwarding path reads. The control thread
+// rebuilds it after each mutation and swaps it in atomically; workers keep a
+// reference until they see a newer version, so readers never take a lock.
+// Columns are indexed by the slot `index` maps an SSRC to.
+struct RoutingView {
+    SsrcIndex index;
+    std::vector<sockaddr_in> addrs;
+    std::vector<uint8_t> has_control;
+    // Shared with earlier snapshots until one of its inputs changes.
+    std::vector<std::shared_ptr<const FanOutList>> fanouts;
+    // Set for senders outside their channel's selected speakers.
+    std::vector<uint8_t> speaker_gated;
+    // Set for senders on a targeted TALK route (egress priority).
+    std::vector<uint8_t> talk_route;
+    // Where other nodes send relayed audio from; never learned as a client.
+    std::vector<sockaddr_in> trunk_addrs;
+
+    explicit RoutingView(size_t peer_count) : index(peer_count) {
+        addrs.reserve(peer_count);
+        has_control.reserve(peer_count);
+        fanouts.reserve(peer_count);
+        speaker_gated.reserve(peer_count);
+        talk_route.reserve(peer_count);
+    }
+    size_t size() const { return addrs.size(); }
 };
 
 namespace {
-bool has_audio_endpoint(const Peer& peer) {
-    return peer.addr.sin_family == AF_INET && peer.addr.sin_port != 0;
+bool has_audio_endpoint(const sockaddr_in& addr) {
+    return addr.sin_family == AF_INET && addr.sin_port != 0;
+}
+
+bool same_endpoint(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+bool is_trunk_endpoint(const RoutingView& view, const sockaddr_in& addr) {
+    for (const sockaddr_in& trunk : view.trunk_addrs) {
+        if (same_endpoint(trunk, addr)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t endpoint_key(const sockaddr_in& addr) {
+    return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+}
+
+uint64_t steady_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 std::string ascii_lower(std::string s) {
@@ -73,46 +157,184 @@ std::string ascii_lower(std::string s) {
 
 class SFU {
 public:
-    SFU();
+    explicit SFU(const SfuOptions& options = SfuOptions{});
     ~SFU();
 
     bool initialize(uint16_t audio_port = AUDIO_PORT);
     void start();
     void stop();
+    bool running() const { return running_; }
 
 private:
-    SocketHandle audio_socket_;
-    SocketHandle control_socket_;
-    std::map<uint32_t, Peer> peers_;
-    struct RouteInfo {
-        bool broadcast = true;
-        std::set<uint32_t> targets;
+    // Per-sender state owned by the worker the sender's datagrams are steered
+    // to. Only that worker touches it, so it needs no lock.
+    struct SenderState {
+        uint64_t last_packet_ms = 0;
+        uint64_t recv_count = 0;
+        uint64_t rx_packets = 0; // Every datagram, published as per-SSRC metrics
+        uint64_t rx_bytes = 0;
+        bool endpoint_reported = false; // Waiting for the control thread to publish it
+        sockaddr_in reported_addr{};
+        // Smoothed AudioPacket::audio_level, in -dBov (lower is louder).
+        bool has_level = false;
+        float level_dbov = AUDIO_LEVEL_SILENT;
+        uint64_t last_voice_ms = 0;
+        uint64_t level_reported_ms = 0;
+        uint8_t reported_level = AUDIO_LEVEL_SILENT;
+        bool reported_voice = false;
+    };
+
+    // Worker -> control thread notifications. Peer state is owned by the
+    // control thread alone; workers only ever report what they observed.
+    struct MediaEvent {
+        enum class Kind : uint8_t { Endpoint, Liveness, Speaker };
+        Kind kind = Kind::Endpoint;
+        uint32_t ssrc = 0;
+        sockaddr_in addr{};
+        uint64_t last_packet_ms = 0;
+        uint64_t last_voice_ms = 0; // Speaker only
+        uint8_t level_dbov = AUDIO_LEVEL_SILENT;
+    };
+
+    // Latest level report per sender, for --max-speakers.
+    struct SpeakerInfo {
+        uint8_t level_dbov = AUDIO_LEVEL_SILENT;
+        uint64_t last_voice_ms = 0;
+        uint64_t updated_ms = 0;
+    };
+
+    struct ShardState {
+        std::unordered_map<uint32_t, SenderState> senders;
+    };
+
+    struct MediaWorker {
+        size_t index = 0;
+        SocketHandle socket = INVALID_SOCKET;
+        Reactor reactor;
+        std::thread thread;
+        SpscRing<MediaEvent> events{MEDIA_EVENT_RING_SIZE};
+        sfumetrics::MetricsShard* metrics = nullptr; // Written by this worker only
+        std::atomic<uint64_t> egress_depth{0};       // Copies its pacer holds
+        // Worker-local cache of the published snapshot.
+        std::shared_ptr<const RoutingView> view;
+        uint64_t view_version = 0;
     };
+
+    SocketHandle control_socket_;
+    // Owned by the control thread; media workers see them only through
+    // the published RoutingView.
+    PeerTable peers_;
     std::map<uint32_t, RouteInfo> routes_;
-    std::mutex peers_mutex_;
-    bool running_;
-    std::thread audio_thread_;
+    std::map<uint32_t, std::set<uint32_t>> targeted_by_; // target -> senders listing it in routes_
+    std::unordered_map<uint32_t, std::shared_ptr<const FanOutList>> fanout_cache_;
+    std::set<uint32_t> dirty_fanout_; // Senders whose cached list must be rebuilt
+    bool broadcast_fanout_dirty_ = false; // Every broadcast sender's list too
+    std::unordered_map<uint32_t, SpeakerInfo> speakers_;
+    std::unordered_set<uint32_t> gated_speakers_; // Published as RoutingView::speaker_gated
+    // Other SFU nodes. Peers learned from trunks_[i] carry cold().trunk == i.
+    std::vector<TrunkLink> trunks_;
+    std::set<uint32_t> pending_trunk_; // Local users to re-announce with the next presence flush
+    uint16_t audio_port_ = AUDIO_PORT;
+    // Hot upgrade: the listener a successor connects to, and (in the
+    // successor) the connection to ack once forwarding has resumed.
+    SocketHandle handoff_listener_ = INVALID_SOCKET;
+    SocketHandle takeover_conn_ = INVALID_SOCKET;
+    // Control-plane lookups, maintained on JOIN/LEAVE/timeout.
+    std::unordered_map<uint64_t, uint32_t> ssrc_by_control_endpoint_; // endpoint_key() -> SSRC
+    std::unordered_map<std::string, uint32_t> ssrc_by_name_;          // ascii_lower(name) -> SSRC
+    // Presence: changes queued within PRESENCE_COALESCE_MS go out as one
+    // USER_DELTA per datagram, each bumping presence_version_.
+    uint32_t presence_version_ = 0;
+    std::vector<CtrlUserChange> pending_presence_;
+    std::unordered_map<uint32_t, size_t> pending_presence_index_; // SSRC -> pending_presence_ index
+    int presence_timer_ = -1;
+    // One deadline per peer, re-armed on control traffic and re-checked
+    // against the real timestamps when it fires.
+    TimerWheel liveness_wheel_;
+    std::vector<TimerWheel::Key> expired_peers_;
+    std::shared_ptr<const RoutingView> routing_view_; // Accessed via std::atomic_load/store
+    std::atomic<uint64_t> routing_version_{0};
+    std::atomic<bool> running_;
+    std::vector<std::unique_ptr<MediaWorker>> workers_;
+    Reactor control_reactor_;
     std::thread control_thread_;
     PermissionManager permissions_;
-
-    void audio_loop();
+    sfumetrics::MetricsRegistry metrics_;
+    sfumetrics::MetricsEndpoint metrics_endpoint_;
+    SfuOptions options_;
+
+    bool open_media_socket(MediaWorker& worker, uint16_t audio_port, bool shared_port);
+    void media_worker_loop(MediaWorker& worker);
+    void drain_media_socket(MediaWorker& worker, BatchReceiver& rx, BatchSender& tx, ShardState& shard,
+                            EgressPacer& pacer);
+    void drain_uring(MediaWorker& worker, UringMediaIo& io, ShardState& shard, EgressPacer& pacer);
+    const FanOutList* handle_audio_datagram(MediaWorker& worker, const RoutingView& view,
+                                            const Datagram& dgram, uint64_t now, ShardState& shard,
+                                            EgressClass& egress);
+    PacerOptions pacer_options() const;
+    void report_pacer(MediaWorker& worker, const EgressPacer& pacer);
+    const RoutingView& refresh_view(MediaWorker& worker);
+    bool post_media_event(MediaWorker& worker, const MediaEvent& event);
+    void flush_shard_liveness(MediaWorker& worker, ShardState& shard);
+    void track_audio_level(MediaWorker& worker, SenderState& state, uint32_t ssrc, uint8_t audio_level,
+                           uint64_t now);
+    void drain_media_events();
+    void select_speakers();
+    void learn_audio_endpoint(uint32_t ssrc, const sockaddr_in& addr, uint64_t now);
+    void publish_routing();
+    std::shared_ptr<const FanOutList> build_fanout(uint32_t sender) const;
+    void invalidate_sender(uint32_t ssrc);
+    void invalidate_receiver(uint32_t ssrc);
+    void add_route_target(uint32_t sender, uint32_t target);
+    void clear_route_targets(uint32_t sender);
+    void remove_peer(uint32_t ssrc);
+    void unindex_control(uint32_t slot);
+    void register_metrics();
+    void report_io_stats(const MediaWorker& worker, const char* backend,
+                         const BatchIoStats& in, const BatchIoStats& out);
     void control_loop();
+    void drain_control_socket();
+    void handle_control_message(const uint8_t* buffer, int recv_len, const sockaddr_in& sender);
     uint64_t now_ms();
-    void cleanup_inactive_peers();
-    void broadcast_user_list();
-    void broadcast_talk_update(uint32_t from, const std::set<uint32_t>& targets);
-    void send_user_list_to(const sockaddr_in& addr);
+    uint64_t liveness_deadline(uint32_t slot) const;
+    void touch_control(uint32_t slot);
+    void expire_inactive_peers();
+    CtrlUserInfo user_info(uint32_t slot) const;
+    void queue_presence(CtrlPresenceOp op, uint32_t ssrc);
+    void flush_presence();
+    void send_presence_snapshot_to(const sockaddr_in& addr);
+    void send_talk_update(uint32_t from, const std::set<uint32_t>& targets, const std::set<uint32_t>& recipients);
+    bool is_remote(uint32_t slot) const { return peers_.cold(slot).trunk != PeerColdData::kLocal; }
+    CtrlTrunkUser trunk_user(uint32_t ssrc) const;
+    void send_to_trunks(const std::vector<CtrlTrunkUser>& users);
+    void flush_trunk_changes();
+    void sync_trunks();
+    void handle_trunk_users(size_t trunk, const uint8_t* payload, size_t len, const sockaddr_in& sender);
+    void drop_trunk_peers(size_t trunk, uint64_t older_than_ms);
+    bool take_over(std::vector<SocketHandle>& sockets, std::string& state);
+    std::string snapshot_state() const;
+    bool restore_state(const std::string& state);
+    void serve_handoff();
 };
 
-SFU::SFU()
-    : audio_socket_(INVALID_SOCKET),
-      control_socket_(INVALID_SOCKET),
-      running_(false) {}
+SFU::SFU(const SfuOptions& options)
+    : control_socket_(INVALID_SOCKET),
+      liveness_wheel_(LIVENESS_TICK_MS, now_ms()),
+      running_(false),
+      options_(options) {}
 
 SFU::~SFU() {
     stop();
-    if (audio_socket_ != INVALID_SOCKET) {
-        closesocket(audio_socket_);
+    if (handoff_listener_ != INVALID_SOCKET) {
+        closesocket(handoff_listener_);
+    }
+    if (takeover_conn_ != INVALID_SOCKET) {
+        closesocket(takeover_conn_);
+    }
+    for (auto& worker : workers_) {
+        if (worker->socket != INVALID_SOCKET) {
+            closesocket(worker->socket);
+        }
     }
     if (control_socket_ != INVALID_SOCKET) {
         closesocket(control_socket_);
@@ -133,27 +355,65 @@ bool SFU::initialize(uint16_t audio_port) {
     }
 #endif
 
-    // Create UDP socket for audio
-    audio_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (audio_socket_ == INVALID_SOCKET) {
-        std::cerr << "[SFU] Socket creation failed\n";
+    audio_port_ = audio_port;
+    if (options_.node_id == 0) {
+        options_.node_id = options_.control_port;
+    }
+    for (const std::string& spec : options_.trunks) {
+        TrunkLink trunk;
+        trunk.spec = spec;
+        if (!parse_trunk_endpoint(spec, trunk.control_addr)) {
+            std::cerr << "[SFU] Bad trunk address: " << spec << "\n";
+            return false;
+        }
+        trunks_.push_back(trunk);
+    }
+
+    // Taking over: [handoff listener, control, metrics?, media...] arrive
+    // already bound, in that order.
+    std::vector<SocketHandle> inherited;
+    std::string inherited_state;
+    if (options_.takeover && !take_over(inherited, inherited_state)) {
         return false;
     }
+    const bool inherited_metrics = !inherited_state.empty() && inherited_state[0] != 0;
+    const size_t first_media = inherited_metrics ? 3 : 2;
+
+    size_t worker_count = std::min<size_t>(std::max<size_t>(1, options_.workers), MAX_MEDIA_WORKERS);
+    if (!inherited.empty()) {
+        worker_count = inherited.size() - first_media;
+        if (worker_count != options_.workers) {
+            std::cout << "[SFU] Keeping the " << worker_count << " media worker(s) of the previous process\n";
+        }
+    } else if (worker_count > 1 && !sfushard::reuseport_supported()) {
+        std::cerr << "[SFU] SO_REUSEPORT load balancing unavailable, using 1 media worker\n";
+        worker_count = 1;
+    }
 
-    sockaddr_in addr{};
-    addr.sin_family = AF_INET;
-    addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    addr.sin_port = htons(audio_port);
+    for (size_t i = 0; i < worker_count; ++i) {
+        auto worker = std::make_unique<MediaWorker>();
+        worker->index = i;
+        worker->metrics = &metrics_.add_shard();
+        if (!inherited.empty()) {
+            worker->socket = inherited[first_media + i];
+        }
+        if (!open_media_socket(*worker, audio_port, worker_count > 1)) {
+            return false;
+        }
+        workers_.push_back(std::move(worker));
+    }
 
-    if (bind(audio_socket_, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
-        std::cerr << "[SFU] Bind failed on port " << audio_port << "\n";
-        closesocket(audio_socket_);
-        audio_socket_ = INVALID_SOCKET;
-        return false;
+    if (worker_count > 1 && inherited.empty()) {
+        if (sfushard::attach_ssrc_steering(workers_[0]->socket, static_cast<uint32_t>(worker_count))) {
+            std::cout << "[SFU] SSRC steering attached across " << worker_count << " media workers\n";
+        } else {
+            // The kernel's 4-tuple hash still pins each sender flow to one worker.
+            std::cerr << "[SFU] SSRC steering unavailable, falling back to flow hashing\n";
+        }
     }
 
     // Create UDP socket for control
-    control_socket_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    control_socket_ = inherited.empty() ? socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP) : inherited[1];
     if (control_socket_ == INVALID_SOCKET) {
         std::cerr << "[SFU] Control socket creation failed\n";
         return false;
@@ -162,10 +422,11 @@ bool SFU::initialize(uint16_t audio_port) {
     sockaddr_in ctrl_addr{};
     ctrl_addr.sin_family = AF_INET;
     ctrl_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-    ctrl_addr.sin_port = htons(DEFAULT_CONTROL_PORT);
+    ctrl_addr.sin_port = htons(options_.control_port);
 
-    if (bind(control_socket_, (sockaddr*)&ctrl_addr, sizeof(ctrl_addr)) == SOCKET_ERROR) {
-        std::cerr << "[SFU] Control bind failed on port " << DEFAULT_CONTROL_PORT << "\n";
+    if (inherited.empty() &&
+        bind(control_socket_, (sockaddr*)&ctrl_addr, sizeof(ctrl_addr)) == SOCKET_ERROR) {
+        std::cerr << "[SFU] Control bind failed on port " << options_.control_port << "\n";
         closesocket(control_socket_);
         control_socket_ = INVALID_SOCKET;
         return false;
@@ -174,97 +435,439 @@ bool SFU::initialize(uint16_t audio_port) {
     // Set non-blocking mode
 #ifdef _WIN32
     u_long non_blocking = 1;
-    ioctlsocket(audio_socket_, FIONBIO, &non_blocking);
     ioctlsocket(control_socket_, FIONBIO, &non_blocking);
 #else
-    int flags = fcntl(audio_socket_, F_GETFL, 0);
-    fcntl(audio_socket_, F_SETFL, flags | O_NONBLOCK);
     int cflags = fcntl(control_socket_, F_GETFL, 0);
     fcntl(control_socket_, F_SETFL, cflags | O_NONBLOCK);
 #endif
 
-    std::cout << "[SFU] Initialized on port " << audio_port << "\n";
-    std::cout << "[SFU] Control port " << DEFAULT_CONTROL_PORT << "\n";
+    if (!control_reactor_.open([this]() { drain_media_events(); })) {
+        std::cerr << "[SFU] Event reactor setup failed\n";
+        return false;
+    }
+    control_reactor_.add_socket(control_socket_, [this]() { drain_control_socket(); });
+    control_reactor_.add_timer(LIVENESS_TICK_MS, [this]() { expire_inactive_peers(); });
+    if (options_.max_speakers > 0) {
+        control_reactor_.add_timer(SPEAKER_SELECT_INTERVAL_MS, [this]() { select_speakers(); });
+    }
+    if (!trunks_.empty()) {
+        control_reactor_.add_timer(TRUNK_SYNC_MS, [this]() { sync_trunks(); });
+    }
+    presence_timer_ = control_reactor_.add_oneshot_timer([this]() { flush_presence(); });
+    if (inherited_metrics) {
+        metrics_endpoint_.adopt(inherited[2]);
+    }
+    register_metrics();
+
+    if (!inherited.empty()) {
+        handoff_listener_ = inherited[0];
+        if (!restore_state(inherited_state)) {
+            std::cerr << "[SFU] Handed-over state is corrupt\n";
+            return false;
+        }
+    } else if (!options_.handoff_path.empty()) {
+        std::string error;
+        handoff_listener_ = sfuhandoff::listen_at(options_.handoff_path, error);
+        if (handoff_listener_ == INVALID_SOCKET) {
+            std::cerr << "[SFU] Handoff socket " << options_.handoff_path << " unavailable: " << error << "\n";
+            return false;
+        }
+    }
+    if (handoff_listener_ != INVALID_SOCKET) {
+        control_reactor_.add_socket(handoff_listener_, [this]() { serve_handoff(); });
+    }
+
+    publish_routing();
+
+    std::cout << "[SFU] Initialized on port " << audio_port
+              << " (" << workers_.size() << " media worker" << (workers_.size() == 1 ? "" : "s") << ")\n";
+    std::cout << "[SFU] Control port " << options_.control_port << "\n";
+    for (const TrunkLink& trunk : trunks_) {
+        std::cout << "[SFU] Trunk to " << trunk.spec << " (node " << options_.node_id << ")\n";
+    }
+    return true;
+}
+
+// A socket already set on `worker` was inherited and is bound.
+bool SFU::open_media_socket(MediaWorker& worker, uint16_t audio_port, bool shared_port) {
+    const bool inherited = worker.socket != INVALID_SOCKET;
+    if (!inherited) {
+        worker.socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    }
+    if (worker.socket == INVALID_SOCKET) {
+        std::cerr << "[SFU] Socket creation failed\n";
+        return false;
+    }
+
+    if (!inherited && shared_port && !sfushard::enable_reuseport(worker.socket)) {
+        std::cerr << "[SFU] SO_REUSEPORT failed for media worker " << worker.index << "\n";
+        return false;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(audio_port);
+
+    if (!inherited && bind(worker.socket, (sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+        std::cerr << "[SFU] Bind failed on port " << audio_port << "\n";
+        closesocket(worker.socket);
+        worker.socket = INVALID_SOCKET;
+        return false;
+    }
+
+#ifdef _WIN32
+    u_long non_blocking = 1;
+    ioctlsocket(worker.socket, FIONBIO, &non_blocking);
+#else
+    int flags = fcntl(worker.socket, F_GETFL, 0);
+    fcntl(worker.socket, F_SETFL, flags | O_NONBLOCK);
+#endif
+
+    if (!worker.reactor.open()) {
+        std::cerr << "[SFU] Event reactor setup failed\n";
+        return false;
+    }
     return true;
 }
 
-void SFU::cleanup_inactive_peers() {
-    std::lock_guard<std::mutex> lock(peers_mutex_);
-    
-    uint64_t now = now_ms();
-    const uint64_t TIMEOUT_MS = 10000;  // 10 seconds (audio)
-    const uint64_t CTRL_TIMEOUT_MS = 10000;  // 10 seconds (control)
+void SFU::publish_routing() {
+    if (broadcast_fanout_dirty_) {
+        for (uint32_t slot = 0; slot < peers_.size(); ++slot) {
+            const uint32_t sender = peers_.ssrc(slot);
+            auto route = routes_.find(sender);
+            if (route == routes_.end() || route->second.broadcast || route->second.targets.empty()) {
+                dirty_fanout_.insert(sender);
+            }
+        }
+        broadcast_fanout_dirty_ = false;
+    }
+    for (uint32_t ssrc : dirty_fanout_) {
+        if (peers_.contains(ssrc)) {
+            fanout_cache_[ssrc] = build_fanout(ssrc);
+        } else {
+            fanout_cache_.erase(ssrc);
+        }
+    }
+    dirty_fanout_.clear();
+
+    auto view = std::make_shared<RoutingView>(peers_.size());
+    for (uint32_t slot = 0; slot < peers_.size(); ++slot) {
+        const uint32_t ssrc = peers_.ssrc(slot);
+        auto cached = fanout_cache_.find(ssrc);
+        if (cached == fanout_cache_.end()) {
+            cached = fanout_cache_.emplace(ssrc, build_fanout(ssrc)).first;
+        }
+        view->index.set(ssrc, slot);
+        view->addrs.push_back(peers_.addr(slot));
+        view->has_control.push_back(peers_.has_control(slot) ? 1 : 0);
+        view->fanouts.push_back(cached->second);
+        view->speaker_gated.push_back(gated_speakers_.count(ssrc) ? 1 : 0);
+        auto route = routes_.find(ssrc);
+        view->talk_route.push_back(route != routes_.end() && !route->second.broadcast &&
+                                   !route->second.targets.empty() ? 1 : 0);
+    }
+    for (const TrunkLink& trunk : trunks_) {
+        if (trunk.up()) {
+            view->trunk_addrs.push_back(trunk.media_addr);
+        }
+    }
+
+    std::atomic_store(&routing_view_, std::shared_ptr<const RoutingView>(std::move(view)));
+    routing_version_.fetch_add(1, std::memory_order_release);
+}
 
-    std::vector<uint32_t> to_remove;
-    
-    for (auto& [ssrc, peer] : peers_) {
-        bool audio_stale = (now - peer.last_packet_ms > TIMEOUT_MS);
-        bool control_stale = peer.has_control && (now - peer.last_control_ms > CTRL_TIMEOUT_MS);
-        bool join_stale = (!peer.has_control) && (now - peer.join_ms > CTRL_TIMEOUT_MS);
-        if ((peer.has_control && control_stale) || (!peer.has_control && join_stale) ||
-            (!peer.has_control && audio_stale)) {
-            to_remove.push_back(ssrc);
+std::shared_ptr<const FanOutList> SFU::build_fanout(uint32_t sender) const {
+    auto list = std::make_shared<FanOutList>();
+
+    static const RouteInfo kDefaultRoute;
+    auto route_it = routes_.find(sender);
+    const RouteInfo& route = (route_it != routes_.end()) ? route_it->second : kDefaultRoute;
+
+    // Audio from another node is only fanned out locally; local audio goes
+    // to each node with at least one eligible listener, once.
+    const uint32_t sender_slot = peers_.find(sender);
+    const bool relay = sender_slot != PeerTable::kNoSlot && !is_remote(sender_slot);
+
+    if (route.broadcast || route.targets.empty()) {
+        // Channel and mute filtering is a bitset pass; only the listeners
+        // it leaves are looked up.
+        PermissionManager::Bitset eligible;
+        permissions_.eligible_listeners(sender, eligible);
+        std::vector<uint8_t> trunk_wanted(trunks_.size(), 0);
+        PermissionManager::for_each_set_bit(eligible, [&](uint32_t permission_slot) {
+            const uint32_t slot = peers_.find(permissions_.ssrc_at(permission_slot));
+            if (slot == PeerTable::kNoSlot || !has_audio_endpoint(peers_.addr(slot))) {
+                return;
+            }
+            if (is_remote(slot)) {
+                if (relay) {
+                    trunk_wanted[peers_.cold(slot).trunk] = 1;
+                }
+            } else {
+                list->push_back(peers_.addr(slot));
+            }
+        });
+        for (size_t trunk = 0; trunk < trunks_.size(); ++trunk) {
+            if (trunk_wanted[trunk] && trunks_[trunk].up()) {
+                list->push_back(trunks_[trunk].media_addr);
+            }
+        }
+    } else {
+        // TALK routes are not federated; they stay within this node.
+        for (uint32_t target : route.targets) {
+            const uint32_t slot = peers_.find(target);
+            if (slot == PeerTable::kNoSlot || !has_audio_endpoint(peers_.addr(slot)) || is_remote(slot)) {
+                continue;
+            }
+            if (!permissions_.can_receive(target, sender)) {
+                continue;
+            }
+            list->push_back(peers_.addr(slot));
         }
     }
+    return list;
+}
 
-    for (uint32_t ssrc : to_remove) {
-        std::cout << "[SFU] Removing inactive peer SSRC=" << ssrc << "\n";
-        peers_.erase(ssrc);
-        routes_.erase(ssrc);
-        permissions_.remove_user(ssrc);
+void SFU::invalidate_sender(uint32_t ssrc) {
+    dirty_fanout_.insert(ssrc);
+}
+
+// `ssrc` joined, left, moved or changed channel: every sender that could
+// list it as a destination needs a fresh list. Broadcast senders are
+// collected in one pass at the next publish, so a trunk event that touches
+// many receivers still walks the peers once.
+void SFU::invalidate_receiver(uint32_t ssrc) {
+    broadcast_fanout_dirty_ = true;
+    auto targeting = targeted_by_.find(ssrc);
+    if (targeting != targeted_by_.end()) {
+        dirty_fanout_.insert(targeting->second.begin(), targeting->second.end());
     }
 }
 
-void SFU::broadcast_user_list() {
-    std::vector<sockaddr_in> addrs;
-    {
-        std::lock_guard<std::mutex> lock(peers_mutex_);
-        for (auto& [_, peer] : peers_) {
-            if (!peer.has_control) continue;
-            addrs.push_back(peer.control_addr);
+void SFU::add_route_target(uint32_t sender, uint32_t target) {
+    routes_[sender].targets.insert(target);
+    targeted_by_[target].insert(sender);
+}
+
+void SFU::clear_route_targets(uint32_t sender) {
+    auto route = routes_.find(sender);
+    if (route == routes_.end()) {
+        return;
+    }
+    for (uint32_t target : route->second.targets) {
+        auto targeting = targeted_by_.find(target);
+        if (targeting != targeted_by_.end()) {
+            targeting->second.erase(sender);
+            if (targeting->second.empty()) {
+                targeted_by_.erase(targeting);
+            }
         }
     }
+    route->second.targets.clear();
+}
 
-    for (const auto& addr : addrs) {
-        send_user_list_to(addr);
+// Drops the endpoint/name index entries that point at the peer in `slot`.
+void SFU::unindex_control(uint32_t slot) {
+    const uint32_t ssrc = peers_.ssrc(slot);
+    const PeerColdData& cold = peers_.cold(slot);
+    auto by_endpoint = ssrc_by_control_endpoint_.find(endpoint_key(cold.control_addr));
+    if (by_endpoint != ssrc_by_control_endpoint_.end() && by_endpoint->second == ssrc) {
+        ssrc_by_control_endpoint_.erase(by_endpoint);
+    }
+    if (!cold.name.empty()) {
+        auto by_name = ssrc_by_name_.find(ascii_lower(cold.name));
+        if (by_name != ssrc_by_name_.end() && by_name->second == ssrc) {
+            ssrc_by_name_.erase(by_name);
+        }
     }
 }
 
-void SFU::send_user_list_to(const sockaddr_in& addr) {
-    std::vector<CtrlUserInfo> users;
-    {
-        std::lock_guard<std::mutex> lock(peers_mutex_);
-        for (auto& [ssrc, peer] : peers_) {
-            CtrlUserInfo info{};
-            info.ssrc = ssrc;
-            std::snprintf(info.name, sizeof(info.name), "%s", peer.name.c_str());
-            info.online = peer.has_control ? 1 : 0;
-            users.push_back(info);
+void SFU::remove_peer(uint32_t ssrc) {
+    const uint32_t slot = peers_.find(ssrc);
+    if (slot != PeerTable::kNoSlot) {
+        unindex_control(slot);
+    }
+    invalidate_receiver(ssrc);
+    invalidate_sender(ssrc);
+    clear_route_targets(ssrc);
+    peers_.erase(ssrc);
+    routes_.erase(ssrc);
+    permissions_.remove_user(ssrc);
+    speakers_.erase(ssrc);
+    gated_speakers_.erase(ssrc);
+    liveness_wheel_.cancel(ssrc);
+}
+
+// Joined peers live as long as they keep pinging; a peer known only from
+// its audio must JOIN, and keep sending, within PEER_TIMEOUT_MS.
+uint64_t SFU::liveness_deadline(uint32_t slot) const {
+    if (peers_.has_control(slot)) {
+        return peers_.last_control_ms(slot) + PEER_TIMEOUT_MS;
+    }
+    return std::min(peers_.cold(slot).join_ms, peers_.last_packet_ms(slot)) + PEER_TIMEOUT_MS;
+}
+
+void SFU::touch_control(uint32_t slot) {
+    peers_.last_control_ms(slot) = now_ms();
+    liveness_wheel_.arm(peers_.ssrc(slot), liveness_deadline(slot));
+}
+
+void SFU::expire_inactive_peers() {
+    uint64_t now = now_ms();
+    expired_peers_.clear();
+    if (liveness_wheel_.advance(now, expired_peers_) == 0) {
+        return;
+    }
+
+    // Fold in the latest liveness reports before judging staleness.
+    drain_media_events();
+
+    bool removed = false;
+    for (TimerWheel::Key key : expired_peers_) {
+        const uint32_t ssrc = static_cast<uint32_t>(key);
+        const uint32_t slot = peers_.find(ssrc);
+        if (slot == PeerTable::kNoSlot) {
+            continue;
+        }
+        // Traffic that did not re-arm the wheel (audio) only moves the
+        // deadline forward; push it out instead of dropping the peer.
+        const uint64_t deadline = liveness_deadline(slot);
+        if (deadline >= now) {
+            liveness_wheel_.arm(ssrc, deadline);
+            continue;
         }
+        std::cout << "[SFU] Removing inactive peer SSRC=" << ssrc << "\n";
+        remove_peer(ssrc);
+        queue_presence(CtrlPresenceOp::LEAVE, ssrc);
+        removed = true;
     }
+    if (removed) {
+        publish_routing();
+    }
+}
 
-    CtrlHeader hdr{};
-    hdr.type = CtrlType::USER_LIST;
-    hdr.size = static_cast<uint16_t>(sizeof(CtrlUserList) +
-                                     users.size() * sizeof(CtrlUserInfo));
+CtrlUserInfo SFU::user_info(uint32_t slot) const {
+    CtrlUserInfo info{};
+    info.ssrc = peers_.ssrc(slot);
+    std::snprintf(info.name, sizeof(info.name), "%s", peers_.cold(slot).name.c_str());
+    info.online = peers_.has_control(slot) ? 1 : 0;
+    return info;
+}
 
-    std::vector<uint8_t> pkt(sizeof(CtrlHeader) + hdr.size);
-    std::memcpy(pkt.data(), &hdr, sizeof(hdr));
+void SFU::queue_presence(CtrlPresenceOp op, uint32_t ssrc) {
+    CtrlUserChange change{};
+    change.op = op;
+    change.user.ssrc = ssrc;
+    const uint32_t slot = peers_.find(ssrc);
+    if (op != CtrlPresenceOp::LEAVE && slot != PeerTable::kNoSlot) {
+        change.user = user_info(slot);
+    }
 
-    CtrlUserList list{};
-    list.count = static_cast<uint32_t>(users.size());
-    std::memcpy(pkt.data() + sizeof(hdr), &list, sizeof(list));
-    if (!users.empty()) {
-        std::memcpy(pkt.data() + sizeof(hdr) + sizeof(list),
-                    users.data(),
-                    users.size() * sizeof(CtrlUserInfo));
+    // Only the latest state of each user matters; a JOIN followed by an
+    // UPDATE in the same window is still announced as a JOIN.
+    auto pending = pending_presence_index_.find(ssrc);
+    if (pending != pending_presence_index_.end()) {
+        CtrlUserChange& queued = pending_presence_[pending->second];
+        if (op == CtrlPresenceOp::UPDATE && queued.op == CtrlPresenceOp::JOIN) {
+            change.op = CtrlPresenceOp::JOIN;
+        }
+        queued = change;
+    } else {
+        pending_presence_index_.emplace(ssrc, pending_presence_.size());
+        pending_presence_.push_back(change);
+    }
+    if (!trunks_.empty()) {
+        pending_trunk_.insert(ssrc);
+    }
+    control_reactor_.arm_timer(presence_timer_, PRESENCE_COALESCE_MS);
+}
+
+void SFU::flush_presence() {
+    flush_trunk_changes();
+    if (pending_presence_.empty()) {
+        return;
     }
 
-    sendto(control_socket_, (const char*)pkt.data(), (int)pkt.size(), 0,
-           (sockaddr*)&addr, sizeof(addr));
+    std::vector<sockaddr_in> recipients;
+    for (uint32_t slot = 0; slot < peers_.size(); ++slot) {
+        if (peers_.has_control(slot) && !is_remote(slot)) {
+            recipients.push_back(peers_.cold(slot).control_addr);
+        }
+    }
+
+    constexpr size_t kPerDatagram =
+        (CTRL_MAX_DATAGRAM - sizeof(CtrlHeader) - sizeof(CtrlUserDelta)) / sizeof(CtrlUserChange);
+    std::vector<uint8_t> pkt;
+    for (size_t offset = 0; offset < pending_presence_.size(); offset += kPerDatagram) {
+        const size_t count = std::min(kPerDatagram, pending_presence_.size() - offset);
+
+        CtrlHeader hdr{};
+        hdr.type = CtrlType::USER_DELTA;
+        hdr.size = static_cast<uint16_t>(sizeof(CtrlUserDelta) + count * sizeof(CtrlUserChange));
+
+        CtrlUserDelta delta{};
+        delta.base_version = presence_version_;
+        delta.version = ++presence_version_;
+        delta.count = static_cast<uint16_t>(count);
+
+        pkt.resize(sizeof(hdr) + hdr.size);
+        std::memcpy(pkt.data(), &hdr, sizeof(hdr));
+        std::memcpy(pkt.data() + sizeof(hdr), &delta, sizeof(delta));
+        std::memcpy(pkt.data() + sizeof(hdr) + sizeof(delta),
+                    pending_presence_.data() + offset, count * sizeof(CtrlUserChange));
+
+        for (const sockaddr_in& addr : recipients) {
+            sendto(control_socket_, (const char*)pkt.data(), (int)pkt.size(), 0,
+                   (const sockaddr*)&addr, sizeof(addr));
+        }
+    }
+
+    std::cout << "[SFU] Presence v" << presence_version_ << ": " << pending_presence_.size()
+              << " change(s) to " << recipients.size() << " peer(s)\n";
+    pending_presence_.clear();
+    pending_presence_index_.clear();
+}
+
+void SFU::send_presence_snapshot_to(const sockaddr_in& addr) {
+    constexpr size_t kPerFragment =
+        (CTRL_MAX_DATAGRAM - sizeof(CtrlHeader) - sizeof(CtrlUserSnapshot)) / sizeof(CtrlUserInfo);
+    const size_t total = peers_.size();
+    const size_t fragments = std::max<size_t>(1, (total + kPerFragment - 1) / kPerFragment);
+
+    std::vector<uint8_t> pkt;
+    for (size_t fragment = 0; fragment < fragments; ++fragment) {
+        const size_t first = fragment * kPerFragment;
+        const size_t count = std::min(kPerFragment, total - std::min(total, first));
+
+        CtrlHeader hdr{};
+        hdr.type = CtrlType::USER_SNAPSHOT;
+        hdr.size = static_cast<uint16_t>(sizeof(CtrlUserSnapshot) + count * sizeof(CtrlUserInfo));
+
+        CtrlUserSnapshot snap{};
+        snap.version = presence_version_;
+        snap.total_users = static_cast<uint32_t>(total);
+        snap.fragment = static_cast<uint16_t>(fragment);
+        snap.fragment_count = static_cast<uint16_t>(fragments);
+        snap.count = static_cast<uint16_t>(count);
+
+        pkt.resize(sizeof(hdr) + hdr.size);
+        std::memcpy(pkt.data(), &hdr, sizeof(hdr));
+        std::memcpy(pkt.data() + sizeof(hdr), &snap, sizeof(snap));
+        uint8_t* p = pkt.data() + sizeof(hdr) + sizeof(snap);
+        for (size_t i = 0; i < count; ++i) {
+            const CtrlUserInfo info = user_info(static_cast<uint32_t>(first + i));
+            std::memcpy(p, &info, sizeof(info));
+            p += sizeof(info);
+        }
+
+        sendto(control_socket_, (const char*)pkt.data(), (int)pkt.size(), 0,
+               (const sockaddr*)&addr, sizeof(addr));
+    }
 }
 
-void SFU::broadcast_talk_update(uint32_t from, const std::set<uint32_t>& targets) {
+void SFU::send_talk_update(uint32_t from, const std::set<uint32_t>& targets,
+                           const std::set<uint32_t>& recipients) {
     CtrlHeader hdr{};
     hdr.type = CtrlType::TALK;
     hdr.size = static_cast<uint16_t>(sizeof(CtrlTalk) + targets.size() * sizeof(uint32_t));
@@ -286,398 +889,1260 @@ void SFU::broadcast_talk_update(uint32_t from, const std::set<uint32_t>& targets
         }
     }
 
-    std::vector<sockaddr_in> addrs;
-    {
-        std::lock_guard<std::mutex> lock(peers_mutex_);
-        for (const auto& [_, peer] : peers_) {
-            if (!peer.has_control) continue;
-            addrs.push_back(peer.control_addr);
+    for (uint32_t ssrc : recipients) {
+        const uint32_t slot = peers_.find(ssrc);
+        if (slot == PeerTable::kNoSlot || !peers_.has_control(slot) || is_remote(slot)) continue;
+        const sockaddr_in& addr = peers_.cold(slot).control_addr;
+        sendto(control_socket_, (const char*)pkt.data(), (int)pkt.size(), 0,
+               (const sockaddr*)&addr, sizeof(addr));
+    }
+}
+
+void SFU::media_worker_loop(MediaWorker& worker) {
+    if (options_.pin_workers) {
+        if (!sfushard::pin_current_thread(worker.index)) {
+            std::cerr << "[SFU] Could not pin media worker " << worker.index << "\n";
         }
     }
 
-    for (const auto& addr : addrs) {
-        sendto(control_socket_, (const char*)pkt.data(), (int)pkt.size(), 0,
-               (sockaddr*)&addr, sizeof(addr));
+    BatchReceiver rx(options_.io_batch, RECV_BUFFER_SIZE);
+    // Every received datagram can fan out to each other peer.
+    BatchSender tx(options_.io_batch * MAX_PEERS);
+    ShardState shard;
+    EgressPacer pacer(pacer_options());
+
+    std::unique_ptr<UringMediaIo> uring;
+    if (options_.io_uring) {
+        uring = std::make_unique<UringMediaIo>(options_.io_batch, options_.io_batch * MAX_PEERS,
+                                               URING_RECV_BUFFERS, RECV_BUFFER_SIZE + URING_RECV_HEADROOM);
+        std::string error;
+        if (!uring->open(worker.socket, error)) {
+            std::cerr << "[SFU] io_uring unavailable on media worker " << worker.index
+                      << " (" << error << "), using recvmmsg\n";
+            uring.reset();
+        }
     }
-}
-void SFU::audio_loop() {
-    uint8_t buffer[RECV_BUFFER_SIZE];
-    sockaddr_in sender{};
-    socklen_t sender_len = sizeof(sender);
-    uint64_t forwarded_packets = 0;
-    uint64_t dropped_no_target = 0;
-    uint64_t dropped_truncated = 0;
-    std::unordered_map<uint32_t, uint64_t> recv_audio_by_ssrc;
 
-    std::cout << "[SFU] Audio forwarding loop started\n";
+    if (uring) {
+        if (options_.udp_gro) {
+            std::cerr << "[SFU] UDP_GRO is not used on the io_uring path\n";
+        }
+        worker.reactor.add_socket(uring->fd(), [&]() { drain_uring(worker, *uring, shard, pacer); });
+        if (pacer.enabled()) {
+            worker.reactor.add_timer(PACER_TICK_MS, [&]() {
+                pacer.release(steady_us(), [&](const sockaddr_in& to, const uint8_t* data, size_t len) {
+                    uring->queue(worker.socket, data, static_cast<int>(len), to);
+                });
+                uring->flush(worker.socket);
+                report_pacer(worker, pacer);
+            });
+        }
+        worker.reactor.add_timer(IO_STATS_INTERVAL_MS, [&]() {
+            report_io_stats(worker, "io_uring", uring->rx_stats(), uring->tx_stats());
+        });
+    } else {
+        if (options_.udp_gro) {
+            if (rx.enable_gro(worker.socket)) {
+                std::cout << "[SFU] UDP_GRO enabled on media worker " << worker.index << "\n";
+            } else {
+                std::cerr << "[SFU] UDP_GRO unavailable, continuing without it\n";
+            }
+        }
+        worker.reactor.add_socket(worker.socket, [&]() { drain_media_socket(worker, rx, tx, shard, pacer); });
+        if (pacer.enabled()) {
+            worker.reactor.add_timer(PACER_TICK_MS, [&]() {
+                pacer.release(steady_us(), [&](const sockaddr_in& to, const uint8_t* data, size_t len) {
+                    tx.queue(worker.socket, data, static_cast<int>(len), to);
+                });
+                tx.flush(worker.socket);
+                report_pacer(worker, pacer);
+            });
+        }
+        worker.reactor.add_timer(IO_STATS_INTERVAL_MS, [&]() {
+            report_io_stats(worker, "mmsg", rx.stats(), tx.stats());
+        });
+    }
+    worker.reactor.add_timer(LIVENESS_FLUSH_INTERVAL_MS, [&]() { flush_shard_liveness(worker, shard); });
+
+    std::cout << "[SFU] Media worker " << worker.index
+              << " started (batch=" << options_.io_batch
+              << (uring ? ", io_uring" : "") << ")\n";
 
     while (running_) {
-        // Receive packet
-        int recv_len = recvfrom(audio_socket_, (char*)buffer, RECV_BUFFER_SIZE, 0,
-                               (sockaddr*)&sender, &sender_len);
+        worker.reactor.run_once();
+    }
 
-        if (recv_len > 0) {
-            const int header_size = static_cast<int>(offsetof(AudioPacket, payload));
-            if (recv_len < header_size) {
-                continue;
-            }
+    std::cout << "[SFU] Media worker " << worker.index << " stopped\n";
+}
+
+const RoutingView& SFU::refresh_view(MediaWorker& worker) {
+    // Steady state is one atomic integer load; the snapshot pointer itself
+    // is only re-read after the control thread has published a new one.
+    const uint64_t version = routing_version_.load(std::memory_order_acquire);
+    if (version != worker.view_version || !worker.view) {
+        worker.view = std::atomic_load(&routing_view_);
+        worker.view_version = version;
+    }
+    return *worker.view;
+}
+
+bool SFU::post_media_event(MediaWorker& worker, const MediaEvent& event) {
+    if (!worker.events.try_push(event)) {
+        return false;
+    }
+    control_reactor_.wake();
+    return true;
+}
 
-            AudioPacket hdr{};
-            std::memcpy(&hdr, buffer, header_size);
-            const uint32_t sender_ssrc = hdr.ssrc;
-            const uint16_t payload_len = hdr.payload_len;
-            if (payload_len > OPUS_MAX_PAYLOAD || recv_len < header_size + payload_len) {
-                ++dropped_truncated;
-                if ((dropped_truncated % 100) == 1) {
-                    std::cerr << "[SFU] Drop malformed audio packet: recv_len=" << recv_len
-                              << " payload_len=" << payload_len << "\n";
+void SFU::drain_media_socket(MediaWorker& worker, BatchReceiver& rx, BatchSender& tx, ShardState& shard,
+                             EgressPacer& pacer) {
+    // Bounded so a flood cannot starve the timers; the level-triggered
+    // reactor calls back immediately if datagrams remain.
+    for (int round = 0; round < MAX_DRAIN_ROUNDS; ++round) {
+        const int received = rx.receive(worker.socket);
+        if (received == 0) {
+            return;
+        }
+        const uint64_t start_us = steady_us();
+        const uint64_t now = start_us / 1000;
+        const RoutingView& view = refresh_view(worker);
+        for (int i = 0; i < received; ++i) {
+            const Datagram& dgram = rx.datagram(i);
+            EgressClass egress = EgressClass::Voice;
+            if (const FanOutList* fanout = handle_audio_datagram(worker, view, dgram, now, shard, egress)) {
+                for (const sockaddr_in& dest : *fanout) {
+                    if (!pacer.enabled() || pacer.admit(dest, egress, dgram.data, static_cast<size_t>(dgram.len),
+                                                        start_us) == EgressPacer::Verdict::Send) {
+                        tx.queue(worker.socket, dgram.data, dgram.len, dest);
+                    }
                 }
-                continue;
             }
+        }
+        if (pacer.enabled()) {
+            pacer.release(start_us, [&](const sockaddr_in& to, const uint8_t* data, size_t len) {
+                tx.queue(worker.socket, data, static_cast<int>(len), to);
+            });
+            report_pacer(worker, pacer);
+        }
+        // Fan-out copies reference the receive slots, so they must leave
+        // before the next receive() reuses them.
+        tx.flush(worker.socket);
+        worker.metrics->set(sfumetrics::Counter::TxErrors, tx.stats().send_errors);
+        worker.metrics->observe(sfumetrics::Histogram::BatchLatencyUs, steady_us() - start_us);
+    }
+}
 
-            // Register/update sender
-            {
-                std::lock_guard<std::mutex> lock(peers_mutex_);
-                
-                auto it = peers_.find(sender_ssrc);
-                if (it == peers_.end()) {
-                    std::cout << "[SFU] New peer: SSRC=" << sender_ssrc 
-                              << " IP=" << inet_ntoa(sender.sin_addr) 
-                              << ":" << ntohs(sender.sin_port) << "\n";
+void SFU::drain_uring(MediaWorker& worker, UringMediaIo& io, ShardState& shard, EgressPacer& pacer) {
+    // Same shape as drain_media_socket(), but receive() only reaps the
+    // completion ring and each batch's copies go out in one io_uring_enter.
+    // A reaped backlog is always finished: nothing would wake us for it.
+    for (int round = 0; round < MAX_DRAIN_ROUNDS || io.backlogged(); ++round) {
+        const int received = io.receive();
+        if (received == 0) {
+            return;
+        }
+        const uint64_t start_us = steady_us();
+        const uint64_t now = start_us / 1000;
+        const RoutingView& view = refresh_view(worker);
+        for (int i = 0; i < received; ++i) {
+            const Datagram& dgram = io.datagram(i);
+            EgressClass egress = EgressClass::Voice;
+            if (const FanOutList* fanout = handle_audio_datagram(worker, view, dgram, now, shard, egress)) {
+                for (const sockaddr_in& dest : *fanout) {
+                    if (!pacer.enabled() || pacer.admit(dest, egress, dgram.data, static_cast<size_t>(dgram.len),
+                                                        start_us) == EgressPacer::Verdict::Send) {
+                        io.queue(worker.socket, dgram.data, dgram.len, dest);
+                    }
                 }
+            }
+        }
+        if (pacer.enabled()) {
+            // Paced copies live in the pacer, not the buffer ring, so they
+            // go out as plain sends.
+            pacer.release(start_us, [&](const sockaddr_in& to, const uint8_t* data, size_t len) {
+                io.queue(worker.socket, data, static_cast<int>(len), to);
+            });
+            report_pacer(worker, pacer);
+        }
+        io.flush(worker.socket);
+        worker.metrics->set(sfumetrics::Counter::TxErrors, io.tx_stats().send_errors);
+        worker.metrics->observe(sfumetrics::Histogram::BatchLatencyUs, steady_us() - start_us);
+    }
+}
 
-                auto& peer = peers_[sender_ssrc];
-                peer.addr = sender;
-                peer.ssrc = sender_ssrc;
-                peer.last_packet_ms = now_ms();
+void SFU::learn_audio_endpoint(uint32_t ssrc, const sockaddr_in& addr, uint64_t now) {
+    const bool is_new = !peers_.contains(ssrc);
+    if (is_new) {
+        VOIP_LOG_INFO("SFU", "new peer", {{"ssrc", ssrc},
+                                          {"ip", inet_ntoa(addr.sin_addr)},
+                                          {"port", ntohs(addr.sin_port)}});
+        // Broadcast fan-out only visits users the permission bitsets know.
+        permissions_.add_user(ssrc);
+    }
 
-                if (!peer.has_control) {
-                    // Strict mode: cache audio endpoint, but do not forward until JOIN+PING.
-                    continue;
-                }
-            }
+    const uint32_t slot = peers_.insert(ssrc);
+    peers_.addr(slot) = addr;
+    peers_.last_packet_ms(slot) = std::max(peers_.last_packet_ms(slot), now);
+    if (is_new) {
+        // Start the window this peer has to JOIN in.
+        peers_.cold(slot).join_ms = now;
+        liveness_wheel_.arm(ssrc, liveness_deadline(slot));
+    }
+    invalidate_sender(ssrc);
+    invalidate_receiver(ssrc);
+}
 
-            // Keepalive/probe packets are used to learn the audio endpoint.
-            // They should not be forwarded as media.
-            if (payload_len == 0) {
-                continue;
-            }
+// Returns the destinations this datagram should be copied to, or null.
+const FanOutList* SFU::handle_audio_datagram(MediaWorker& worker, const RoutingView& view,
+                                             const Datagram& dgram, uint64_t now, ShardState& shard,
+                                             EgressClass& egress) {
+    const uint8_t* buffer = dgram.data;
+    const int recv_len = dgram.len;
+    const sockaddr_in& sender = dgram.from;
+    sfumetrics::MetricsShard& metrics = *worker.metrics;
+    metrics.add(sfumetrics::Counter::RxPackets);
+    metrics.add(sfumetrics::Counter::RxBytes, static_cast<uint64_t>(recv_len));
+
+    const int header_size = static_cast<int>(offsetof(AudioPacket, payload));
+    if (recv_len < header_size) {
+        metrics.add(sfumetrics::Counter::DropMalformed);
+        return nullptr;
+    }
 
-            uint64_t& recv_count = recv_audio_by_ssrc[sender_ssrc];
-            ++recv_count;
-            if ((recv_count % 100) == 1) {
-                std::cout << "[SFU] Audio in: SSRC=" << sender_ssrc
-                          << " payload=" << payload_len
-                          << " recv_count=" << recv_count << "\n";
-            }
+    AudioPacket hdr{};
+    std::memcpy(&hdr, buffer, header_size);
+    const uint32_t sender_ssrc = hdr.ssrc;
+    const uint16_t payload_len = hdr.payload_len;
+    if (payload_len > OPUS_MAX_PAYLOAD || recv_len < header_size + payload_len) {
+        metrics.add(sfumetrics::Counter::DropMalformed);
+        VOIP_LOG_WARN_RATE(1, "SFU", "drop malformed audio packet", {{"recv_len", recv_len},
+                                                                     {"payload_len", payload_len}});
+        return nullptr;
+    }
 
-            // Forward based on routing table
-            {
-                std::lock_guard<std::mutex> lock(peers_mutex_);
+    SenderState& sender_state = shard.senders[sender_ssrc];
+    sender_state.last_packet_ms = now;
+    ++sender_state.rx_packets;
+    sender_state.rx_bytes += static_cast<uint64_t>(recv_len);
+
+    // Register/update sender. Only a new or moved endpoint needs the control
+    // thread, and it is told once per change rather than waited on.
+    const uint32_t self = view.index.find(sender_ssrc);
+    if (self != SsrcIndex::kNoSlot && same_endpoint(view.addrs[self], sender)) {
+        sender_state.endpoint_reported = false;
+    } else if ((!sender_state.endpoint_reported || !same_endpoint(sender_state.reported_addr, sender)) &&
+               !is_trunk_endpoint(view, sender)) {
+        // Relayed audio for a user the trunk has not announced yet is
+        // dropped below, never mistaken for a client.
+        MediaEvent event;
+        event.kind = MediaEvent::Kind::Endpoint;
+        event.ssrc = sender_ssrc;
+        event.addr = sender;
+        event.last_packet_ms = now;
+        if (post_media_event(worker, event)) {
+            sender_state.endpoint_reported = true;
+            sender_state.reported_addr = sender;
+        }
+    }
 
-                if (peers_.size() < 2) {
-                    // Need at least 2 active peers to forward
-                    continue;
-                }
+    if (self == SsrcIndex::kNoSlot || !view.has_control[self]) {
+        // Strict mode: cache audio endpoint, but do not forward until JOIN+PING.
+        metrics.add(sfumetrics::Counter::DropNotJoined);
+        return nullptr;
+    }
 
-                auto route_it = routes_.find(sender_ssrc);
-                bool broadcast = true;
-                std::set<uint32_t> targets;
-                if (route_it != routes_.end()) {
-                    broadcast = route_it->second.broadcast;
-                    targets = route_it->second.targets;
-                }
+    // Keepalive/probe packets are used to learn the audio endpoint.
+    // They should not be forwarded as media.
+    if (payload_len == 0) {
+        metrics.add(sfumetrics::Counter::DropKeepalive);
+        return nullptr;
+    }
 
-                int forwarded_this_packet = 0;
-                if (broadcast || targets.empty()) {
-                    for (auto& [other_ssrc, other_peer] : peers_) {
-                        if (other_ssrc != sender_ssrc) {
-                            if (!has_audio_endpoint(other_peer)) {
-                                continue;
-                            }
-                            if (!permissions_.can_receive(other_ssrc, sender_ssrc)) {
-                                continue;
-                            }
-                            int sent = sendto(audio_socket_, (const char*)buffer, recv_len, 0,
-                                              (sockaddr*)&other_peer.addr, sender_len);
-                            if (sent == SOCKET_ERROR) {
-                                std::cerr << "[SFU] Forward failed\n";
-                            } else {
-                                ++forwarded_this_packet;
-                            }
-                        }
-                    }
-                } else {
-                    for (uint32_t target : targets) {
-                        auto it = peers_.find(target);
-                        if (it == peers_.end()) continue;
-                        if (!has_audio_endpoint(it->second)) {
-                            continue;
-                        }
-                        if (!permissions_.can_receive(target, sender_ssrc)) {
-                            continue;
-                        }
-                        int sent = sendto(audio_socket_, (const char*)buffer, recv_len, 0,
-                                          (sockaddr*)&it->second.addr, sender_len);
-                        if (sent == SOCKET_ERROR) {
-                            std::cerr << "[SFU] Forward failed\n";
-                        } else {
-                            ++forwarded_this_packet;
-                        }
-                    }
-                }
+    ++sender_state.recv_count;
+    if (hdr.flags & AUDIO_FLAG_AUDIO_LEVEL) {
+        track_audio_level(worker, sender_state, sender_ssrc, hdr.audio_level, now);
+    }
+    // Levels are tracked even while gated, so a sender can win its way back.
+    if (view.speaker_gated[self]) {
+        metrics.add(sfumetrics::Counter::DropNotSelected);
+        return nullptr;
+    }
+    if (view.talk_route[self]) {
+        egress = EgressClass::Talk;
+    } else if ((hdr.flags & AUDIO_FLAG_AUDIO_LEVEL) && !(hdr.audio_level & AUDIO_LEVEL_VOICE)) {
+        egress = EgressClass::Background;
+    } else {
+        egress = EgressClass::Voice;
+    }
+    VOIP_LOG_DEBUG_RATE(1, "SFU", "audio in", {{"ssrc", sender_ssrc},
+                                               {"worker", worker.index},
+                                               {"payload", payload_len},
+                                               {"recv_count", sender_state.recv_count}});
+
+    // Forward based on routing table
+    if (view.size() < 2) {
+        // Need at least 2 active peers to forward
+        metrics.add(sfumetrics::Counter::DropNoTarget);
+        metrics.observe(sfumetrics::Histogram::FanOut, 0);
+        return nullptr;
+    }
 
-                if (forwarded_this_packet == 0) {
-                    ++dropped_no_target;
-                    if ((dropped_no_target % 100) == 1) {
-                        std::cout << "[SFU] Audio drop: no eligible target for SSRC="
-                                  << sender_ssrc << " peers=" << peers_.size() << "\n";
-                    }
-                } else {
-                    ++forwarded_packets;
-                    if ((forwarded_packets % 100) == 1) {
-                        std::cout << "[SFU] Audio forwarded: from=" << sender_ssrc
-                                  << " copies=" << forwarded_this_packet
-                                  << " total_forwarded=" << forwarded_packets << "\n";
-                    }
-                }
+    // Route and permissions were resolved when the snapshot was built.
+    const FanOutList* fanout = view.fanouts[self].get();
+    const int forwarded_this_packet = fanout ? static_cast<int>(fanout->size()) : 0;
+    metrics.observe(sfumetrics::Histogram::FanOut, static_cast<uint64_t>(forwarded_this_packet));
+
+    if (forwarded_this_packet == 0) {
+        metrics.add(sfumetrics::Counter::DropNoTarget);
+        VOIP_LOG_INFO_RATE(1, "SFU", "audio drop: no eligible target", {{"ssrc", sender_ssrc},
+                                                                        {"peers", view.size()}});
+    } else {
+        metrics.add(sfumetrics::Counter::TxBytes, static_cast<uint64_t>(recv_len) * forwarded_this_packet);
+        const uint64_t forwarded = metrics.add(sfumetrics::Counter::TxPackets, forwarded_this_packet);
+        VOIP_LOG_DEBUG_RATE(1, "SFU", "audio forwarded", {{"from", sender_ssrc},
+                                                          {"copies", forwarded_this_packet},
+                                                          {"worker", worker.index},
+                                                          {"total_copies", forwarded}});
+    }
+    return forwarded_this_packet > 0 ? fanout : nullptr;
+}
+
+// The budget is per receiver, but each worker paces only the copies it
+// sends, so every worker gets its share of it.
+PacerOptions SFU::pacer_options() const {
+    PacerOptions pacer;
+    if (options_.pace_kbps == 0) {
+        return pacer;
+    }
+    const uint64_t rate = static_cast<uint64_t>(options_.pace_kbps) * 1000 / 8;
+    pacer.rate_bytes_per_s = std::max<uint64_t>(1, rate / std::max<size_t>(1, workers_.size()));
+    pacer.burst_bytes = static_cast<uint32_t>(
+        std::max<uint64_t>(PACER_MIN_BURST_BYTES, pacer.rate_bytes_per_s * options_.pace_burst_ms / 1000));
+    pacer.queue_limit = options_.pace_queue;
+    return pacer;
+}
+
+void SFU::report_pacer(MediaWorker& worker, const EgressPacer& pacer) {
+    worker.metrics->set(sfumetrics::Counter::TxDelayed, pacer.delayed());
+    worker.metrics->set(sfumetrics::Counter::DropPaced, pacer.dropped());
+    worker.egress_depth.store(pacer.depth(), std::memory_order_relaxed);
+}
+
+void SFU::flush_shard_liveness(MediaWorker& worker, ShardState& shard) {
+    if (shard.senders.empty()) {
+        return;
+    }
+    // One report per sender per second instead of one per packet.
+    const RoutingView& view = refresh_view(worker);
+    auto totals = std::make_shared<sfumetrics::SsrcSnapshot>();
+    totals->reserve(shard.senders.size());
+    bool posted = false;
+    for (auto it = shard.senders.begin(); it != shard.senders.end();) {
+        if (!it->second.endpoint_reported && view.index.find(it->first) == SsrcIndex::kNoSlot) {
+            it = shard.senders.erase(it);
+            continue;
+        }
+        totals->push_back(sfumetrics::SsrcTotals{it->first, it->second.rx_packets, it->second.rx_bytes});
+        MediaEvent event;
+        event.kind = MediaEvent::Kind::Liveness;
+        event.ssrc = it->first;
+        event.last_packet_ms = it->second.last_packet_ms;
+        // A full ring just delays this report to the next flush.
+        posted = worker.events.try_push(event) || posted;
+        ++it;
+    }
+    worker.metrics->publish_ssrc(std::move(totals));
+    if (posted) {
+        control_reactor_.wake();
+    }
+}
+
+// Reports a sender's level to the control thread at most every
+// SPEAKER_REPORT_MS: while it is voiced (to keep its hold alive), when it
+// stops, when the smoothed level moves by SPEAKER_LEVEL_STEP_DB, and every
+// SPEAKER_REFRESH_MS regardless.
+void SFU::track_audio_level(MediaWorker& worker, SenderState& state, uint32_t ssrc, uint8_t audio_level,
+                            uint64_t now) {
+    const bool voiced = (audio_level & AUDIO_LEVEL_VOICE) != 0;
+    const float level = static_cast<float>(audio_level & AUDIO_LEVEL_MASK);
+    if (!state.has_level) {
+        state.level_dbov = level;
+        state.has_level = true;
+    } else {
+        state.level_dbov += (level - state.level_dbov) * SPEAKER_LEVEL_SMOOTHING;
+    }
+    if (voiced) {
+        state.last_voice_ms = now;
+    }
+
+    if (now - state.level_reported_ms < SPEAKER_REPORT_MS) {
+        return;
+    }
+    const uint8_t rounded = static_cast<uint8_t>(state.level_dbov + 0.5f);
+    const int moved = std::abs(static_cast<int>(rounded) - static_cast<int>(state.reported_level));
+    if (!voiced && voiced == state.reported_voice && moved < SPEAKER_LEVEL_STEP_DB &&
+        now - state.level_reported_ms < SPEAKER_REFRESH_MS) {
+        return;
+    }
+    MediaEvent event;
+    event.kind = MediaEvent::Kind::Speaker;
+    event.ssrc = ssrc;
+    event.last_packet_ms = now;
+    event.last_voice_ms = state.last_voice_ms;
+    event.level_dbov = rounded;
+    // A full ring just delays this report to the next packet.
+    if (post_media_event(worker, event)) {
+        state.level_reported_ms = now;
+        state.reported_level = rounded;
+        state.reported_voice = voiced;
+    }
+}
+
+void SFU::drain_media_events() {
+    bool changed = false;
+    MediaEvent event;
+    for (auto& worker : workers_) {
+        while (worker->events.try_pop(event)) {
+            if (event.kind == MediaEvent::Kind::Endpoint) {
+                learn_audio_endpoint(event.ssrc, event.addr, event.last_packet_ms);
+                changed = true;
+                continue;
             }
+            if (event.kind == MediaEvent::Kind::Speaker) {
+                SpeakerInfo& speaker = speakers_[event.ssrc];
+                speaker.level_dbov = event.level_dbov;
+                speaker.last_voice_ms = std::max(speaker.last_voice_ms, event.last_voice_ms);
+                speaker.updated_ms = event.last_packet_ms;
+                continue;
+            }
+            const uint32_t slot = peers_.find(event.ssrc);
+            if (slot != PeerTable::kNoSlot) {
+                peers_.last_packet_ms(slot) = std::max(peers_.last_packet_ms(slot), event.last_packet_ms);
+            }
+        }
+    }
+    if (changed) {
+        publish_routing();
+    }
+}
+
+// Keeps the `max_speakers` best broadcast senders of each channel flowing
+// and gates the rest: senders voiced within SPEAKER_HOLD_MS first, then the
+// loudest, then the most recently voiced. Senders that never sent a level,
+// and talkers with explicit TALK targets, are never gated.
+void SFU::select_speakers() {
+    const uint64_t now = now_ms();
+    struct Candidate {
+        uint32_t channel;
+        bool held;
+        uint8_t level_dbov;
+        uint64_t last_voice_ms;
+        uint32_t ssrc;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(speakers_.size());
+    for (auto it = speakers_.begin(); it != speakers_.end();) {
+        if (!peers_.contains(it->first)) {
+            it = speakers_.erase(it);
+            continue;
         }
+        const SpeakerInfo& speaker = it->second;
+        auto route = routes_.find(it->first);
+        const bool broadcast = route == routes_.end() || route->second.broadcast || route->second.targets.empty();
+        if (broadcast && now - speaker.updated_ms <= SPEAKER_STALE_MS) {
+            candidates.push_back(Candidate{permissions_.channel_of(it->first),
+                                           now - speaker.last_voice_ms <= SPEAKER_HOLD_MS,
+                                           speaker.level_dbov, speaker.last_voice_ms, it->first});
+        }
+        ++it;
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        if (a.channel != b.channel) return a.channel < b.channel;
+        if (a.held != b.held) return a.held;
+        if (a.level_dbov != b.level_dbov) return a.level_dbov < b.level_dbov;
+        if (a.last_voice_ms != b.last_voice_ms) return a.last_voice_ms > b.last_voice_ms;
+        return a.ssrc < b.ssrc;
+    });
 
-        // Periodic cleanup
-        static uint64_t last_cleanup = 0;
-        uint64_t now = now_ms();
-        if (now - last_cleanup > 5000) {  // Every 5 seconds
-            cleanup_inactive_peers();
-            last_cleanup = now;
+    std::unordered_set<uint32_t> gated;
+    size_t rank = 0;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        rank = (i > 0 && candidates[i].channel == candidates[i - 1].channel) ? rank + 1 : 0;
+        if (rank >= options_.max_speakers) {
+            gated.insert(candidates[i].ssrc);
+        }
+    }
+    if (gated != gated_speakers_) {
+        gated_speakers_ = std::move(gated);
+        publish_routing();
+    }
+}
+
+// Scrapes are answered on the control thread, so gauges may read control
+// state directly; worker shards are only ever read.
+void SFU::register_metrics() {
+    metrics_.add_gauge("sfu_peers", "Peers known to the SFU",
+                       [this]() { return static_cast<double>(peers_.size()); });
+    metrics_.add_gauge("sfu_presence_version", "Latest presence delta version",
+                       [this]() { return static_cast<double>(presence_version_); });
+    metrics_.add_gauge("sfu_media_workers", "Media worker threads",
+                       [this]() { return static_cast<double>(workers_.size()); });
+    metrics_.add_gauge("sfu_egress_queue_packets", "Audio copies waiting in egress pacing queues", [this]() {
+        uint64_t depth = 0;
+        for (const auto& worker : workers_) {
+            depth += worker->egress_depth.load(std::memory_order_relaxed);
+        }
+        return static_cast<double>(depth);
+    });
+    metrics_.add_gauge("sfu_trunks_up", "Trunks to other SFU nodes currently heard from", [this]() {
+        return static_cast<double>(std::count_if(trunks_.begin(), trunks_.end(),
+                                                 [](const TrunkLink& trunk) { return trunk.up(); }));
+    });
+    metrics_.add_gauge("sfu_remote_peers", "Peers attached to other SFU nodes", [this]() {
+        size_t remote = 0;
+        for (uint32_t slot = 0; slot < peers_.size(); ++slot) {
+            remote += is_remote(slot) ? 1 : 0;
         }
+        return static_cast<double>(remote);
+    });
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    // An endpoint handed over by the previous process is kept as is.
+    if (metrics_endpoint_.socket() != INVALID_SOCKET) {
+        metrics_endpoint_.attach(control_reactor_, [this]() { return metrics_.render(); });
+        return;
+    }
+    if (options_.metrics_port == 0) {
+        return;
     }
+    if (!metrics_endpoint_.open(options_.metrics_port)) {
+        std::cerr << "[SFU] Metrics endpoint bind failed on 127.0.0.1:" << options_.metrics_port << "\n";
+        return;
+    }
+    metrics_endpoint_.attach(control_reactor_, [this]() { return metrics_.render(); });
+    std::cout << "[SFU] Metrics on http://127.0.0.1:" << options_.metrics_port << "/metrics\n";
+}
 
-    std::cout << "[SFU] Audio loop stopped\n";
+// On the io_uring path rx "calls" are completion-ring reaps (no syscall)
+// and tx calls are io_uring_enter submissions.
+void SFU::report_io_stats(const MediaWorker& worker, const char* backend,
+                          const BatchIoStats& in, const BatchIoStats& out) {
+    if (in.recv_calls == 0) {
+        return;
+    }
+    const double rx_per_call = static_cast<double>(in.recv_packets) / in.recv_calls;
+    const double tx_per_call = out.send_calls ? static_cast<double>(out.send_packets) / out.send_calls : 0.0;
+    std::cout << "[SFU] I/O worker " << worker.index << " (" << backend << "): rx " << in.recv_packets << " pkts / " << in.recv_calls
+              << " calls (" << rx_per_call << " pkts/call), tx " << out.send_packets
+              << " pkts / " << out.send_calls << " calls (" << tx_per_call
+              << " pkts/call), tx errors " << out.send_errors << "\n";
 }
 
 void SFU::control_loop() {
+    std::cout << "[SFU] Control loop started\n";
+
+    while (running_) {
+        control_reactor_.run_once();
+    }
+
+    std::cout << "[SFU] Control loop stopped\n";
+}
+
+void SFU::drain_control_socket() {
     uint8_t buffer[2048];
     sockaddr_in sender{};
-    socklen_t sender_len = sizeof(sender);
-
-    std::cout << "[SFU] Control loop started\n";
 
     while (running_) {
+        socklen_t sender_len = sizeof(sender);
         int recv_len = recvfrom(control_socket_, (char*)buffer, sizeof(buffer), 0,
                                (sockaddr*)&sender, &sender_len);
+        if (recv_len < 0) {
+            return;
+        }
         if (recv_len < (int)sizeof(CtrlHeader)) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(1));
             continue;
         }
+        handle_control_message(buffer, recv_len, sender);
+    }
+}
 
-        CtrlHeader hdr{};
-        std::memcpy(&hdr, buffer, sizeof(hdr));
-
-        if (hdr.type == CtrlType::PING) {
-            bool promoted = false;
-            {
-                std::lock_guard<std::mutex> lock(peers_mutex_);
-                // Update last control on any ping from known sender
-                for (auto& [ssrc, peer] : peers_) {
-                    if (peer.has_control &&
-                        peer.control_addr.sin_addr.s_addr == sender.sin_addr.s_addr &&
-                        peer.control_addr.sin_port == sender.sin_port) {
-                        peer.last_control_ms = now_ms();
-                        break;
-                    }
-                }
+void SFU::handle_control_message(const uint8_t* buffer, int recv_len, const sockaddr_in& sender) {
+    CtrlHeader hdr{};
+    std::memcpy(&hdr, buffer, sizeof(hdr));
+
+    if (hdr.type == CtrlType::PING) {
+        bool promoted = false;
+        auto known = ssrc_by_control_endpoint_.find(endpoint_key(sender));
+        const uint32_t slot = (known != ssrc_by_control_endpoint_.end())
+                                  ? peers_.find(known->second)
+                                  : PeerTable::kNoSlot;
+        if (slot != PeerTable::kNoSlot) {
+            // Strict mode: promote pending JOIN to active on first PING
+            if (!peers_.has_control(slot)) {
+                peers_.set_has_control(slot, true);
+                promoted = true;
+            }
+            // Update last control on any ping from known sender
+            touch_control(slot);
+        }
+        if (promoted) {
+            publish_routing();
+        }
+        uint8_t pong[sizeof(CtrlHeader) + sizeof(CtrlPong)];
+        const CtrlHeader pong_hdr{CtrlType::PONG, sizeof(CtrlPong)};
+        const CtrlPong pong_body{presence_version_};
+        std::memcpy(pong, &pong_hdr, sizeof(pong_hdr));
+        std::memcpy(pong + sizeof(pong_hdr), &pong_body, sizeof(pong_body));
+        sendto(control_socket_, (const char*)pong, sizeof(pong), 0,
+               (const sockaddr*)&sender, sizeof(sender));
+        VOIP_LOG_DEBUG_RATE(1, "SFU", "pong", {{"ip", inet_ntoa(sender.sin_addr)},
+                                               {"port", ntohs(sender.sin_port)},
+                                               {"promoted", promoted}});
+        if (promoted) {
+            queue_presence(CtrlPresenceOp::UPDATE, known->second);
+        }
+        return;
+    }
 
-                // Strict mode: promote pending JOIN to active on first PING
-                for (auto& [ssrc, peer] : peers_) {
-                    if (!peer.has_control &&
-                        peer.control_addr.sin_addr.s_addr == sender.sin_addr.s_addr &&
-                        peer.control_addr.sin_port == sender.sin_port) {
-                        peer.has_control = true;
-                        peer.last_control_ms = now_ms();
-                        promoted = true;
-                        break;
-                    }
+    if (hdr.type == CtrlType::JOIN && hdr.size == sizeof(CtrlJoin)) {
+        CtrlJoin join{};
+        std::memcpy(&join, buffer + sizeof(hdr), sizeof(join));
+
+        bool duplicate_name = false;
+        {
+            const std::string name(join.name, strnlen(join.name, sizeof(join.name)));
+            const std::string wanted = ascii_lower(name);
+            auto owner = ssrc_by_name_.find(wanted);
+            duplicate_name = !wanted.empty() && owner != ssrc_by_name_.end() && owner->second != join.ssrc;
+
+            if (duplicate_name) {
+                std::cout << "[SFU] JOIN rejected (duplicate name): " << join.name
+                          << " (" << join.ssrc << ")\n";
+            } else {
+                const uint32_t slot = peers_.insert(join.ssrc);
+                unindex_control(slot);
+                // Preserve previously learned audio endpoint from probe/audio
+                // traffic, but not a trunk's: the user has moved to this node.
+                if (!has_audio_endpoint(peers_.addr(slot)) || is_remote(slot)) {
+                    std::memset(&peers_.addr(slot), 0, sizeof(sockaddr_in));
                 }
+                PeerColdData& cold = peers_.cold(slot);
+                cold.trunk = PeerColdData::kLocal;
+                cold.control_addr = sender;
+                cold.name = name;
+                cold.join_ms = now_ms();
+                ssrc_by_control_endpoint_[endpoint_key(sender)] = join.ssrc;
+                if (!wanted.empty()) {
+                    ssrc_by_name_[wanted] = join.ssrc;
+                }
+                peers_.set_has_control(slot, true);
+                touch_control(slot);
+                clear_route_targets(join.ssrc);
+                routes_[join.ssrc].broadcast = true;
+                permissions_.set_channel(join.ssrc, 0);
+                invalidate_sender(join.ssrc);
+                invalidate_receiver(join.ssrc);
+                publish_routing();
             }
-            CtrlHeader pong{CtrlType::PONG, 0};
-            sendto(control_socket_, (const char*)&pong, sizeof(pong), 0,
-                   (sockaddr*)&sender, sender_len);
-            std::cout << "[SFU] PONG to " << inet_ntoa(sender.sin_addr)
-                      << ":" << ntohs(sender.sin_port)
-                      << (promoted ? " (promoted new peer)" : "") << "\n";
-            if (promoted) {
-                std::cout << "[SFU] Broadcasting user list after promotion\n";
-                broadcast_user_list();
+        }
+
+        // The joiner gets the full list now; everyone else (the joiner
+        // included) gets the coalesced delta.
+        send_presence_snapshot_to(sender);
+        if (duplicate_name) {
+            return;
+        }
+
+        std::cout << "[SFU] JOIN " << join.name << " (" << join.ssrc << ")\n";
+        queue_presence(CtrlPresenceOp::JOIN, join.ssrc);
+        return;
+    }
+
+    if (hdr.type == CtrlType::LEAVE && hdr.size == sizeof(CtrlLeave)) {
+        CtrlLeave leave{};
+        std::memcpy(&leave, buffer + sizeof(hdr), sizeof(leave));
+
+        remove_peer(leave.ssrc);
+        publish_routing();
+
+        std::cout << "[SFU] LEAVE " << leave.ssrc << "\n";
+        queue_presence(CtrlPresenceOp::LEAVE, leave.ssrc);
+        return;
+    }
+
+    if (hdr.type == CtrlType::LIST && hdr.size == 0) {
+        send_presence_snapshot_to(sender);
+        return;
+    }
+
+    if (hdr.type == CtrlType::TALK && hdr.size >= sizeof(CtrlTalk)) {
+        CtrlTalk talk{};
+        std::memcpy(&talk, buffer + sizeof(hdr), sizeof(talk));
+
+        std::set<uint32_t> targets;
+        size_t expected = sizeof(CtrlTalk) + talk.count * sizeof(uint32_t);
+        if (talk.count > 0 && hdr.size >= expected &&
+            recv_len >= (int)(sizeof(hdr) + expected)) {
+            const uint8_t* p = buffer + sizeof(hdr) + sizeof(talk);
+            for (uint16_t i = 0; i < talk.count; ++i) {
+                uint32_t target = 0;
+                std::memcpy(&target, p, sizeof(target));
+                targets.insert(target);
+                p += sizeof(target);
             }
-            continue;
         }
 
-        if (hdr.type == CtrlType::JOIN && hdr.size == sizeof(CtrlJoin)) {
-            CtrlJoin join{};
-            std::memcpy(&join, buffer + sizeof(hdr), sizeof(join));
+        // Only peers whose routes change need the update: the talker, its
+        // old and new targets, and anyone holding a link back to it.
+        std::set<uint32_t> affected(targets);
+        affected.insert(talk.from);
+        {
+            auto previous = routes_.find(talk.from);
+            if (previous != routes_.end()) {
+                affected.insert(previous->second.targets.begin(), previous->second.targets.end());
+            }
 
-            bool duplicate_name = false;
-            {
-                std::lock_guard<std::mutex> lock(peers_mutex_);
-                const std::string wanted = ascii_lower(std::string(join.name));
-                for (const auto& [ssrc, peer] : peers_) {
-                    if (ssrc == join.ssrc) {
+            // Remove previous reverse links to this sender. Only routes that
+            // list it are visited, via the reverse index.
+            auto linked = targeted_by_.find(talk.from);
+            if (linked != targeted_by_.end()) {
+                const std::set<uint32_t> senders = std::move(linked->second);
+                targeted_by_.erase(linked);
+                affected.insert(senders.begin(), senders.end());
+                for (uint32_t ssrc : senders) {
+                    if (ssrc == talk.from) {
+                        targeted_by_[talk.from].insert(ssrc);
                         continue;
                     }
-                    if (!peer.name.empty() && ascii_lower(peer.name) == wanted) {
-                        duplicate_name = true;
-                        break;
+                    auto& route = routes_[ssrc];
+                    route.targets.erase(talk.from);
+                    if (route.targets.empty()) {
+                        route.broadcast = true;
                     }
+                    invalidate_sender(ssrc);
                 }
+            }
 
-                if (duplicate_name) {
-                    std::cout << "[SFU] JOIN rejected (duplicate name): " << join.name
-                              << " (" << join.ssrc << ")\n";
-                } else {
-                    auto& peer = peers_[join.ssrc];
-                    // Preserve previously learned audio endpoint from probe/audio traffic.
-                    if (!has_audio_endpoint(peer)) {
-                        std::memset(&peer.addr, 0, sizeof(peer.addr));
-                    }
-                    peer.control_addr = sender;
-                    peer.ssrc = join.ssrc;
-                    peer.name = join.name;
-                    peer.has_control = true;
-                    peer.last_control_ms = now_ms();
-                    peer.join_ms = now_ms();
-                    routes_[join.ssrc].broadcast = true;
-                    routes_[join.ssrc].targets.clear();
-                    permissions_.set_channel(join.ssrc, 0);
-                }
+            clear_route_targets(talk.from);
+            for (uint32_t target : targets) {
+                add_route_target(talk.from, target);
+            }
+            routes_[talk.from].broadcast = targets.empty();
+            invalidate_sender(talk.from);
+            const uint32_t slot = peers_.find(talk.from);
+            if (slot != PeerTable::kNoSlot) {
+                touch_control(slot);
             }
 
-            if (duplicate_name) {
-                send_user_list_to(sender);
-                continue;
+            // Selected-talk should be duplex: add reverse links from targets back to sender.
+            for (uint32_t target : targets) {
+                add_route_target(target, talk.from);
+                routes_[target].broadcast = false;
+                invalidate_sender(target);
             }
+            publish_routing();
+        }
 
-            std::cout << "[SFU] JOIN " << join.name << " (" << join.ssrc << ")\n";
-            std::cout << "[SFU] Broadcasting user list after JOIN\n";
-            broadcast_user_list();
-            continue;
+        std::cout << "[SFU] TALK update from " << talk.from
+                  << " (targets=" << talk.count << ")\n";
+        send_talk_update(talk.from, targets, affected);
+        return;
+    }
+
+    if (hdr.type == CtrlType::MUTE && hdr.size == sizeof(CtrlMute)) {
+        CtrlMute mute{};
+        std::memcpy(&mute, buffer + sizeof(hdr), sizeof(mute));
+        if (!peers_.contains(mute.from) || !peers_.contains(mute.target)) {
+            return;
         }
+        permissions_.mute(mute.from, mute.target);
+        invalidate_sender(mute.target);
+        publish_routing();
+        return;
+    }
 
-        if (hdr.type == CtrlType::LEAVE && hdr.size == sizeof(CtrlLeave)) {
-            CtrlLeave leave{};
-            std::memcpy(&leave, buffer + sizeof(hdr), sizeof(leave));
+    if (hdr.type == CtrlType::UNMUTE && hdr.size == sizeof(CtrlMute)) {
+        CtrlMute mute{};
+        std::memcpy(&mute, buffer + sizeof(hdr), sizeof(mute));
+        if (!peers_.contains(mute.from) || !peers_.contains(mute.target)) {
+            return;
+        }
+        permissions_.unmute(mute.from, mute.target);
+        invalidate_sender(mute.target);
+        publish_routing();
+        return;
+    }
 
-            {
-                std::lock_guard<std::mutex> lock(peers_mutex_);
-                peers_.erase(leave.ssrc);
-                routes_.erase(leave.ssrc);
-                permissions_.remove_user(leave.ssrc);
+    if (hdr.type == CtrlType::SET_CHANNEL && hdr.size == sizeof(CtrlSetChannel)) {
+        CtrlSetChannel chan{};
+        std::memcpy(&chan, buffer + sizeof(hdr), sizeof(chan));
+        permissions_.set_channel(chan.ssrc, chan.channel_id);
+        invalidate_sender(chan.ssrc);
+        invalidate_receiver(chan.ssrc);
+        publish_routing();
+        if (!trunks_.empty()) {
+            pending_trunk_.insert(chan.ssrc);
+            control_reactor_.arm_timer(presence_timer_, PRESENCE_COALESCE_MS);
+        }
+        return;
+    }
+
+    if (hdr.type == CtrlType::TRUNK_USERS) {
+        for (size_t trunk = 0; trunk < trunks_.size(); ++trunk) {
+            if (same_endpoint(trunks_[trunk].control_addr, sender)) {
+                handle_trunk_users(trunk, buffer + sizeof(hdr),
+                                   std::min<size_t>(hdr.size, recv_len - sizeof(hdr)), sender);
+                return;
             }
+        }
+        VOIP_LOG_WARN_RATE(1, "SFU", "TRUNK_USERS from unknown node", {{"port", ntohs(sender.sin_port)}});
+        return;
+    }
+}
+
+CtrlTrunkUser SFU::trunk_user(uint32_t ssrc) const {
+    CtrlTrunkUser user{};
+    user.user.ssrc = ssrc;
+    const uint32_t slot = peers_.find(ssrc);
+    if (slot == PeerTable::kNoSlot || !peers_.has_control(slot) || is_remote(slot)) {
+        user.op = CtrlTrunkOp::REMOVE;
+        return user;
+    }
+    user.op = CtrlTrunkOp::UPSERT;
+    user.channel_id = permissions_.channel_of(ssrc);
+    user.user = user_info(slot);
+    return user;
+}
 
-            std::cout << "[SFU] LEAVE " << leave.ssrc << "\n";
-            broadcast_user_list();
+void SFU::send_to_trunks(const std::vector<CtrlTrunkUser>& users) {
+    const auto datagrams = encode_trunk_users(options_.node_id, audio_port_, users);
+    for (const TrunkLink& trunk : trunks_) {
+        for (const std::vector<uint8_t>& pkt : datagrams) {
+            sendto(control_socket_, (const char*)pkt.data(), (int)pkt.size(), 0,
+                   (const sockaddr*)&trunk.control_addr, sizeof(trunk.control_addr));
+        }
+    }
+}
+
+// Rides on the presence timer, so a burst of local changes reaches the
+// other nodes as one TRUNK_USERS rather than one per change. A REMOVE for
+// a user the receiving node did not learn from us is ignored there.
+void SFU::flush_trunk_changes() {
+    if (pending_trunk_.empty()) {
+        return;
+    }
+    std::vector<CtrlTrunkUser> users;
+    users.reserve(pending_trunk_.size());
+    for (uint32_t ssrc : pending_trunk_) {
+        const uint32_t slot = peers_.find(ssrc);
+        if (slot != PeerTable::kNoSlot && is_remote(slot)) {
             continue;
         }
+        users.push_back(trunk_user(ssrc));
+    }
+    pending_trunk_.clear();
+    if (!users.empty()) {
+        send_to_trunks(users);
+    }
+}
+
+void SFU::sync_trunks() {
+    const uint64_t now = now_ms();
+    std::vector<CtrlTrunkUser> users;
+    for (uint32_t slot = 0; slot < peers_.size(); ++slot) {
+        if (peers_.has_control(slot) && !is_remote(slot)) {
+            users.push_back(trunk_user(peers_.ssrc(slot)));
+        }
+    }
+    send_to_trunks(users);
 
-        if (hdr.type == CtrlType::LIST && hdr.size == 0) {
-            send_user_list_to(sender);
+    bool changed = false;
+    for (size_t trunk = 0; trunk < trunks_.size(); ++trunk) {
+        TrunkLink& link = trunks_[trunk];
+        if (!link.up()) {
             continue;
         }
+        if (now - link.last_seen_ms > TRUNK_TIMEOUT_MS) {
+            std::cout << "[SFU] Trunk " << link.spec << " (node " << link.node_id << ") down\n";
+            link.last_seen_ms = 0;
+            drop_trunk_peers(trunk, now);
+            changed = true;
+        } else {
+            // Users missing from every snapshot since the timeout window
+            // began have left without a REMOVE reaching us.
+            const size_t before = peers_.size();
+            drop_trunk_peers(trunk, now - TRUNK_TIMEOUT_MS);
+            changed = changed || peers_.size() != before;
+        }
+    }
+    if (changed) {
+        publish_routing();
+    }
+}
+
+// Removes the peers learned from `trunk` that were last announced before
+// `older_than_ms`.
+void SFU::drop_trunk_peers(size_t trunk, uint64_t older_than_ms) {
+    std::vector<uint32_t> stale;
+    for (uint32_t slot = 0; slot < peers_.size(); ++slot) {
+        if (peers_.cold(slot).trunk == trunk && peers_.last_control_ms(slot) < older_than_ms) {
+            stale.push_back(peers_.ssrc(slot));
+        }
+    }
+    for (uint32_t ssrc : stale) {
+        remove_peer(ssrc);
+        queue_presence(CtrlPresenceOp::LEAVE, ssrc);
+    }
+}
 
-        if (hdr.type == CtrlType::TALK && hdr.size >= sizeof(CtrlTalk)) {
-            CtrlTalk talk{};
-            std::memcpy(&talk, buffer + sizeof(hdr), sizeof(talk));
-
-            std::set<uint32_t> targets;
-            size_t expected = sizeof(CtrlTalk) + talk.count * sizeof(uint32_t);
-            if (talk.count > 0 && hdr.size >= expected &&
-                recv_len >= (int)(sizeof(hdr) + expected)) {
-                const uint8_t* p = buffer + sizeof(hdr) + sizeof(talk);
-                for (uint16_t i = 0; i < talk.count; ++i) {
-                    uint32_t target = 0;
-                    std::memcpy(&target, p, sizeof(target));
-                    targets.insert(target);
-                    p += sizeof(target);
-                }
+void SFU::handle_trunk_users(size_t trunk, const uint8_t* payload, size_t len, const sockaddr_in& sender) {
+    CtrlTrunkUsers header{};
+    const uint8_t* entries = nullptr;
+    if (!decode_trunk_users(payload, len, header, entries) || header.node_id == options_.node_id) {
+        return;
+    }
+
+    const uint64_t now = now_ms();
+    TrunkLink& link = trunks_[trunk];
+    sockaddr_in media_addr = sender;
+    media_addr.sin_port = htons(header.audio_port);
+    bool changed = false;
+    if (!link.up() || !same_endpoint(link.media_addr, media_addr)) {
+        std::cout << "[SFU] Trunk " << link.spec << " (node " << header.node_id << ") up, media "
+                  << inet_ntoa(media_addr.sin_addr) << ":" << header.audio_port << "\n";
+        link.media_addr = media_addr;
+        for (uint32_t slot = 0; slot < peers_.size(); ++slot) {
+            if (peers_.cold(slot).trunk == trunk) {
+                peers_.addr(slot) = media_addr;
+                invalidate_sender(peers_.ssrc(slot));
+                invalidate_receiver(peers_.ssrc(slot));
+            }
+        }
+        changed = true;
+    }
+    link.node_id = header.node_id;
+    link.last_seen_ms = now;
+
+    for (uint16_t i = 0; i < header.count; ++i) {
+        CtrlTrunkUser entry{};
+        std::memcpy(&entry, entries + i * sizeof(CtrlTrunkUser), sizeof(entry));
+        const uint32_t ssrc = entry.user.ssrc;
+        uint32_t slot = peers_.find(ssrc);
+
+        if (entry.op == CtrlTrunkOp::REMOVE) {
+            if (slot != PeerTable::kNoSlot && peers_.cold(slot).trunk == trunk) {
+                remove_peer(ssrc);
+                queue_presence(CtrlPresenceOp::LEAVE, ssrc);
+                changed = true;
             }
+            continue;
+        }
+        if (entry.op != CtrlTrunkOp::UPSERT) {
+            continue;
+        }
 
-            {
-                std::lock_guard<std::mutex> lock(peers_mutex_);
+        const bool is_new = slot == PeerTable::kNoSlot;
+        if (!is_new && peers_.cold(slot).trunk != trunk) {
+            // Joined here, or announced by another node first.
+            if (peers_.cold(slot).trunk != PeerColdData::kLocal || peers_.has_control(slot)) {
+                continue;
+            }
+            // Only seen as audio so far; the trunk's word wins.
+            liveness_wheel_.cancel(ssrc);
+        }
+        const std::string name(entry.user.name, strnlen(entry.user.name, sizeof(entry.user.name)));
+        if (is_new || peers_.cold(slot).trunk != trunk) {
+            permissions_.add_user(ssrc);
+            slot = peers_.insert(ssrc);
+            PeerColdData& cold = peers_.cold(slot);
+            cold.trunk = static_cast<uint32_t>(trunk);
+            cold.join_ms = now;
+            peers_.addr(slot) = link.media_addr;
+            peers_.set_has_control(slot, true);
+            invalidate_sender(ssrc);
+            invalidate_receiver(ssrc);
+            queue_presence(CtrlPresenceOp::JOIN, ssrc);
+            changed = true;
+        }
+        PeerColdData& cold = peers_.cold(slot);
+        if (cold.name != name) {
+            if (!cold.name.empty()) {
+                unindex_control(slot);
+            }
+            cold.name = name;
+            if (!name.empty()) {
+                ssrc_by_name_.emplace(ascii_lower(name), ssrc);
+            }
+            queue_presence(CtrlPresenceOp::UPDATE, ssrc);
+        }
+        if (permissions_.channel_of(ssrc) != entry.channel_id &&
+            entry.channel_id != PermissionManager::kNoChannel) {
+            permissions_.set_channel(ssrc, entry.channel_id);
+            invalidate_sender(ssrc);
+            invalidate_receiver(ssrc);
+            changed = true;
+        }
+        // Remote peers are kept alive by the trunk, not the liveness wheel.
+        peers_.last_control_ms(slot) = now;
+    }
+    if (changed) {
+        publish_routing();
+    }
+}
 
-                // Remove previous reverse links to this sender.
-                for (auto& [ssrc, route] : routes_) {
-                    if (ssrc == talk.from) {
-                        continue;
-                    }
-                    route.targets.erase(talk.from);
-                    if (route.targets.empty()) {
-                        route.broadcast = true;
-                    }
-                }
+bool SFU::take_over(std::vector<SocketHandle>& sockets, std::string& state) {
+    std::string error;
+    takeover_conn_ = sfuhandoff::connect_to(options_.handoff_path, error);
+    if (takeover_conn_ == INVALID_SOCKET) {
+        std::cerr << "[SFU] No process to take over at " << options_.handoff_path << ": " << error << "\n";
+        return false;
+    }
+    if (!sfuhandoff::receive_state(takeover_conn_, sockets, state, HANDOFF_TIMEOUT_MS) || state.empty() ||
+        sockets.size() < (state[0] ? 4u : 3u)) {
+        std::cerr << "[SFU] Takeover handshake failed\n";
+        for (SocketHandle socket : sockets) {
+            closesocket(socket);
+        }
+        sockets.clear();
+        return false;
+    }
+    std::cout << "[SFU] Received " << sockets.size() << " socket(s) and " << state.size()
+              << " bytes of state from the previous process\n";
+    return true;
+}
 
-                auto& route = routes_[talk.from];
-                route.targets = std::move(targets);
-                route.broadcast = route.targets.empty();
-                auto it = peers_.find(talk.from);
-                if (it != peers_.end()) {
-                    it->second.last_control_ms = now_ms();
-                }
+// Everything the control thread owns that a successor cannot relearn
+// within a packet interval. Worker shards, fan-out caches and speaker
+// levels are rebuilt or re-measured instead.
+std::string SFU::snapshot_state() const {
+    sfuhandoff::StateWriter out;
+    out.put<uint8_t>(metrics_endpoint_.socket() != INVALID_SOCKET ? 1 : 0); // Read before the header
+    out.put(presence_version_);
+
+    out.put(static_cast<uint32_t>(trunks_.size()));
+    for (const TrunkLink& trunk : trunks_) {
+        out.put_string(trunk.spec);
+        out.put(trunk.media_addr);
+        out.put(trunk.node_id);
+        out.put(trunk.last_seen_ms);
+    }
 
-                // Selected-talk should be duplex: add reverse links from targets back to sender.
-                if (!route.targets.empty()) {
-                    for (uint32_t target : route.targets) {
-                        auto& reverse = routes_[target];
-                        reverse.targets.insert(talk.from);
-                        reverse.broadcast = false;
-                    }
-                }
-                targets = route.targets;
+    out.put(static_cast<uint32_t>(peers_.size()));
+    for (uint32_t slot = 0; slot < peers_.size(); ++slot) {
+        const PeerColdData& cold = peers_.cold(slot);
+        out.put(peers_.ssrc(slot));
+        out.put(peers_.addr(slot));
+        out.put(peers_.last_packet_ms(slot));
+        out.put(peers_.last_control_ms(slot));
+        out.put<uint8_t>(peers_.has_control(slot) ? 1 : 0);
+        out.put(cold.control_addr);
+        out.put(cold.join_ms);
+        out.put_string(cold.name);
+        out.put(cold.trunk);
+    }
+
+    out.put(static_cast<uint32_t>(routes_.size()));
+    for (const auto& route : routes_) {
+        out.put(route.first);
+        out.put<uint8_t>(route.second.broadcast ? 1 : 0);
+        out.put(static_cast<uint32_t>(route.second.targets.size()));
+        for (uint32_t target : route.second.targets) {
+            out.put(target);
+        }
+    }
+
+    std::vector<std::pair<uint32_t, uint32_t>> users;
+    std::vector<std::pair<uint32_t, uint32_t>> mutes;
+    permissions_.for_each_user([&](uint32_t ssrc, uint32_t channel) { users.emplace_back(ssrc, channel); });
+    permissions_.for_each_mute([&](uint32_t listener, uint32_t sender) { mutes.emplace_back(listener, sender); });
+    out.put(static_cast<uint32_t>(users.size()));
+    for (const auto& user : users) {
+        out.put(user.first);
+        out.put(user.second);
+    }
+    out.put(static_cast<uint32_t>(mutes.size()));
+    for (const auto& mute : mutes) {
+        out.put(mute.first);
+        out.put(mute.second);
+    }
+    return out.data();
+}
+
+bool SFU::restore_state(const std::string& state) {
+    sfuhandoff::StateReader in(state);
+    in.get<uint8_t>();
+    presence_version_ = in.get<uint32_t>();
+
+    // Trunks are matched by the address given on each command line; users
+    // behind a trunk the new process no longer has are dropped.
+    std::vector<uint32_t> trunk_map;
+    const uint32_t trunk_count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < trunk_count && in.ok(); ++i) {
+        const std::string spec = in.get_string();
+        TrunkLink previous;
+        previous.media_addr = in.get<sockaddr_in>();
+        previous.node_id = in.get<uint32_t>();
+        previous.last_seen_ms = in.get<uint64_t>();
+        uint32_t mapped = PeerColdData::kLocal;
+        for (size_t t = 0; t < trunks_.size(); ++t) {
+            if (trunks_[t].spec == spec) {
+                trunks_[t].media_addr = previous.media_addr;
+                trunks_[t].node_id = previous.node_id;
+                trunks_[t].last_seen_ms = previous.last_seen_ms;
+                mapped = static_cast<uint32_t>(t);
             }
+        }
+        trunk_map.push_back(mapped);
+    }
 
-            std::cout << "[SFU] TALK update from " << talk.from
-                      << " (targets=" << talk.count << ")\n";
-            broadcast_talk_update(talk.from, targets);
-            continue;
+    std::vector<uint32_t> dropped;
+    const uint32_t peer_count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < peer_count && in.ok(); ++i) {
+        const uint32_t ssrc = in.get<uint32_t>();
+        const sockaddr_in addr = in.get<sockaddr_in>();
+        const uint64_t last_packet_ms = in.get<uint64_t>();
+        const uint64_t last_control_ms = in.get<uint64_t>();
+        const bool has_control = in.get<uint8_t>() != 0;
+        const sockaddr_in control_addr = in.get<sockaddr_in>();
+        const uint64_t join_ms = in.get<uint64_t>();
+        std::string name = in.get_string();
+        uint32_t trunk = in.get<uint32_t>();
+        if (trunk != PeerColdData::kLocal) {
+            trunk = trunk < trunk_map.size() ? trunk_map[trunk] : PeerColdData::kLocal;
+            if (trunk == PeerColdData::kLocal) {
+                dropped.push_back(ssrc);
+                continue;
+            }
         }
 
-        if (hdr.type == CtrlType::MUTE && hdr.size == sizeof(CtrlMute)) {
-            CtrlMute mute{};
-            std::memcpy(&mute, buffer + sizeof(hdr), sizeof(mute));
-            permissions_.mute(mute.from, mute.target);
-            continue;
+        const uint32_t slot = peers_.insert(ssrc);
+        peers_.addr(slot) = addr;
+        peers_.last_packet_ms(slot) = last_packet_ms;
+        peers_.last_control_ms(slot) = last_control_ms;
+        peers_.set_has_control(slot, has_control);
+        PeerColdData& cold = peers_.cold(slot);
+        cold.control_addr = control_addr;
+        cold.join_ms = join_ms;
+        cold.name = std::move(name);
+        cold.trunk = trunk;
+        if (!cold.name.empty()) {
+            ssrc_by_name_[ascii_lower(cold.name)] = ssrc;
+        }
+        if (trunk == PeerColdData::kLocal) {
+            if (has_control) {
+                ssrc_by_control_endpoint_[endpoint_key(control_addr)] = ssrc;
+            }
+            liveness_wheel_.arm(ssrc, liveness_deadline(slot));
         }
+    }
 
-        if (hdr.type == CtrlType::UNMUTE && hdr.size == sizeof(CtrlMute)) {
-            CtrlMute mute{};
-            std::memcpy(&mute, buffer + sizeof(hdr), sizeof(mute));
-            permissions_.unmute(mute.from, mute.target);
-            continue;
+    const uint32_t route_count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < route_count && in.ok(); ++i) {
+        const uint32_t sender = in.get<uint32_t>();
+        routes_[sender].broadcast = in.get<uint8_t>() != 0;
+        const uint32_t targets = in.get<uint32_t>();
+        for (uint32_t t = 0; t < targets && in.ok(); ++t) {
+            add_route_target(sender, in.get<uint32_t>());
         }
+    }
 
-        if (hdr.type == CtrlType::SET_CHANNEL && hdr.size == sizeof(CtrlSetChannel)) {
-            CtrlSetChannel chan{};
-            std::memcpy(&chan, buffer + sizeof(hdr), sizeof(chan));
-            permissions_.set_channel(chan.ssrc, chan.channel_id);
-            continue;
+    const uint32_t user_count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < user_count && in.ok(); ++i) {
+        const uint32_t ssrc = in.get<uint32_t>();
+        const uint32_t channel = in.get<uint32_t>();
+        permissions_.add_user(ssrc);
+        if (channel != PermissionManager::kNoChannel) {
+            permissions_.set_channel(ssrc, channel);
         }
     }
+    const uint32_t mute_count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < mute_count && in.ok(); ++i) {
+        const uint32_t listener = in.get<uint32_t>();
+        const uint32_t sender = in.get<uint32_t>();
+        permissions_.mute(listener, sender);
+    }
+    if (!in.ok()) {
+        return false;
+    }
+
+    for (uint32_t ssrc : dropped) {
+        remove_peer(ssrc);
+        queue_presence(CtrlPresenceOp::LEAVE, ssrc);
+    }
+    std::cout << "[SFU] Restored " << peers_.size() << " peer(s), " << routes_.size()
+              << " route(s), presence v" << presence_version_ << "\n";
+    return true;
+}
+
+// Runs on the control thread, which stays blocked until the successor has
+// acked or given up: no control message is handled between the snapshot
+// and the switch. Media workers keep forwarding the whole time.
+void SFU::serve_handoff() {
+    const SocketHandle conn = sfuhandoff::accept_from(handoff_listener_);
+    if (conn == INVALID_SOCKET) {
+        return;
+    }
+    drain_media_events();
+    flush_presence();
+
+    std::vector<SocketHandle> sockets{handoff_listener_, control_socket_};
+    if (metrics_endpoint_.socket() != INVALID_SOCKET) {
+        sockets.push_back(metrics_endpoint_.socket());
+    }
+    for (const auto& worker : workers_) {
+        sockets.push_back(worker->socket);
+    }
+
+    std::cout << "[SFU] Handing off to a new process\n";
+    const bool done = sfuhandoff::send_state(conn, sockets, snapshot_state(), HANDOFF_TIMEOUT_MS) &&
+                      sfuhandoff::wait_ack(conn, HANDOFF_TIMEOUT_MS);
+    closesocket(conn);
+    if (!done) {
+        std::cerr << "[SFU] Handoff did not complete; still serving\n";
+        return;
+    }
+
+    std::cout << "[SFU] Handed off; stopping\n";
+    running_ = false;
+    for (auto& worker : workers_) {
+        worker->reactor.wake();
+    }
 }
 
 void SFU::start() {
     if (running_) return;
 
     running_ = true;
-    audio_thread_ = std::thread(&SFU::audio_loop, this);
+    for (auto& worker : workers_) {
+        MediaWorker* w = worker.get();
+        w->thread = std::thread([this, w]() { media_worker_loop(*w); });
+    }
     control_thread_ = std::thread(&SFU::control_loop, this);
+
+    // The previous process keeps forwarding until it hears this.
+    if (takeover_conn_ != INVALID_SOCKET) {
+        const bool acked = sfuhandoff::send_ack(takeover_conn_);
+        closesocket(takeover_conn_);
+        takeover_conn_ = INVALID_SOCKET;
+        if (!acked) {
+            std::cerr << "[SFU] Previous process went away mid-takeover; leaving it in charge\n";
+            stop();
+            return;
+        }
+        std::cout << "[SFU] Took over from the previous process\n";
+    }
 }
 
 void SFU::stop() {
     running_ = false;
+    for (auto& worker : workers_) {
+        worker->reactor.wake();
+    }
+    control_reactor_.wake();
 
-    if (audio_thread_.joinable()) {
-        audio_thread_.join();
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
     }
     if (control_thread_.joinable()) {
         control_thread_.join();
@@ -687,24 +2152,99 @@ void SFU::stop() {
 }
 
 // === MAIN SFU SERVER ===
-int main() {
+// Usage: voip_sfu [--batch N] [--gro] [--workers N] [--pin-workers] [--max-speakers N]
+//                 [--audio-port N] [--control-port N] [--node-id N] [--trunk host:port]...
+//                 [--handoff PATH [--takeover]] [--pace-kbps N [--pace-burst-ms N] [--pace-queue N]]
+int main(int argc, char* argv[]) {
+    SfuOptions options;
+    uint16_t audio_port = AUDIO_PORT;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc) {
+            const long parsed = std::strtol(argv[++i], nullptr, 10);
+            if (parsed >= 1 && parsed <= 1024) {
+                options.io_batch = static_cast<size_t>(parsed);
+            }
+        } else if (arg == "--gro") {
+            options.udp_gro = true;
+        } else if (arg == "--workers" && i + 1 < argc) {
+            const long parsed = std::strtol(argv[++i], nullptr, 10);
+            if (parsed >= 1 && parsed <= MAX_MEDIA_WORKERS) {
+                options.workers = static_cast<size_t>(parsed);
+            }
+        } else if (arg == "--pin-workers") {
+            options.pin_workers = true;
+        } else if (arg == "--io-uring") {
+            options.io_uring = true;
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            const long parsed = std::strtol(argv[++i], nullptr, 10);
+            if (parsed >= 1 && parsed <= 65535) {
+                options.metrics_port = static_cast<uint16_t>(parsed);
+            }
+        } else if (arg == "--max-speakers" && i + 1 < argc) {
+            const long parsed = std::strtol(argv[++i], nullptr, 10);
+            if (parsed >= 0 && parsed <= MAX_PEERS) {
+                options.max_speakers = static_cast<size_t>(parsed);
+            }
+        } else if ((arg == "--audio-port" || arg == "--control-port") && i + 1 < argc) {
+            const long parsed = std::strtol(argv[++i], nullptr, 10);
+            if (parsed >= 1 && parsed <= 65535) {
+                (arg == "--audio-port" ? audio_port : options.control_port) = static_cast<uint16_t>(parsed);
+            }
+        } else if (arg == "--node-id" && i + 1 < argc) {
+            options.node_id = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--trunk" && i + 1 < argc) {
+            options.trunks.push_back(argv[++i]);
+        } else if (arg == "--pace-kbps" && i + 1 < argc) {
+            const long parsed = std::strtol(argv[++i], nullptr, 10);
+            if (parsed >= 0 && parsed <= 1000000) {
+                options.pace_kbps = static_cast<uint32_t>(parsed);
+            }
+        } else if (arg == "--pace-burst-ms" && i + 1 < argc) {
+            const long parsed = std::strtol(argv[++i], nullptr, 10);
+            if (parsed >= 1 && parsed <= 1000) {
+                options.pace_burst_ms = static_cast<uint32_t>(parsed);
+            }
+        } else if (arg == "--pace-queue" && i + 1 < argc) {
+            const long parsed = std::strtol(argv[++i], nullptr, 10);
+            if (parsed >= 1 && parsed <= 1024) {
+                options.pace_queue = static_cast<size_t>(parsed);
+            }
+        } else if (arg == "--handoff" && i + 1 < argc) {
+            options.handoff_path = argv[++i];
+        } else if (arg == "--takeover") {
+            options.takeover = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << "\n";
+            return 1;
+        }
+    }
+
+    if (options.takeover && options.handoff_path.empty()) {
+        std::cerr << "--takeover needs --handoff PATH\n";
+        return 1;
+    }
+
+    // Media-path records share stdout with the [SFU] status lines.
+    Logger::set_sink(stdout);
+
     std::cout << "=== VoIP SFU Server ===\n";
-    std::cout << "Listening on port " << AUDIO_PORT << "\n";
-    std::cout << "Control port " << DEFAULT_CONTROL_PORT << "\n";
+    std::cout << "Listening on port " << audio_port << "\n";
+    std::cout << "Control port " << options.control_port << "\n";
     std::cout << "Press Ctrl+C to stop\n\n";
 
-    SFU server;
+    SFU server(options);
 
-    if (!server.initialize(AUDIO_PORT)) {
+    if (!server.initialize(audio_port)) {
         std::cerr << "Failed to initialize SFU\n";
         return 1;
     }
 
     server.start();
 
-    // Keep running until interrupted
-    while (true) {
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    // Keep running until interrupted or handed off to a successor
+    while (server.running()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 
     server.stop();
@@ -0,0 +1,23 @@
+// 📁 server/sfu/sfu_socket.h
+// PLATFORM SOCKET SHIMS shared by the SFU translation units
+#pragma once
+
+#ifdef _WIN32
+    #include <winsock2.h>
+    #include <ws2tcpip.h>
+#ifdef _MSC_VER
+    #pragma comment(lib, "ws2_32.lib")
+#endif
+    typedef int socklen_t;
+    using SocketHandle = SOCKET;
+#else
+    #include <sys/socket.h>
+    #include <netinet/in.h>
+    #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #define closesocket close
+    #define INVALID_SOCKET -1
+    #define SOCKET_ERROR -1
+    using SocketHandle = int;
+#endif
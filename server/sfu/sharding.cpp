@@ -0,0 +1,89 @@
+#include "sfu/sharding.h"
+
+#include <cstring>
+
+#ifdef NOX_SFU_HAS_REUSEPORT_STEERING
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51
+#endif
+#endif
+
+namespace sfushard {
+
+bool reuseport_supported() {
+#ifdef NOX_SFU_HAS_REUSEPORT_STEERING
+    return true;
+#else
+    // Windows SO_REUSEADDR and BSD SO_REUSEPORT do not spread unicast UDP.
+    return false;
+#endif
+}
+
+bool enable_reuseport(SocketHandle socket) {
+#ifdef NOX_SFU_HAS_REUSEPORT_STEERING
+    int on = 1;
+    return setsockopt(socket, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) == 0;
+#else
+    (void)socket;
+    return false;
+#endif
+}
+
+bool attach_ssrc_steering(SocketHandle any_group_socket, uint32_t shard_count) {
+#ifdef NOX_SFU_HAS_REUSEPORT_STEERING
+    // The UDP header is already pulled, so offset 0 is AudioPacket::ssrc.
+    // Fold all four bytes together before the modulo; must match shard_for_ssrc().
+    sock_filter code[] = {
+        {BPF_LD | BPF_W | BPF_ABS, 0, 0, 0},
+        {BPF_MISC | BPF_TAX, 0, 0, 0},
+        {BPF_ALU | BPF_RSH | BPF_K, 0, 0, 16},
+        {BPF_ALU | BPF_XOR | BPF_X, 0, 0, 0},
+        {BPF_MISC | BPF_TAX, 0, 0, 0},
+        {BPF_ALU | BPF_RSH | BPF_K, 0, 0, 8},
+        {BPF_ALU | BPF_XOR | BPF_X, 0, 0, 0},
+        {BPF_ALU | BPF_MOD | BPF_K, 0, 0, shard_count},
+        {BPF_RET | BPF_A, 0, 0, 0},
+    };
+    sock_fprog prog{};
+    prog.len = static_cast<unsigned short>(sizeof(code) / sizeof(code[0]));
+    prog.filter = code;
+    return setsockopt(any_group_socket, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF,
+                      &prog, sizeof(prog)) == 0;
+#else
+    (void)any_group_socket;
+    (void)shard_count;
+    return false;
+#endif
+}
+
+uint32_t shard_for_ssrc(uint32_t ssrc, uint32_t shard_count) {
+    if (shard_count <= 1) {
+        return 0;
+    }
+    uint8_t wire[sizeof(ssrc)];
+    std::memcpy(wire, &ssrc, sizeof(ssrc));
+    uint32_t word = (static_cast<uint32_t>(wire[0]) << 24) |
+                    (static_cast<uint32_t>(wire[1]) << 16) |
+                    (static_cast<uint32_t>(wire[2]) << 8) |
+                    static_cast<uint32_t>(wire[3]);
+    word ^= word >> 16;
+    word ^= word >> 8;
+    return word % shard_count;
+}
+
+bool pin_current_thread(size_t cpu) {
+#ifdef NOX_SFU_HAS_REUSEPORT_STEERING
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+} // namespace sfushard
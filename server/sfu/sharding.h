@@ -0,0 +1,37 @@
+// 📁 server/sfu/sharding.h
+// MULTI-CORE SHARDING helpers for the SFU media workers
+// N workers each bind their own SO_REUSEPORT socket on the audio port. On
+// Linux a classic-BPF reuseport program steers every datagram by the SSRC in
+// its first payload bytes, so each sender is always handled by one worker.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "sfu/sfu_socket.h"
+
+#if defined(__linux__)
+#define NOX_SFU_HAS_REUSEPORT_STEERING 1
+#endif
+
+namespace sfushard {
+
+// True when this platform can load-balance one UDP port across sockets.
+bool reuseport_supported();
+
+// Must be set on every socket of the group before bind().
+bool enable_reuseport(SocketHandle socket);
+
+// Attaches the SSRC steering program to the reuseport group. Call after all
+// `shard_count` sockets are bound; socket index == bind order == worker index.
+bool attach_ssrc_steering(SocketHandle any_group_socket, uint32_t shard_count);
+
+// Worker index the steering program picks for `ssrc`. Matches the kernel
+// program, which reads the first four wire bytes as a big-endian word and
+// xor-folds it so small little-endian SSRCs still spread across workers.
+uint32_t shard_for_ssrc(uint32_t ssrc, uint32_t shard_count);
+
+// Pins the calling thread to `cpu`. No-op (returns false) where unsupported.
+bool pin_current_thread(size_t cpu);
+
+} // namespace sfushard
@@ -0,0 +1,85 @@
+#include "sfu/trunk.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <netdb.h>
+#endif
+
+bool parse_trunk_endpoint(const std::string& spec, sockaddr_in& out) {
+    const size_t colon = spec.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == spec.size()) {
+        return false;
+    }
+    const std::string host = spec.substr(0, colon);
+    char* end = nullptr;
+    const long port = std::strtol(spec.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || port < 1 || port > 65535) {
+        return false;
+    }
+
+    std::memset(&out, 0, sizeof(out));
+    out.sin_family = AF_INET;
+    out.sin_port = htons(static_cast<uint16_t>(port));
+    if (inet_pton(AF_INET, host.c_str(), &out.sin_addr) == 1) {
+        return true;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo* resolved = nullptr;
+    if (getaddrinfo(host.c_str(), nullptr, &hints, &resolved) != 0 || !resolved) {
+        return false;
+    }
+    out.sin_addr = reinterpret_cast<const sockaddr_in*>(resolved->ai_addr)->sin_addr;
+    freeaddrinfo(resolved);
+    return true;
+}
+
+std::vector<std::vector<uint8_t>> encode_trunk_users(uint32_t node_id, uint16_t audio_port,
+                                                     const std::vector<CtrlTrunkUser>& users) {
+    constexpr size_t kPerDatagram =
+        (CTRL_MAX_DATAGRAM - sizeof(CtrlHeader) - sizeof(CtrlTrunkUsers)) / sizeof(CtrlTrunkUser);
+
+    std::vector<std::vector<uint8_t>> datagrams;
+    size_t offset = 0;
+    do {
+        const size_t count = std::min(kPerDatagram, users.size() - offset);
+
+        CtrlHeader hdr{};
+        hdr.type = CtrlType::TRUNK_USERS;
+        hdr.size = static_cast<uint16_t>(sizeof(CtrlTrunkUsers) + count * sizeof(CtrlTrunkUser));
+
+        CtrlTrunkUsers body{};
+        body.node_id = node_id;
+        body.audio_port = audio_port;
+        body.count = static_cast<uint16_t>(count);
+
+        std::vector<uint8_t> pkt(sizeof(hdr) + hdr.size);
+        std::memcpy(pkt.data(), &hdr, sizeof(hdr));
+        std::memcpy(pkt.data() + sizeof(hdr), &body, sizeof(body));
+        if (count > 0) {
+            std::memcpy(pkt.data() + sizeof(hdr) + sizeof(body), users.data() + offset,
+                        count * sizeof(CtrlTrunkUser));
+        }
+        datagrams.push_back(std::move(pkt));
+        offset += count;
+    } while (offset < users.size());
+    return datagrams;
+}
+
+bool decode_trunk_users(const uint8_t* payload, size_t len, CtrlTrunkUsers& header,
+                        const uint8_t*& users) {
+    if (len < sizeof(CtrlTrunkUsers)) {
+        return false;
+    }
+    std::memcpy(&header, payload, sizeof(header));
+    if (header.audio_port == 0 || len < sizeof(header) + header.count * sizeof(CtrlTrunkUser)) {
+        return false;
+    }
+    users = payload + sizeof(header);
+    return true;
+}
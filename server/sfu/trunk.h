@@ -0,0 +1,38 @@
+// 📁 server/sfu/trunk.h
+// SFU-TO-SFU TRUNKS
+// Nodes listed with --trunk form a full mesh. Each node relays its local
+// senders' audio to every other node at most once per packet, and tells the
+// others which users it hosts (CtrlType::TRUNK_USERS). Audio that arrived
+// over a trunk is only ever forwarded to local listeners, so it cannot loop.
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "shared/protocol/control_protocol.h"
+#include "sfu/sfu_socket.h"
+
+struct TrunkLink {
+    std::string spec;           // host:port as given on the command line
+    sockaddr_in control_addr{}; // The other node's control socket
+    sockaddr_in media_addr{};   // Its audio socket, announced in TRUNK_USERS
+    uint32_t node_id = 0;
+    uint64_t last_seen_ms = 0;  // 0 until the first TRUNK_USERS arrives
+
+    bool up() const { return last_seen_ms != 0; }
+};
+
+// Parses "a.b.c.d:port" or "hostname:port" (IPv4).
+bool parse_trunk_endpoint(const std::string& spec, sockaddr_in& out);
+
+// Splits `users` into TRUNK_USERS datagrams no larger than CTRL_MAX_DATAGRAM.
+// Always yields at least one datagram, so an empty list still serves as a
+// keepalive.
+std::vector<std::vector<uint8_t>> encode_trunk_users(uint32_t node_id, uint16_t audio_port,
+                                                     const std::vector<CtrlTrunkUser>& users);
+
+// Validates a TRUNK_USERS payload (after the CtrlHeader). On success `users`
+// points into `payload`, which must outlive it.
+bool decode_trunk_users(const uint8_t* payload, size_t len, CtrlTrunkUsers& header,
+                        const uint8_t*& users);
@@ -0,0 +1,449 @@
+#include "sfu/uring_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#ifdef NOX_SFU_HAS_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace {
+constexpr uint64_t kRecvTag = ~uint64_t{0}; // Sends use their slot index
+constexpr uint16_t kBufferGroup = 0;
+constexpr unsigned kSqEntries = 1024;
+constexpr unsigned kCqEntries = 16384;
+constexpr size_t kMaxBuffers = 32768; // Buffer ids are 16 bits
+
+size_t round_up_pow2(size_t n) {
+    size_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+}
+
+UringMediaIo::UringMediaIo(size_t batch_size, size_t send_capacity, size_t buffer_count, size_t buffer_size)
+    : batch_size_(std::max<size_t>(1, batch_size)),
+      send_capacity_(std::max<size_t>(1, send_capacity)),
+      buffer_count_(std::min(round_up_pow2(std::max<size_t>(2, buffer_count)), kMaxBuffers)),
+      buffer_size_(buffer_size) {
+    views_.reserve(batch_size_);
+}
+
+#ifdef NOX_SFU_HAS_URING
+
+namespace {
+int uring_setup(unsigned entries, io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+}
+
+int uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+void* map_anonymous(size_t size) {
+    // MAP_POPULATE faults every page in now rather than on the first datagram.
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    return mem == MAP_FAILED ? nullptr : mem;
+}
+}
+
+UringMediaIo::~UringMediaIo() {
+    close_ring();
+}
+
+bool UringMediaIo::open(SocketHandle socket, std::string& error) {
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = kCqEntries;
+    ring_fd_ = uring_setup(kSqEntries, &params);
+    if (ring_fd_ < 0) {
+        error = std::string("io_uring_setup: ") + std::strerror(errno);
+        ring_fd_ = -1;
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+        error = "kernel io_uring lacks SINGLE_MMAP/NODROP";
+        close_ring();
+        return false;
+    }
+
+    const size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    const size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring_mem_size_ = std::max(sq_size, cq_size);
+    void* ring = mmap(nullptr, ring_mem_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    ring_mem_ = (ring == MAP_FAILED) ? nullptr : ring;
+    sqes_ = (sqes == MAP_FAILED) ? nullptr : static_cast<io_uring_sqe*>(sqes);
+    if (!ring_mem_ || !sqes_) {
+        error = "mapping the io_uring rings failed";
+        close_ring();
+        return false;
+    }
+
+    uint8_t* base = static_cast<uint8_t*>(ring_mem_);
+    sq_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    sq_flags_ = reinterpret_cast<unsigned*>(base + params.sq_off.flags);
+    sq_mask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+    cq_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+
+    buf_ring_size_ = buffer_count_ * sizeof(io_uring_buf);
+    buffers_size_ = buffer_count_ * buffer_size_;
+    buf_ring_ = static_cast<io_uring_buf*>(map_anonymous(buf_ring_size_));
+    buffers_ = static_cast<uint8_t*>(map_anonymous(buffers_size_));
+    if (!buf_ring_ || !buffers_) {
+        error = "allocating receive buffers failed";
+        close_ring();
+        return false;
+    }
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = static_cast<uint32_t>(buffer_count_);
+    reg.bgid = kBufferGroup;
+    if (uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        error = std::string("provided buffer ring (Linux 5.19+): ") + std::strerror(errno);
+        close_ring();
+        return false;
+    }
+    buf_ring_registered_ = true;
+
+    inflight_.assign(buffer_count_, 0);
+    held_.assign(buffer_count_, 0);
+    batch_buffers_.reserve(batch_size_);
+    for (size_t bid = 0; bid < buffer_count_; ++bid) {
+        recycle(static_cast<uint16_t>(bid));
+    }
+    publish_buffers();
+
+    send_slots_.resize(send_capacity_);
+    free_send_slots_.reserve(send_capacity_);
+    for (size_t i = send_capacity_; i > 0; --i) {
+        free_send_slots_.push_back(static_cast<uint32_t>(i - 1));
+    }
+
+    socket_ = socket;
+    recv_msg_.msg_namelen = sizeof(sockaddr_in);
+    arm_receive();
+    submit(0);
+
+    // Kernels before 6.0 reject the multishot flag while preparing the
+    // request, so that failure is already waiting on the completion ring.
+    const unsigned head = *cq_head_;
+    if (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        if (cqe.user_data == kRecvTag && cqe.res < 0 && !(cqe.flags & IORING_CQE_F_MORE)) {
+            error = std::string("multishot recvmsg (Linux 6.0+): ") + std::strerror(-cqe.res);
+            close_ring();
+            return false;
+        }
+    }
+    return true;
+}
+
+void UringMediaIo::close_ring() {
+    if (buf_ring_registered_) {
+        io_uring_buf_reg reg{};
+        reg.bgid = kBufferGroup;
+        uring_register(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        buf_ring_registered_ = false;
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+        ring_fd_ = -1;
+    }
+    if (sqes_) {
+        munmap(sqes_, sqes_size_);
+        sqes_ = nullptr;
+    }
+    if (ring_mem_) {
+        munmap(ring_mem_, ring_mem_size_);
+        ring_mem_ = nullptr;
+    }
+    if (buf_ring_) {
+        munmap(buf_ring_, buf_ring_size_);
+        buf_ring_ = nullptr;
+    }
+    if (buffers_) {
+        munmap(buffers_, buffers_size_);
+        buffers_ = nullptr;
+    }
+}
+
+io_uring_sqe* UringMediaIo::next_sqe() {
+    if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+        // Ring full: hand the queued entries to the kernel to make room.
+        submit(0);
+        if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            return nullptr;
+        }
+    }
+    const unsigned index = sq_local_tail_ & sq_mask_;
+    sq_array_[index] = index;
+    ++sq_local_tail_;
+    ++sq_pending_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+bool UringMediaIo::submit(unsigned wait_for) {
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+    const unsigned flags = wait_for ? IORING_ENTER_GETEVENTS : 0;
+    int submitted;
+    do {
+        submitted = uring_enter(ring_fd_, sq_pending_, wait_for, flags);
+    } while (submitted < 0 && errno == EINTR);
+    if (submitted < 0) {
+        return false;
+    }
+    if (sq_pending_ != 0) {
+        ++tx_stats_.send_calls;
+    }
+    sq_pending_ -= std::min(sq_pending_, static_cast<unsigned>(submitted));
+    return true;
+}
+
+void UringMediaIo::arm_receive() {
+    io_uring_sqe* sqe = next_sqe();
+    if (!sqe) {
+        return;
+    }
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socket_;
+    sqe->addr = reinterpret_cast<uint64_t>(&recv_msg_);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = kRecvTag;
+    receive_armed_ = true;
+}
+
+void UringMediaIo::recycle(uint16_t buffer_id) {
+    io_uring_buf& buf = buf_ring_[buf_tail_ & (buffer_count_ - 1)];
+    buf.addr = reinterpret_cast<uint64_t>(buffers_ + static_cast<size_t>(buffer_id) * buffer_size_);
+    buf.len = static_cast<uint32_t>(buffer_size_);
+    buf.bid = buffer_id;
+    ++buf_tail_;
+}
+
+void UringMediaIo::publish_buffers() {
+    // The ring tail overlays the reserved field of the first entry.
+    __atomic_store_n(&buf_ring_[0].resv, buf_tail_, __ATOMIC_RELEASE);
+}
+
+void UringMediaIo::complete_send(const io_uring_cqe& cqe) {
+    const uint32_t slot = static_cast<uint32_t>(cqe.user_data);
+    if (slot >= send_slots_.size()) {
+        return;
+    }
+    if (cqe.res < 0) {
+        ++tx_stats_.send_errors;
+    }
+    free_send_slots_.push_back(slot);
+    const uint16_t bid = send_slots_[slot].buffer_id;
+    if (--inflight_[bid] == 0 && !held_[bid]) {
+        recycle(bid);
+    }
+}
+
+void UringMediaIo::reap() {
+    // Completions that did not fit the ring are parked in the kernel until
+    // the next enter.
+    if (__atomic_load_n(sq_flags_, __ATOMIC_RELAXED) & IORING_SQ_CQ_OVERFLOW) {
+        uring_enter(ring_fd_, 0, 0, IORING_ENTER_GETEVENTS);
+    }
+
+    // Drains the whole ring so send completions queued behind a burst of
+    // receives free their slots and buffers right away.
+    unsigned head = *cq_head_;
+    const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    const size_t header = sizeof(io_uring_recvmsg_out) + recv_msg_.msg_namelen + recv_msg_.msg_controllen;
+    while (head != tail) {
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        ++head;
+        if (cqe.user_data != kRecvTag) {
+            complete_send(cqe);
+            continue;
+        }
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            // Terminated, typically -ENOBUFS while every buffer was busy.
+            receive_armed_ = false;
+        }
+        if (!(cqe.flags & IORING_CQE_F_BUFFER)) {
+            continue;
+        }
+        const uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        uint8_t* buf = buffers_ + static_cast<size_t>(bid) * buffer_size_;
+        io_uring_recvmsg_out out{};
+        if (cqe.res < 0 || static_cast<size_t>(cqe.res) < header) {
+            recycle(bid);
+            continue;
+        }
+        std::memcpy(&out, buf, sizeof(out));
+        if (out.flags & MSG_TRUNC) {
+            recycle(bid);
+            continue;
+        }
+
+        Received received;
+        received.view.data = buf + header;
+        received.view.len = static_cast<int>(std::min<size_t>(out.payloadlen, static_cast<size_t>(cqe.res) - header));
+        std::memcpy(&received.view.from, buf + sizeof(out), std::min<size_t>(out.namelen, sizeof(received.view.from)));
+        received.buffer_id = bid;
+        held_[bid] = 1;
+        ready_.push_back(received);
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+}
+
+int UringMediaIo::receive() {
+    views_.clear();
+    if (ring_fd_ < 0) {
+        return 0;
+    }
+
+    // The previous batch has been fanned out; its buffers go back to the
+    // kernel unless a copy from them is still in flight.
+    for (uint16_t bid : batch_buffers_) {
+        held_[bid] = 0;
+        if (inflight_[bid] == 0) {
+            recycle(bid);
+        }
+    }
+    batch_buffers_.clear();
+
+    if (ready_head_ == ready_.size()) {
+        ready_.clear();
+        ready_head_ = 0;
+        reap();
+    }
+    while (ready_head_ < ready_.size() && views_.size() < batch_size_) {
+        const Received& received = ready_[ready_head_++];
+        views_.push_back(received.view);
+        batch_buffers_.push_back(received.buffer_id);
+    }
+
+    publish_buffers();
+    if (!receive_armed_) {
+        arm_receive();
+        submit(0);
+    }
+
+    if (!views_.empty()) {
+        ++rx_stats_.recv_calls;
+        rx_stats_.recv_packets += views_.size();
+    }
+    return static_cast<int>(views_.size());
+}
+
+bool UringMediaIo::backlogged() const {
+    return ready_head_ < ready_.size();
+}
+
+void UringMediaIo::queue(SocketHandle socket, const uint8_t* data, int len, const sockaddr_in& to) {
+    const bool from_ring = ring_fd_ >= 0 && data >= buffers_ && data < buffers_ + buffers_size_;
+    if (from_ring && free_send_slots_.empty()) {
+        // Completions may be waiting behind newer receives; collect them,
+        // then give the kernel a moment to finish one if none were ready.
+        reap();
+        if (free_send_slots_.empty()) {
+            submit(1);
+            reap();
+        }
+    }
+    io_uring_sqe* sqe = (from_ring && !free_send_slots_.empty()) ? next_sqe() : nullptr;
+    if (!sqe) {
+        // Every slot is in flight: send this copy the plain way.
+        ++tx_stats_.send_calls;
+        if (sendto(socket, reinterpret_cast<const char*>(data), len, 0,
+                   reinterpret_cast<const sockaddr*>(&to), sizeof(to)) < 0) {
+            ++tx_stats_.send_errors;
+        } else {
+            ++tx_stats_.send_packets;
+        }
+        return;
+    }
+
+    const uint32_t index = free_send_slots_.back();
+    free_send_slots_.pop_back();
+    SendSlot& slot = send_slots_[index];
+    slot.to = to;
+    slot.iov.iov_base = const_cast<uint8_t*>(data);
+    slot.iov.iov_len = static_cast<size_t>(len);
+    slot.msg = msghdr{};
+    slot.msg.msg_name = &slot.to;
+    slot.msg.msg_namelen = sizeof(slot.to);
+    slot.msg.msg_iov = &slot.iov;
+    slot.msg.msg_iovlen = 1;
+    slot.buffer_id = static_cast<uint16_t>(static_cast<size_t>(data - buffers_) / buffer_size_);
+    ++inflight_[slot.buffer_id];
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = socket;
+    sqe->addr = reinterpret_cast<uint64_t>(&slot.msg);
+    sqe->len = 1;
+    sqe->user_data = index;
+    ++tx_stats_.send_packets;
+}
+
+int UringMediaIo::flush(SocketHandle socket) {
+    (void)socket;
+    if (ring_fd_ < 0 || sq_pending_ == 0) {
+        return 0;
+    }
+    const int queued = static_cast<int>(sq_pending_);
+    return submit(0) ? queued : 0;
+}
+
+#else
+
+UringMediaIo::~UringMediaIo() = default;
+
+bool UringMediaIo::open(SocketHandle socket, std::string& error) {
+    (void)socket;
+    error = "io_uring is not available on this platform";
+    return false;
+}
+
+int UringMediaIo::receive() {
+    views_.clear();
+    return 0;
+}
+
+bool UringMediaIo::backlogged() const {
+    return false;
+}
+
+void UringMediaIo::queue(SocketHandle socket, const uint8_t* data, int len, const sockaddr_in& to) {
+    (void)socket;
+    (void)data;
+    (void)len;
+    (void)to;
+}
+
+int UringMediaIo::flush(SocketHandle socket) {
+    (void)socket;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,133 @@
+// 📁 server/sfu/uring_io.h
+// IO_URING MEDIA BACKEND for the SFU (Linux 6.0+)
+// One multishot recvmsg stays armed on the audio socket and picks its
+// destination from a provided buffer ring registered with the kernel, so
+// datagrams land in preallocated, pre-faulted buffers without a receive
+// syscall. Fan-out copies are queued as sendmsg SQEs straight from those
+// buffers and submitted with one io_uring_enter per batch. A buffer goes back
+// to the ring once every copy sent from it has completed.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "sfu/batch_io.h"
+#include "sfu/sfu_socket.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_RECV_MULTISHOT
+#define NOX_SFU_HAS_URING 1
+#endif
+#endif
+#endif
+
+class UringMediaIo {
+public:
+    // `batch_size` caps the datagrams returned per receive(); `send_capacity`
+    // is the number of copies that may be in flight at once.
+    UringMediaIo(size_t batch_size, size_t send_capacity, size_t buffer_count, size_t buffer_size);
+    ~UringMediaIo();
+
+    UringMediaIo(const UringMediaIo&) = delete;
+    UringMediaIo& operator=(const UringMediaIo&) = delete;
+
+    // Sets up the ring, registers the buffer ring and arms the multishot
+    // receive on `socket`. Returns false, with the reason in `error`, when the
+    // kernel lacks any of it; the caller then stays on recvmmsg.
+    bool open(SocketHandle socket, std::string& error);
+
+    // Pollable descriptor: readable while completions are waiting.
+    int fd() const { return ring_fd_; }
+
+    // Reaps completions without a syscall. Returns the number of datagrams
+    // available through datagram(i); views stay valid until the next call.
+    int receive();
+    const Datagram& datagram(int index) const { return views_[static_cast<size_t>(index)]; }
+    // True while datagrams already reaped from the ring are waiting for a
+    // later receive(); the ring fd does not signal those.
+    bool backlogged() const;
+
+    // Same contract as BatchSender: `data` must point into a datagram from
+    // the current receive() batch.
+    void queue(SocketHandle socket, const uint8_t* data, int len, const sockaddr_in& to);
+    // Submits everything queued with a single io_uring_enter.
+    int flush(SocketHandle socket);
+
+    const BatchIoStats& rx_stats() const { return rx_stats_; }
+    const BatchIoStats& tx_stats() const { return tx_stats_; }
+
+private:
+#ifdef NOX_SFU_HAS_URING
+    struct Received {
+        Datagram view;
+        uint16_t buffer_id;
+    };
+
+    struct SendSlot {
+        msghdr msg{};
+        iovec iov{};
+        sockaddr_in to{};
+        uint16_t buffer_id = 0;
+    };
+
+    io_uring_sqe* next_sqe();
+    bool submit(unsigned wait_for);
+    void arm_receive();
+    void recycle(uint16_t buffer_id);
+    void publish_buffers();
+    void reap();
+    void complete_send(const io_uring_cqe& cqe);
+    void close_ring();
+
+    SocketHandle socket_ = INVALID_SOCKET;
+    // Submission and completion rings, shared with the kernel.
+    void* ring_mem_ = nullptr;
+    size_t ring_mem_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    unsigned* sq_flags_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned sq_local_tail_ = 0;
+    unsigned sq_pending_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned cq_mask_ = 0;
+
+    // Provided buffer ring and the buffers it hands out.
+    io_uring_buf* buf_ring_ = nullptr;
+    size_t buf_ring_size_ = 0;
+    uint8_t* buffers_ = nullptr;
+    size_t buffers_size_ = 0;
+    uint16_t buf_tail_ = 0;
+    bool buf_ring_registered_ = false;
+    std::vector<uint16_t> inflight_; // Per buffer: sends not yet completed
+    std::vector<uint8_t> held_;      // Per buffer: reaped but not yet released
+    std::vector<uint16_t> batch_buffers_;
+    // Datagrams reaped beyond the current batch, handed out by later calls.
+    std::vector<Received> ready_;
+    size_t ready_head_ = 0;
+
+    msghdr recv_msg_{};
+    bool receive_armed_ = false;
+
+    std::vector<SendSlot> send_slots_;
+    std::vector<uint32_t> free_send_slots_;
+#endif
+    int ring_fd_ = -1;
+    size_t batch_size_;
+    size_t send_capacity_;
+    size_t buffer_count_;
+    size_t buffer_size_;
+    std::vector<Datagram> views_;
+    BatchIoStats rx_stats_;
+    BatchIoStats tx_stats_;
+};
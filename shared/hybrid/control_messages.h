@@ -11,6 +11,10 @@ namespace hybridctrl {
 
 constexpr int kProtocolVersion = 2;
 
+// Source of the single stream a mixing server sends each listener in a
+// mixed room. Never assigned to a client.
+constexpr uint32_t kMixedSourceSsrc = 0xFFFFFFFEu;
+
 struct HelloRequest {
     QString clientName;
     quint16 udpPort = 0;
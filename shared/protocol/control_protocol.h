@@ -14,7 +14,24 @@ enum class CtrlType : uint8_t {
     LIST = 7,
     MUTE = 8,
     UNMUTE = 9,
-    SET_CHANNEL = 10
+    SET_CHANNEL = 10,
+    USER_DELTA = 11,    // Versioned presence changes (server -> client)
+    USER_SNAPSHOT = 12, // One fragment of the full presence list (reply to LIST)
+    TRUNK_USERS = 13    // SFU -> SFU: users attached to the sending node
+};
+
+// Control datagrams are kept below a conservative path MTU.
+constexpr uint16_t CTRL_MAX_DATAGRAM = 1200;
+
+enum class CtrlPresenceOp : uint8_t {
+    JOIN = 1,   // Add or replace the user
+    LEAVE = 2,  // Remove the user
+    UPDATE = 3  // Name or online state changed
+};
+
+enum class CtrlTrunkOp : uint8_t {
+    UPSERT = 1, // The user is attached to the sending node
+    REMOVE = 2  // The user left the sending node
 };
 
 #pragma pack(push, 1)
@@ -60,4 +77,53 @@ struct CtrlUserList {
     uint32_t count;
     // Followed by CtrlUserInfo[count]
 };
+
+// Optional PONG payload: lets clients notice missed USER_DELTAs.
+struct CtrlPong {
+    uint32_t presence_version;
+};
+
+struct CtrlUserChange {
+    CtrlPresenceOp op;
+    uint8_t reserved[3];
+    CtrlUserInfo user;
+};
+
+// Applies on top of `base_version` only; on any other local version the
+// client requests a snapshot. Changes are idempotent upserts/removals.
+struct CtrlUserDelta {
+    uint32_t base_version;
+    uint32_t version;
+    uint16_t count;
+    uint16_t reserved;
+    // Followed by CtrlUserChange[count]
+};
+
+struct CtrlUserSnapshot {
+    uint32_t version;
+    uint32_t total_users;
+    uint16_t fragment;
+    uint16_t fragment_count;
+    uint16_t count;
+    uint16_t reserved;
+    // Followed by CtrlUserInfo[count]
+};
+
+// Sent between SFU nodes every second (the full local user list, split
+// across datagrams) and whenever a local user joins, leaves or changes
+// channel. A node that hears nothing from a trunk for a few seconds drops
+// the users it learned from it, so lost datagrams only delay changes.
+struct CtrlTrunkUsers {
+    uint32_t node_id;
+    uint16_t audio_port; // Where the sender accepts relayed audio
+    uint16_t count;
+    // Followed by CtrlTrunkUser[count]
+};
+
+struct CtrlTrunkUser {
+    CtrlTrunkOp op;
+    uint8_t reserved[3];
+    uint32_t channel_id; // 0xFFFFFFFF = none
+    CtrlUserInfo user;
+};
 #pragma pack(pop)
@@ -2,13 +2,11 @@
 
 #include <QJsonArray>
 
+#include <cstring>
+
 #include "control_protocol.h"
 #include "protobuf_control_codec.h"
 
-#if defined(NOX_HAS_PROTOBUF_CONTROL)
-#include "control.pb.h"
-#endif
-
 namespace {
 
 #if defined(NOX_HAS_PROTOBUF_CONTROL)
@@ -32,6 +30,18 @@ QJsonArray to_json_array(const google::protobuf::RepeatedField<uint32_t> &arr) {
     return out;
 }
 
+// Serialized in place behind the frame prefix; no intermediate string.
+QByteArray serialize_framed(const nox::control::v1::ControlEnvelope &env) {
+    constexpr int kPrefixLen = static_cast<int>(sizeof(protobufctrl::kPrefix) - 1);
+    const size_t size = env.ByteSizeLong();
+    QByteArray out(kPrefixLen + static_cast<int>(size), Qt::Uninitialized);
+    std::memcpy(out.data(), protobufctrl::kPrefix, kPrefixLen);
+    if (!env.SerializeToArray(out.data() + kPrefixLen, static_cast<int>(size))) {
+        return QByteArray{};
+    }
+    return out;
+}
+
 bool json_to_envelope(const QJsonObject &obj, nox::control::v1::ControlEnvelope &env) {
     const QString type = obj.value(QStringLiteral("type")).toString();
     if (type == QStringLiteral("hello")) {
@@ -76,7 +86,9 @@ bool json_to_envelope(const QJsonObject &obj, nox::control::v1::ControlEnvelope
         for (uint32_t s : sources) {
             m->add_sources(s);
         }
-        m->set_max_streams(static_cast<uint32_t>(obj.value(QStringLiteral("max_streams")).toInt(4)));
+        if (obj.contains(QStringLiteral("max_streams"))) {
+            m->set_max_streams(static_cast<uint32_t>(obj.value(QStringLiteral("max_streams")).toInt(0)));
+        }
         m->set_filter_enabled(obj.value(QStringLiteral("filter_enabled")).toBool(false));
         m->set_preferred_layer(obj.value(QStringLiteral("preferred_layer")).toString().toStdString());
         return true;
@@ -102,6 +114,14 @@ bool json_to_envelope(const QJsonObject &obj, nox::control::v1::ControlEnvelope
         m->set_rtt_ms(static_cast<uint32_t>(obj.value(QStringLiteral("rtt_ms")).toInt(0)));
         return true;
     }
+    if (type == QStringLiteral("nack")) {
+        auto *m = env.mutable_nack();
+        m->set_source_client_id(static_cast<uint32_t>(obj.value(QStringLiteral("source_ssrc")).toDouble(0)));
+        m->set_layer(static_cast<uint32_t>(obj.value(QStringLiteral("layer")).toInt(0)));
+        m->set_sequence(static_cast<uint32_t>(obj.value(QStringLiteral("seq")).toInt(0)));
+        m->set_mask(static_cast<uint32_t>(obj.value(QStringLiteral("mask")).toInt(0)));
+        return true;
+    }
     if (type == QStringLiteral("list")) {
         env.mutable_list_users();
         return true;
@@ -164,7 +184,9 @@ bool envelope_to_json(const nox::control::v1::ControlEnvelope &env, QJsonObject
         out.insert(QStringLiteral("type"), QStringLiteral("subscribe"));
         out.insert(QStringLiteral("ssrc"), static_cast<double>(env.subscribe().client_id()));
         out.insert(QStringLiteral("sources"), to_json_array(env.subscribe().sources()));
-        out.insert(QStringLiteral("max_streams"), static_cast<int>(env.subscribe().max_streams()));
+        if (env.subscribe().has_max_streams()) {
+            out.insert(QStringLiteral("max_streams"), static_cast<int>(env.subscribe().max_streams()));
+        }
         out.insert(QStringLiteral("filter_enabled"), env.subscribe().filter_enabled());
         out.insert(QStringLiteral("preferred_layer"), QString::fromStdString(env.subscribe().preferred_layer()));
         return true;
@@ -190,6 +212,14 @@ bool envelope_to_json(const nox::control::v1::ControlEnvelope &env, QJsonObject
         out.insert(QStringLiteral("rtt_ms"), static_cast<int>(env.voice_feedback().rtt_ms()));
         return true;
     }
+    case ControlEnvelope::kNack: {
+        out.insert(QStringLiteral("type"), QStringLiteral("nack"));
+        out.insert(QStringLiteral("source_ssrc"), static_cast<double>(env.nack().source_client_id()));
+        out.insert(QStringLiteral("layer"), static_cast<int>(env.nack().layer()));
+        out.insert(QStringLiteral("seq"), static_cast<int>(env.nack().sequence()));
+        out.insert(QStringLiteral("mask"), static_cast<int>(env.nack().mask()));
+        return true;
+    }
     case ControlEnvelope::kListUsers: {
         out.insert(QStringLiteral("type"), QStringLiteral("list"));
         return true;
@@ -225,9 +255,9 @@ QByteArray encode(const QJsonObject &obj, ControlWireFormat preferred) {
     if (preferred == ControlWireFormat::Protobuf) {
         nox::control::v1::ControlEnvelope env;
         if (json_to_envelope(obj, env)) {
-            std::string payload;
-            if (env.SerializeToString(&payload)) {
-                return protobufctrl::with_prefix(QByteArray::fromStdString(payload));
+            const QByteArray framed = serialize_framed(env);
+            if (!framed.isEmpty()) {
+                return framed;
             }
         }
     }
@@ -263,4 +293,39 @@ bool decode(const QByteArray &line, ControlWireMessage &out) {
     return true;
 }
 
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+bool decode(const QByteArray &line, nox::control::v1::ControlEnvelope &out, ControlWireFormat &format) {
+    if (protobufctrl::is_protobuf_framed(line)) {
+        constexpr int kPrefixLen = static_cast<int>(sizeof(protobufctrl::kPrefix) - 1);
+        format = ControlWireFormat::Protobuf;
+        return out.ParseFromArray(line.constData() + kPrefixLen, line.size() - kPrefixLen);
+    }
+    QJsonObject decoded;
+    if (!ctrlproto::decode(line, decoded)) {
+        return false;
+    }
+    format = ControlWireFormat::Json;
+    return json_to_envelope(decoded, out);
+}
+
+QByteArray encode(const nox::control::v1::ControlEnvelope &env, ControlWireFormat format) {
+    if (format == ControlWireFormat::Protobuf) {
+        return serialize_framed(env);
+    }
+    QJsonObject obj;
+    if (!envelope_to_json(env, obj)) {
+        return QByteArray{};
+    }
+    return ctrlproto::encode(obj);
+}
+
+bool from_json(const QJsonObject &obj, nox::control::v1::ControlEnvelope &env) {
+    return json_to_envelope(obj, env);
+}
+
+bool to_json(const nox::control::v1::ControlEnvelope &env, QJsonObject &out) {
+    return envelope_to_json(env, out);
+}
+#endif
+
 } // namespace controlwire
@@ -3,6 +3,10 @@
 #include <QByteArray>
 #include <QJsonObject>
 
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+#include "control.pb.h"
+#endif
+
 enum class ControlWireFormat {
     Json = 0,
     Protobuf = 1,
@@ -18,5 +22,18 @@ namespace controlwire {
 QByteArray encode(const QJsonObject &obj, ControlWireFormat preferred = ControlWireFormat::Json);
 bool decode(const QByteArray &line, ControlWireMessage &out);
 
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+// Typed path: protobuf lines are parsed straight into `out`, and JSON lines
+// are converted into it, so callers dispatch on payload_case() whatever the
+// peer sent. `out` may live on an arena.
+bool decode(const QByteArray &line, nox::control::v1::ControlEnvelope &out, ControlWireFormat &format);
+QByteArray encode(const nox::control::v1::ControlEnvelope &env, ControlWireFormat format);
+
+// The JSON compatibility codec. Both return false for message types the
+// envelope has no field for.
+bool from_json(const QJsonObject &obj, nox::control::v1::ControlEnvelope &env);
+bool to_json(const nox::control::v1::ControlEnvelope &env, QJsonObject &out);
+#endif
+
 } // namespace controlwire
 
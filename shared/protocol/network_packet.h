@@ -2,6 +2,9 @@
 // RTP-LIKE PACKET STRUCTURE (Packed binary format)
 #pragma once
 
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include "constants.h"
 
@@ -12,8 +15,9 @@ struct AudioPacket {
     uint16_t seq;                       // Sequence number (for reordering)
     uint32_t timestamp;                 // RTP timestamp (sample-based)
     uint16_t payload_len;               // Actual payload size
-    uint8_t  flags;                     // Bit 0: positional data present
-    uint8_t  reserved[3];               // Alignment / future use
+    uint8_t  flags;                     // AUDIO_FLAG_* bits
+    uint8_t  audio_level;               // RFC 6464 style, valid with AUDIO_FLAG_AUDIO_LEVEL
+    uint8_t  reserved[2];               // Alignment / future use
     float    position[3];               // Positional audio (x,y,z) in meters
     uint8_t  payload[OPUS_MAX_PAYLOAD]; // Opus-encoded audio data
 };
@@ -24,3 +28,33 @@ static_assert(sizeof(AudioPacket) == 28 + OPUS_MAX_PAYLOAD,
               "AudioPacket size mismatch");
 
 constexpr uint8_t AUDIO_FLAG_POSITIONAL = 1 << 0;
+constexpr uint8_t AUDIO_FLAG_AUDIO_LEVEL = 1 << 1;
+
+// audio_level byte, as in the RFC 6464 header extension: bit 7 is the
+// sender's voice activity decision, bits 0-6 the frame level in -dBov
+// (0 = full scale, 127 = digital silence).
+constexpr uint8_t AUDIO_LEVEL_VOICE = 0x80;
+constexpr uint8_t AUDIO_LEVEL_MASK = 0x7F;
+constexpr uint8_t AUDIO_LEVEL_SILENT = 127;
+
+// RMS level of one PCM16 frame in -dBov, 0..127.
+inline uint8_t audio_level_dbov(const int16_t* pcm, size_t samples) {
+    if (!pcm || samples == 0) {
+        return AUDIO_LEVEL_SILENT;
+    }
+    double energy = 0.0;
+    for (size_t i = 0; i < samples; ++i) {
+        const double s = static_cast<double>(pcm[i]) / 32768.0;
+        energy += s * s;
+    }
+    const double mean = energy / static_cast<double>(samples);
+    if (mean <= 0.0) {
+        return AUDIO_LEVEL_SILENT;
+    }
+    const double dbov = -10.0 * std::log10(mean);
+    return static_cast<uint8_t>(std::lround(std::min(static_cast<double>(AUDIO_LEVEL_SILENT), std::max(0.0, dbov))));
+}
+
+inline uint8_t make_audio_level(uint8_t dbov, bool voice) {
+    return static_cast<uint8_t>((dbov & AUDIO_LEVEL_MASK) | (voice ? AUDIO_LEVEL_VOICE : 0));
+}
@@ -18,7 +18,8 @@ HEADERS += \
     $$PWD/protocol/VolumeAdjustment.h \
     $$PWD/utils/ByteBuffer.h \
     $$PWD/utils/Logger.h \
-    $$PWD/utils/Timer.h
+    $$PWD/utils/Timer.h \
+    $$PWD/utils/TimerWheel.h
 
 SOURCES += \
     $$PWD/protocol/AudioPacket.cpp \
@@ -27,7 +28,8 @@ SOURCES += \
     $$PWD/protocol/VolumeAdjustment.cpp \
     $$PWD/utils/ByteBuffer.cpp \
     $$PWD/utils/Logger.cpp \
-    $$PWD/utils/Timer.cpp
+    $$PWD/utils/Timer.cpp \
+    $$PWD/utils/TimerWheel.cpp
 
 PUBLIC_HEADERS += \
     $$PWD/protocol/AudioPacket.h \
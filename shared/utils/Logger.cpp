@@ -1,18 +1,383 @@
 #include "utils/Logger.h"
-#include <iostream>
 
-void Logger::log(Level level, const std::string& msg) {
-    const char* prefix = "";
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+std::atomic<int> Logger::runtime_level_{VOIP_LOG_MIN_LEVEL};
+
+namespace {
+
+constexpr size_t kRingCapacity = 4096; // Records; a power of two
+constexpr size_t kMaxFields = 8;
+constexpr size_t kTextBytes = 160;     // Tag, message and string values
+
+struct StoredField {
+    const char* key;
+    LogField::Type type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        uint16_t text; // Offset into LogRecord::text for Str
+    } value;
+};
+
+struct LogRecord {
+    uint64_t time_us = 0;
+    Logger::Level level = Logger::Level::Info;
+    uint8_t field_count = 0;
+    uint16_t message = 0; // Offset into text; the tag, if any, is at 0
+    bool has_tag = false;
+    uint32_t suppressed = 0;
+    StoredField fields[kMaxFields];
+    char text[kTextBytes];
+};
+
+// Bounded multi-producer queue (Vyukov). A producer claims a cell with one
+// CAS, fills it in place and publishes it by bumping the cell's sequence;
+// nobody waits on anybody, and a full ring is reported rather than waited
+// out. Consumers are serialized by the caller.
+class RecordRing {
+public:
+    RecordRing() : cells_(new Cell[kRingCapacity]) {
+        for (size_t i = 0; i < kRingCapacity; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    LogRecord* claim(size_t& ticket) {
+        size_t pos = enqueue_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & kMask];
+            const size_t seq = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    ticket = pos;
+                    return &cell.record;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void publish(size_t ticket) {
+        cells_[ticket & kMask].sequence.store(ticket + 1, std::memory_order_release);
+    }
+
+    // Consumer side.
+    bool ready() const {
+        return cells_[dequeue_ & kMask].sequence.load(std::memory_order_acquire) == dequeue_ + 1;
+    }
+
+    // Consumer side; `visit` sees the record in place before the cell is
+    // handed back to producers.
+    template <typename Visit>
+    bool pop(Visit&& visit) {
+        Cell& cell = cells_[dequeue_ & kMask];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeue_ + 1) {
+            return false;
+        }
+        visit(cell.record);
+        cell.sequence.store(dequeue_ + kRingCapacity, std::memory_order_release);
+        ++dequeue_;
+        return true;
+    }
+
+private:
+    static constexpr size_t kMask = kRingCapacity - 1;
+
+    struct Cell {
+        std::atomic<size_t> sequence{0};
+        LogRecord record;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<size_t> enqueue_{0};
+    alignas(64) size_t dequeue_ = 0;
+};
+
+const char* level_letter(Logger::Level level) {
     switch (level) {
-        case Level::Debug: prefix = "[DEBUG] "; break;
-        case Level::Info:  prefix = "[INFO] "; break;
-        case Level::Warn:  prefix = "[WARN] "; break;
-        case Level::Error: prefix = "[ERROR] "; break;
+        case Logger::Level::Debug: return "D";
+        case Logger::Level::Info:  return "I";
+        case Logger::Level::Warn:  return "W";
+        case Logger::Level::Error: return "E";
+    }
+    return "?";
+}
+
+uint64_t wall_clock_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Copies `s` into the record's text area and returns its offset; truncates
+// once the area is full.
+uint16_t store_text(LogRecord& record, size_t& used, const char* s) {
+    const uint16_t offset = static_cast<uint16_t>(used);
+    if (used >= kTextBytes) {
+        return static_cast<uint16_t>(kTextBytes - 1);
+    }
+    const size_t room = kTextBytes - used - 1;
+    size_t len = s ? std::strlen(s) : 0;
+    if (len > room) {
+        len = room;
+    }
+    if (len > 0) {
+        std::memcpy(record.text + used, s, len);
+    }
+    record.text[used + len] = '\0';
+    used += len + 1;
+    return offset;
+}
+
+void append_value(std::string& out, const char* s) {
+    const bool quote = *s == '\0' || std::strpbrk(s, " =\"") != nullptr;
+    if (quote) {
+        out += '"';
+    }
+    out += s;
+    if (quote) {
+        out += '"';
+    }
+}
+
+void format_record(const LogRecord& record, std::string& out) {
+    char buffer[64];
+    const uint64_t seconds = record.time_us / 1000000;
+    std::snprintf(buffer, sizeof(buffer), "%02u:%02u:%02u.%06u %s ",
+                  static_cast<unsigned>((seconds / 3600) % 24), static_cast<unsigned>((seconds / 60) % 60),
+                  static_cast<unsigned>(seconds % 60), static_cast<unsigned>(record.time_us % 1000000),
+                  level_letter(record.level));
+    out += buffer;
+    if (record.has_tag) {
+        out += '[';
+        out += record.text;
+        out += "] ";
+    }
+    out += record.text + record.message;
+
+    for (uint8_t i = 0; i < record.field_count; ++i) {
+        const StoredField& field = record.fields[i];
+        out += ' ';
+        out += field.key;
+        out += '=';
+        switch (field.type) {
+            case LogField::Type::Int:
+                std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(field.value.i));
+                out += buffer;
+                break;
+            case LogField::Type::Uint:
+                std::snprintf(buffer, sizeof(buffer), "%llu", static_cast<unsigned long long>(field.value.u));
+                out += buffer;
+                break;
+            case LogField::Type::Double:
+                std::snprintf(buffer, sizeof(buffer), "%g", field.value.d);
+                out += buffer;
+                break;
+            case LogField::Type::Bool:
+                out += field.value.u ? "true" : "false";
+                break;
+            case LogField::Type::Str:
+                append_value(out, record.text + field.value.text);
+                break;
+        }
+    }
+    if (record.suppressed > 0) {
+        std::snprintf(buffer, sizeof(buffer), " (suppressed %u)", record.suppressed);
+        out += buffer;
+    }
+    out += '\n';
+}
+
+class LogState {
+public:
+    LogState() : flusher_([this]() { run(); }) {}
+
+    ~LogState() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stop_.store(true, std::memory_order_relaxed);
+        }
+        wake_.notify_one();
+        flusher_.join();
+        drain();
+    }
+
+    RecordRing ring;
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<FILE*> sink{stderr};
+
+    // Producers, after publishing. Only the record that finds the flusher
+    // asleep pays for the lock and the notify.
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping_.load(std::memory_order_relaxed) && sleeping_.exchange(false, std::memory_order_acq_rel)) {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            wake_.notify_one();
+        }
+    }
+
+    // Writes out everything published so far. Returns the records written.
+    size_t drain() {
+        std::lock_guard<std::mutex> lock(consumer_mutex_);
+        out_.clear();
+        size_t count = 0;
+        while (ring.pop([this](const LogRecord& record) { format_record(record, out_); })) {
+            ++count;
+        }
+        const uint64_t lost = dropped.exchange(0, std::memory_order_relaxed);
+        if (lost > 0) {
+            char buffer[96];
+            std::snprintf(buffer, sizeof(buffer), "[Logger] ring full, dropped %llu record(s)\n",
+                          static_cast<unsigned long long>(lost));
+            out_ += buffer;
+        }
+        if (!out_.empty()) {
+            FILE* target = sink.load(std::memory_order_relaxed);
+            std::fwrite(out_.data(), 1, out_.size(), target);
+            std::fflush(target);
+        }
+        return count;
+    }
+
+private:
+    // Sleeps while the ring is empty, so an idle process never wakes for
+    // logging.
+    void run() {
+        while (!stop_.load(std::memory_order_relaxed)) {
+            if (drain() > 0) {
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            sleeping_.store(true, std::memory_order_relaxed);
+            // Pairs with the fence in notify(): either the producer sees the
+            // flag, or its record is seen here.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (pending()) {
+                sleeping_.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            wake_.wait(lock, [this]() {
+                return !sleeping_.load(std::memory_order_relaxed) || stop_.load(std::memory_order_relaxed);
+            });
+        }
+    }
+
+    bool pending() {
+        std::lock_guard<std::mutex> lock(consumer_mutex_);
+        return ring.ready();
+    }
+
+    std::mutex consumer_mutex_;
+    std::string out_;
+    std::atomic<bool> stop_{false};
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> sleeping_{false};
+    std::thread flusher_; // Last: starts once everything above exists
+};
+
+LogState& state() {
+    static LogState instance;
+    return instance;
+}
+
+void enqueue(uint32_t suppressed, Logger::Level level, const char* tag, const char* message,
+             std::initializer_list<LogField> fields) {
+    LogState& log = state();
+    size_t ticket = 0;
+    LogRecord* record = log.ring.claim(ticket);
+    if (!record) {
+        log.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    record->time_us = wall_clock_us();
+    record->level = level;
+    record->suppressed = suppressed;
+    size_t used = 0;
+    record->has_tag = tag != nullptr;
+    if (tag) {
+        store_text(*record, used, tag);
+    }
+    record->message = store_text(*record, used, message);
+
+    uint8_t count = 0;
+    for (const LogField& field : fields) {
+        if (count == kMaxFields) {
+            break;
+        }
+        StoredField& stored = record->fields[count++];
+        stored.key = field.key;
+        stored.type = field.type;
+        switch (field.type) {
+            case LogField::Type::Int:    stored.value.i = field.value.i; break;
+            case LogField::Type::Uint:
+            case LogField::Type::Bool:   stored.value.u = field.value.u; break;
+            case LogField::Type::Double: stored.value.d = field.value.d; break;
+            case LogField::Type::Str:    stored.value.text = store_text(*record, used, field.value.s); break;
+        }
+    }
+    record->field_count = count;
+    log.ring.publish(ticket);
+    log.notify();
+}
+
+} // namespace
+
+bool LogRateLimiter::allow(uint32_t& suppressed) {
+    const uint64_t window = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    uint64_t current = window_.load(std::memory_order_relaxed);
+    if (current != window && window_.compare_exchange_strong(current, window, std::memory_order_relaxed)) {
+        count_.store(0, std::memory_order_relaxed);
+    }
+    if (count_.fetch_add(1, std::memory_order_relaxed) < per_second_) {
+        suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+        return true;
+    }
+    suppressed_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Logger::log(Level level, const std::string& msg) {
+    if (enabled(level)) {
+        enqueue(0, level, nullptr, msg.c_str(), {});
     }
-    std::cerr << prefix << msg << std::endl;
 }
 
 void Logger::debug(const std::string& msg) { log(Level::Debug, msg); }
 void Logger::info(const std::string& msg) { log(Level::Info, msg); }
 void Logger::warn(const std::string& msg) { log(Level::Warn, msg); }
 void Logger::error(const std::string& msg) { log(Level::Error, msg); }
+
+void Logger::write(Level level, const char* tag, const char* message, std::initializer_list<LogField> fields) {
+    enqueue(0, level, tag, message, fields);
+}
+
+void Logger::write(uint32_t suppressed, Level level, const char* tag, const char* message,
+                   std::initializer_list<LogField> fields) {
+    enqueue(suppressed, level, tag, message, fields);
+}
+
+void Logger::set_level(Level level) {
+    runtime_level_.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void Logger::set_sink(FILE* sink) {
+    state().sink.store(sink ? sink : stderr, std::memory_order_relaxed);
+}
+
+void Logger::flush() {
+    state().drain();
+}
@@ -1,7 +1,75 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
 #include <string>
+#include <type_traits>
 
+// Records below this level compile to nothing when logged through the
+// VOIP_LOG_* macros (0 = Debug, 1 = Info, 2 = Warn, 3 = Error).
+#ifndef VOIP_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define VOIP_LOG_MIN_LEVEL 1
+#else
+#define VOIP_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+// One key=value pair of a structured record. Numbers are stored as-is and
+// only formatted on the flusher thread; strings are copied into the record
+// when it is queued, so the caller's buffer may go away immediately.
+struct LogField {
+    enum class Type : uint8_t { Int, Uint, Double, Bool, Str };
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value &&
+                                                      !std::is_same<T, bool>::value, int>::type = 0>
+    LogField(const char* k, T v) : key(k), type(Type::Int) { value.i = v; }
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value &&
+                                                      !std::is_same<T, bool>::value, int>::type = 0>
+    LogField(const char* k, T v) : key(k), type(Type::Uint) { value.u = v; }
+
+    LogField(const char* k, double v) : key(k), type(Type::Double) { value.d = v; }
+    LogField(const char* k, bool v) : key(k), type(Type::Bool) { value.u = v ? 1 : 0; }
+    LogField(const char* k, const char* v) : key(k), type(Type::Str) { value.s = v ? v : ""; }
+    LogField(const char* k, const std::string& v) : key(k), type(Type::Str) { value.s = v.c_str(); }
+
+    const char* key; // Must outlive the process's logging (a literal)
+    Type type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const char* s;
+    } value;
+};
+
+// Lets one call site through at most `per_second` times a second. Calls it
+// turns away are counted and attached to the next record it lets through.
+class LogRateLimiter {
+public:
+    explicit LogRateLimiter(uint32_t per_second) : per_second_(per_second) {}
+
+    // Returns true when the caller may log; `suppressed` receives the number
+    // of calls dropped since the last one allowed.
+    bool allow(uint32_t& suppressed);
+
+private:
+    uint32_t per_second_;
+    std::atomic<uint64_t> window_{0};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<uint32_t> suppressed_{0};
+};
+
+// Asynchronous logger. Producers format nothing and never block: a record
+// is a fixed-size struct claimed from a lock-free ring, and a background
+// thread turns queued records into text and writes them in batches. When the
+// ring is full the record is dropped and counted instead of stalling the
+// caller. Tag, message and string fields share 160 bytes per record and are
+// truncated past that.
 class Logger {
 public:
     enum class Level { Debug, Info, Warn, Error };
@@ -11,4 +79,62 @@ public:
     static void info(const std::string& msg);
     static void warn(const std::string& msg);
     static void error(const std::string& msg);
+
+    // Queues a structured record. `tag` and `message` are copied; field keys
+    // must be string literals.
+    static void write(Level level, const char* tag, const char* message,
+                      std::initializer_list<LogField> fields = {});
+    // As above, noting that `suppressed` earlier records were rate limited.
+    static void write(uint32_t suppressed, Level level, const char* tag, const char* message,
+                      std::initializer_list<LogField> fields = {});
+
+    // Records below `level` are discarded at the call (on top of the
+    // compile-time VOIP_LOG_MIN_LEVEL cut).
+    static void set_level(Level level);
+    static bool enabled(Level level) {
+        return static_cast<int>(level) >= runtime_level_.load(std::memory_order_relaxed);
+    }
+
+    // Where the flusher writes; stderr by default.
+    static void set_sink(FILE* sink);
+
+    // Blocks until everything queued before the call has been written.
+    static void flush();
+
+private:
+    static std::atomic<int> runtime_level_;
 };
+
+#define VOIP_LOG_AT(level, ...)                                                        \
+    do {                                                                               \
+        if constexpr (static_cast<int>(level) >= VOIP_LOG_MIN_LEVEL) {                 \
+            if (::Logger::enabled(level)) {                                            \
+                ::Logger::write(level, __VA_ARGS__);                                   \
+            }                                                                          \
+        }                                                                              \
+    } while (0)
+
+// Same, but this call site emits at most `per_second` records a second.
+#define VOIP_LOG_RATE_AT(level, per_second, ...)                                       \
+    do {                                                                               \
+        if constexpr (static_cast<int>(level) >= VOIP_LOG_MIN_LEVEL) {                 \
+            if (::Logger::enabled(level)) {                                            \
+                static ::LogRateLimiter voip_log_limiter_(per_second);                 \
+                uint32_t voip_log_suppressed_ = 0;                                     \
+                if (voip_log_limiter_.allow(voip_log_suppressed_)) {                   \
+                    ::Logger::write(voip_log_suppressed_, level, __VA_ARGS__);         \
+                }                                                                      \
+            }                                                                          \
+        }                                                                              \
+    } while (0)
+
+// Usage: VOIP_LOG_DEBUG("RX-JB", "popped", {{"len", n}, {"buffered", depth}});
+#define VOIP_LOG_DEBUG(...) VOIP_LOG_AT(::Logger::Level::Debug, __VA_ARGS__)
+#define VOIP_LOG_INFO(...) VOIP_LOG_AT(::Logger::Level::Info, __VA_ARGS__)
+#define VOIP_LOG_WARN(...) VOIP_LOG_AT(::Logger::Level::Warn, __VA_ARGS__)
+#define VOIP_LOG_ERROR(...) VOIP_LOG_AT(::Logger::Level::Error, __VA_ARGS__)
+
+#define VOIP_LOG_DEBUG_RATE(per_second, ...) VOIP_LOG_RATE_AT(::Logger::Level::Debug, per_second, __VA_ARGS__)
+#define VOIP_LOG_INFO_RATE(per_second, ...) VOIP_LOG_RATE_AT(::Logger::Level::Info, per_second, __VA_ARGS__)
+#define VOIP_LOG_WARN_RATE(per_second, ...) VOIP_LOG_RATE_AT(::Logger::Level::Warn, per_second, __VA_ARGS__)
+#define VOIP_LOG_ERROR_RATE(per_second, ...) VOIP_LOG_RATE_AT(::Logger::Level::Error, per_second, __VA_ARGS__)
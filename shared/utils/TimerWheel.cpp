@@ -0,0 +1,144 @@
+#include "utils/TimerWheel.h"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(uint64_t tick_ms, uint64_t now_ms)
+    : tick_ms_(std::max<uint64_t>(1, tick_ms)),
+      next_tick_(now_ms / tick_ms_ + 1) {
+    heads_.fill(kNil);
+}
+
+void TimerWheel::arm(Key key, uint64_t deadline_ms) {
+    // Round up so a deadline never fires before it has passed.
+    const uint64_t deadline_tick = (deadline_ms + tick_ms_ - 1) / tick_ms_;
+
+    uint32_t id;
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        id = it->second;
+        if (entries_[id].deadline_tick == deadline_tick) {
+            return;
+        }
+        unlink(id);
+    } else {
+        if (!free_.empty()) {
+            id = free_.back();
+            free_.pop_back();
+        } else {
+            id = static_cast<uint32_t>(entries_.size());
+            entries_.emplace_back();
+        }
+        index_.emplace(key, id);
+        entries_[id].key = key;
+    }
+    entries_[id].deadline_tick = deadline_tick;
+    place(id, next_tick_);
+}
+
+bool TimerWheel::cancel(Key key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        return false;
+    }
+    const uint32_t id = it->second;
+    index_.erase(it);
+    unlink(id);
+    release(id);
+    return true;
+}
+
+size_t TimerWheel::advance(uint64_t now_ms, std::vector<Key>& expired) {
+    const uint64_t now_tick = now_ms / tick_ms_;
+    const size_t before = expired.size();
+
+    while (next_tick_ <= now_tick) {
+        if (index_.empty()) {
+            // Nothing can come due; skip the idle stretch in one step.
+            next_tick_ = now_tick + 1;
+            break;
+        }
+
+        const uint64_t tick = next_tick_;
+        // Crossing a level boundary redistributes the matching slot of the
+        // level above; entries due within the span below never land back in
+        // a slot that was just emptied.
+        for (unsigned level = 1; level < kLevels; ++level) {
+            if ((tick & ((uint64_t{1} << (kSlotBits * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level, tick);
+        }
+
+        const uint32_t bucket = static_cast<uint32_t>(tick & kSlotMask);
+        uint32_t id = heads_[bucket];
+        heads_[bucket] = kNil;
+        while (id != kNil) {
+            const uint32_t next = entries_[id].next;
+            expired.push_back(entries_[id].key);
+            index_.erase(entries_[id].key);
+            release(id);
+            id = next;
+        }
+        ++next_tick_;
+    }
+    return expired.size() - before;
+}
+
+void TimerWheel::place(uint32_t id, uint64_t base_tick) {
+    const uint64_t deadline = std::max(entries_[id].deadline_tick, base_tick);
+    uint64_t delta = deadline - base_tick;
+
+    unsigned level = 0;
+    while (level + 1 < kLevels && delta >= (uint64_t{1} << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    // Past the top level's span the entry parks in its furthest slot and is
+    // re-placed when that slot cascades.
+    uint64_t slot_tick = deadline;
+    const uint64_t span = uint64_t{1} << (kSlotBits * kLevels);
+    if (delta >= span) {
+        slot_tick = base_tick + span - 1;
+    }
+    const uint32_t slot = static_cast<uint32_t>((slot_tick >> (kSlotBits * level)) & kSlotMask);
+    link(id, level * kSlots + slot);
+}
+
+void TimerWheel::cascade(unsigned level, uint64_t tick) {
+    const uint32_t bucket = level * kSlots + static_cast<uint32_t>((tick >> (kSlotBits * level)) & kSlotMask);
+    uint32_t id = heads_[bucket];
+    heads_[bucket] = kNil;
+    while (id != kNil) {
+        const uint32_t next = entries_[id].next;
+        place(id, tick);
+        id = next;
+    }
+}
+
+void TimerWheel::link(uint32_t id, uint32_t bucket) {
+    Entry& e = entries_[id];
+    e.bucket = bucket;
+    e.prev = kNil;
+    e.next = heads_[bucket];
+    if (e.next != kNil) {
+        entries_[e.next].prev = id;
+    }
+    heads_[bucket] = id;
+}
+
+void TimerWheel::unlink(uint32_t id) {
+    Entry& e = entries_[id];
+    if (e.prev != kNil) {
+        entries_[e.prev].next = e.next;
+    } else {
+        heads_[e.bucket] = e.next;
+    }
+    if (e.next != kNil) {
+        entries_[e.next].prev = e.prev;
+    }
+    e.prev = e.next = e.bucket = kNil;
+}
+
+void TimerWheel::release(uint32_t id) {
+    entries_[id] = Entry{};
+    free_.push_back(id);
+}
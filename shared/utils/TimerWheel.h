@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Hierarchical timing wheel for per-key deadlines (peer liveness and the
+// like). Arming, re-arming and cancelling a key are O(1); advance() only
+// visits the slots for ticks that have elapsed plus the entries actually due,
+// instead of sweeping every key. Deadlines are never reported early, and at
+// most one tick late. Not thread-safe: arm and advance from a single thread.
+class TimerWheel {
+public:
+    using Key = uint64_t;
+
+    // `now_ms` is the wheel's starting time, on the same clock as every
+    // deadline and advance() call that follows.
+    TimerWheel(uint64_t tick_ms, uint64_t now_ms);
+
+    // Schedules `key` to expire at `deadline_ms`, replacing any earlier
+    // deadline for the same key. Deadlines at or before the last tick
+    // advance() processed go into the next tick's slot, so they fire on
+    // the first advance() that reaches the next tick boundary, which is not
+    // necessarily the next call.
+    void arm(Key key, uint64_t deadline_ms);
+    bool cancel(Key key);
+    bool armed(Key key) const { return index_.count(key) != 0; }
+    size_t size() const { return index_.size(); }
+
+    // Moves the wheel to `now_ms` and appends every key whose deadline has
+    // passed to `expired`. Expired keys are disarmed before they are
+    // returned, so the caller may re-arm them freely.
+    size_t advance(uint64_t now_ms, std::vector<Key>& expired);
+
+private:
+    static constexpr unsigned kSlotBits = 6;
+    static constexpr unsigned kSlots = 1u << kSlotBits;
+    static constexpr unsigned kSlotMask = kSlots - 1;
+    static constexpr unsigned kLevels = 4;
+    static constexpr uint32_t kNil = 0xFFFFFFFFu;
+
+    struct Entry {
+        Key key = 0;
+        uint64_t deadline_tick = 0;
+        uint32_t prev = kNil;
+        uint32_t next = kNil;
+        uint32_t bucket = kNil;
+    };
+
+    void place(uint32_t id, uint64_t base_tick);
+    void link(uint32_t id, uint32_t bucket);
+    void unlink(uint32_t id);
+    void release(uint32_t id);
+    void cascade(unsigned level, uint64_t tick);
+
+    uint64_t tick_ms_;
+    uint64_t next_tick_; // First tick not yet processed
+    std::array<uint32_t, kLevels * kSlots> heads_;
+    std::vector<Entry> entries_;
+    std::vector<uint32_t> free_;
+    std::unordered_map<Key, uint32_t> index_;
+};
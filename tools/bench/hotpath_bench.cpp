@@ -0,0 +1,725 @@
+// 📁 tools/bench/hotpath_bench.cpp
+// HOT-PATH BENCHMARKS
+// Times the code that runs per packet or per audio frame: jitter buffers,
+// permission checks, forwarding selection, control-message codecs, Opus,
+// echo cancellation and resampling. Every case is calibrated to a minimum
+// batch time and repeated; the median ns/op is what gets compared.
+//
+// Results go to a table and, with --json, to a JSON document that a later
+// run reads back with --baseline to flag regressions (non-zero exit status).
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QVector>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "client/OpusCodec.h"
+#include "client/audio/AecProcessor.h"
+#include "client/audio/engine_jitter.h"
+#include "client/audio/resampler.h"
+#include "client/control_client.h"
+#include "server/control_server.h"
+#include "server/permission/permission_manager.h"
+#include "shared/protocol/control_wire.h"
+
+// Declared a friend by ControlClient and ControlServer so their private
+// per-packet paths can be driven without sockets.
+struct HotPathBenchAccess {
+    using JitterState = ControlClient::VoiceJitterState;
+    using QueuedFrame = ControlClient::QueuedVoiceFrame;
+
+    static void flush(ControlClient &client, uint32_t ssrc, JitterState &state, qint64 nowMs) {
+        client.flushJitterBuffer(ssrc, state, nowMs);
+    }
+
+    static ClientRegistry &registry(ControlServer &server) { return server.registry_; }
+
+    static void rebuild_forward_index(ControlServer &server, qint64 nowMs) {
+        server.rebuildForwardIndex(nowMs);
+    }
+
+    static int forward_targets(const ControlServer &server, uint32_t source, uint8_t layer) {
+        int matched = 0;
+        const auto routes = server.forwardRoutes_->sources.find(source);
+        if (routes != server.forwardRoutes_->sources.end()) {
+            for (const auto &target : routes->second.targets) {
+                matched += target.layer == layer ? 1 : 0;
+            }
+        }
+        return matched;
+    }
+};
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kFrameSamples = 960; // 20 ms at 48 kHz, as the Qt client sends
+constexpr int kFrameBytes = kFrameSamples * 2;
+constexpr int kSchemaVersion = 1;
+
+// Keeps results observable so the optimizer cannot drop the loops.
+volatile uint64_t g_sink = 0;
+
+struct Options {
+    QString filter;
+    int repetitions = 5;
+    int min_time_ms = 50;
+    QString json_path;
+    QString baseline_path;
+    double max_regression_pct = 10.0;
+};
+
+struct Result {
+    QString id;       // name plus parameters; the key for baseline comparison
+    QString name;
+    QJsonObject params;
+    qint64 iterations = 0;
+    double median_ns = 0.0;
+    double min_ns = 0.0;
+    double max_ns = 0.0;
+    QString skipped;  // Why the case did not run, if it did not
+};
+
+class Suite {
+public:
+    explicit Suite(const Options &options, FILE *table) : options_(options), table_(table) {}
+
+    // `body(n)` performs the operation n times.
+    void run(const QString &name, const QJsonObject &params, const std::function<void(size_t)> &body) {
+        Result result = make_result(name, params);
+        if (!selected(result)) {
+            return;
+        }
+
+        // Grow the batch until one batch takes at least the minimum time.
+        const double min_ns = options_.min_time_ms * 1e6;
+        size_t n = 1;
+        for (;;) {
+            const double elapsed = time_batch(body, n);
+            if (elapsed >= min_ns || n >= (size_t{1} << 40)) {
+                break;
+            }
+            const double grow = elapsed > 0.0 ? std::min(10.0, 1.4 * min_ns / elapsed) : 10.0;
+            n = std::max(n + 1, static_cast<size_t>(static_cast<double>(n) * grow));
+        }
+
+        std::vector<double> per_op;
+        for (int r = 0; r < options_.repetitions; ++r) {
+            per_op.push_back(time_batch(body, n) / static_cast<double>(n));
+        }
+        std::sort(per_op.begin(), per_op.end());
+        result.iterations = static_cast<qint64>(n);
+        result.median_ns = per_op[per_op.size() / 2];
+        result.min_ns = per_op.front();
+        result.max_ns = per_op.back();
+
+        std::fprintf(table_, "%-72s %12.1f ns/op  (min %.1f, max %.1f, %lld iters x %d)\n",
+                     qPrintable(result.id), result.median_ns, result.min_ns, result.max_ns,
+                     static_cast<long long>(result.iterations), options_.repetitions);
+        std::fflush(table_);
+        results_.push_back(result);
+    }
+
+    void skip(const QString &name, const QJsonObject &params, const QString &reason) {
+        Result result = make_result(name, params);
+        if (!selected(result)) {
+            return;
+        }
+        result.skipped = reason;
+        std::fprintf(table_, "%-72s %12s (%s)\n", qPrintable(result.id), "skipped", qPrintable(reason));
+        results_.push_back(result);
+    }
+
+    QJsonDocument to_json() const;
+
+    // Prints the change against `baseline` and returns how many cases got
+    // slower than the allowed regression.
+    int compare(const QJsonDocument &baseline) const;
+
+private:
+    static Result make_result(const QString &name, const QJsonObject &params) {
+        Result result;
+        result.name = name;
+        result.params = params;
+        result.id = name;
+        for (auto it = params.begin(); it != params.end(); ++it) {
+            const QJsonValue value = it.value();
+            result.id += QStringLiteral("/%1=%2").arg(it.key(),
+                                                      value.isString() ? value.toString()
+                                                                       : QString::number(value.toDouble()));
+        }
+        return result;
+    }
+
+    bool selected(const Result &result) const {
+        return options_.filter.isEmpty() || result.id.contains(options_.filter);
+    }
+
+    static double time_batch(const std::function<void(size_t)> &body, size_t n) {
+        const auto start = Clock::now();
+        body(n);
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    const Options &options_;
+    FILE *table_;
+    std::vector<Result> results_;
+};
+
+QJsonDocument Suite::to_json() const {
+    QJsonObject build;
+#if defined(__clang__)
+    build.insert(QStringLiteral("compiler"), QStringLiteral("clang " __clang_version__));
+#elif defined(__GNUC__)
+    build.insert(QStringLiteral("compiler"), QStringLiteral("gcc " __VERSION__));
+#elif defined(_MSC_VER)
+    build.insert(QStringLiteral("compiler"), QStringLiteral("msvc %1").arg(_MSC_VER));
+#endif
+#if defined(NDEBUG)
+    build.insert(QStringLiteral("assertions"), false);
+#else
+    build.insert(QStringLiteral("assertions"), true);
+#endif
+    build.insert(QStringLiteral("qt"), QString::fromLatin1(qVersion()));
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+    build.insert(QStringLiteral("protobuf_control"), true);
+#else
+    build.insert(QStringLiteral("protobuf_control"), false);
+#endif
+#if defined(NOX_HAS_SPEEXDSP_AEC)
+    build.insert(QStringLiteral("speexdsp_aec"), true);
+#else
+    build.insert(QStringLiteral("speexdsp_aec"), false);
+#endif
+
+    QJsonArray results;
+    for (const Result &r : results_) {
+        QJsonObject item;
+        item.insert(QStringLiteral("id"), r.id);
+        item.insert(QStringLiteral("name"), r.name);
+        item.insert(QStringLiteral("params"), r.params);
+        if (!r.skipped.isEmpty()) {
+            item.insert(QStringLiteral("skipped"), r.skipped);
+        } else {
+            item.insert(QStringLiteral("iterations"), static_cast<double>(r.iterations));
+            item.insert(QStringLiteral("repetitions"), options_.repetitions);
+            item.insert(QStringLiteral("ns_per_op"), r.median_ns);
+            item.insert(QStringLiteral("ns_per_op_min"), r.min_ns);
+            item.insert(QStringLiteral("ns_per_op_max"), r.max_ns);
+        }
+        results.push_back(item);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("schema"), kSchemaVersion);
+    root.insert(QStringLiteral("suite"), QStringLiteral("hotpath_bench"));
+    root.insert(QStringLiteral("build"), build);
+    root.insert(QStringLiteral("min_time_ms"), options_.min_time_ms);
+    root.insert(QStringLiteral("results"), results);
+    return QJsonDocument(root);
+}
+
+int Suite::compare(const QJsonDocument &baseline) const {
+    std::map<QString, double> before;
+    for (const QJsonValue &value : baseline.object().value(QStringLiteral("results")).toArray()) {
+        const QJsonObject item = value.toObject();
+        if (item.contains(QStringLiteral("ns_per_op"))) {
+            before[item.value(QStringLiteral("id")).toString()] = item.value(QStringLiteral("ns_per_op")).toDouble();
+        }
+    }
+
+    int regressions = 0;
+    std::fprintf(table_, "\n%-72s %12s %12s %9s\n", "vs baseline", "before", "after", "change");
+    for (const Result &r : results_) {
+        auto it = before.find(r.id);
+        if (!r.skipped.isEmpty() || it == before.end() || it->second <= 0.0) {
+            continue;
+        }
+        const double change = (r.median_ns - it->second) / it->second * 100.0;
+        const bool regressed = change > options_.max_regression_pct;
+        regressions += regressed ? 1 : 0;
+        std::fprintf(table_, "%-72s %12.1f %12.1f %+8.1f%%%s\n", qPrintable(r.id), it->second, r.median_ns,
+                     change, regressed ? "  REGRESSION" : "");
+    }
+    return regressions;
+}
+
+// Voiced-speech stand-in: a few harmonics with slow amplitude modulation and
+// a little noise, so codecs and the echo canceller do representative work.
+std::vector<int16_t> synth_speech(size_t samples, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, 300.0);
+    std::vector<int16_t> out(samples);
+    const double pi = 3.14159265358979323846;
+    for (size_t i = 0; i < samples; ++i) {
+        const double t = static_cast<double>(i) / 48000.0;
+        const double envelope = 0.55 + 0.45 * std::sin(2.0 * pi * 3.0 * t);
+        double s = 0.0;
+        for (int h = 1; h <= 5; ++h) {
+            s += std::sin(2.0 * pi * 140.0 * h * t) / h;
+        }
+        s = s * 6000.0 * envelope + noise(rng);
+        out[i] = static_cast<int16_t>(std::max(-32768.0, std::min(32767.0, s)));
+    }
+    return out;
+}
+
+QVector<QByteArray> pcm_frames(int count, uint32_t seed) {
+    const std::vector<int16_t> samples = synth_speech(static_cast<size_t>(count) * kFrameSamples, seed);
+    QVector<QByteArray> frames;
+    for (int f = 0; f < count; ++f) {
+        frames.push_back(QByteArray(reinterpret_cast<const char *>(samples.data() + f * kFrameSamples), kFrameBytes));
+    }
+    return frames;
+}
+
+void bench_jitter_buffer(Suite &suite) {
+    for (const bool reorder : {false, true}) {
+        // Push one packet, pop one packet: the steady state of a live stream.
+        // With reorder, every pair of packets arrives swapped.
+        JitterBuffer jitter(3, 50);
+        std::vector<uint8_t> payload(80, 0x5A);
+        std::vector<uint8_t> out;
+        uint32_t seq = 0;
+        suite.run(QStringLiteral("jitter_buffer/push_pop"),
+                  {{QStringLiteral("reorder"), reorder ? 1 : 0}},
+                  [&](size_t n) {
+                      uint64_t popped = 0;
+                      for (size_t i = 0; i < n; ++i, ++seq) {
+                          const uint16_t arriving = static_cast<uint16_t>(reorder ? seq ^ 1u : seq);
+                          jitter.push(arriving, payload.data(), payload.size());
+                          popped += jitter.pop(out) ? out.size() : 0;
+                      }
+                      g_sink = popped;
+                  });
+    }
+}
+
+void bench_flush_jitter_buffer(Suite &suite) {
+    OpusCodec encoder;
+    const QVector<QByteArray> pcm = pcm_frames(50, 7);
+    QVector<QByteArray> opus;
+    for (const QByteArray &frame : pcm) {
+        QByteArray payload;
+        if (encoder.encodeFrameHigh(frame, payload)) {
+            opus.push_back(payload);
+        }
+    }
+
+    struct Case {
+        const char *payload;
+        int loss_pct;
+    };
+    for (const Case c : {Case{"pcm", 0}, Case{"opus", 0}, Case{"opus", 5}}) {
+        const bool isOpus = QByteArray(c.payload) == "opus";
+        const QJsonObject params{{QStringLiteral("payload"), QString::fromLatin1(c.payload)},
+                                 {QStringLiteral("loss_pct"), c.loss_pct}};
+        if (isOpus && opus.size() != pcm.size()) {
+            suite.skip(QStringLiteral("control_client/flush_jitter_buffer"), params,
+                       QStringLiteral("Opus encoder unavailable"));
+            continue;
+        }
+
+        // One frame arrives every 20 ms and one flush runs per arrival, so
+        // the buffer settles at its 40 ms playout delay; losses go through
+        // FEC or PLC.
+        ControlClient client;
+        uint64_t delivered = 0;
+        client.set_voice_callback([&delivered](uint32_t, const QByteArray &out) { delivered += out.size(); });
+        HotPathBenchAccess::JitterState state;
+        state.initialized = true;
+        const uint8_t flags = isOpus ? ctrlproto::kVoiceFlagOpus : 0;
+        const QVector<QByteArray> &frames = isOpus ? opus : pcm;
+        const qint64 baseMs = 1000000;
+        const uint32_t ssrc = 4242;
+        uint32_t frame = 0;
+
+        suite.run(QStringLiteral("control_client/flush_jitter_buffer"), params, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i, ++frame) {
+                const qint64 nowMs = baseMs + static_cast<qint64>(frame) * 20;
+                const bool lost = c.loss_pct > 0 && (frame * 7919u) % 100u < static_cast<uint32_t>(c.loss_pct);
+                if (!lost) {
+                    state.pendingFrames.insert(static_cast<uint16_t>(frame), HotPathBenchAccess::QueuedFrame{
+                        flags, frame * 20, nowMs, frames[static_cast<int>(frame % frames.size())]});
+                }
+                HotPathBenchAccess::flush(client, ssrc, state, nowMs);
+            }
+            g_sink = delivered;
+        });
+    }
+}
+
+void bench_permission_manager(Suite &suite) {
+    for (const uint32_t users : {100u, 5000u}) {
+        // Ten channels, everyone muting two others: the checks look at the
+        // mute rows and the channel map, as in real rooms.
+        PermissionManager permissions;
+        std::mt19937 rng(users);
+        for (uint32_t u = 0; u < users; ++u) {
+            permissions.add_user(1000 + u);
+            permissions.set_channel(1000 + u, u % 10);
+        }
+        for (uint32_t u = 0; u < users; ++u) {
+            permissions.mute(1000 + u, 1000 + static_cast<uint32_t>(rng() % users));
+            permissions.mute(1000 + u, 1000 + static_cast<uint32_t>(rng() % users));
+        }
+        std::vector<std::pair<uint32_t, uint32_t>> pairs(4096);
+        for (auto &pair : pairs) {
+            pair = {1000 + static_cast<uint32_t>(rng() % users), 1000 + static_cast<uint32_t>(rng() % users)};
+        }
+
+        size_t next = 0;
+        suite.run(QStringLiteral("permission_manager/can_receive"),
+                  {{QStringLiteral("users"), static_cast<int>(users)}, {QStringLiteral("channels"), 10}},
+                  [&](size_t n) {
+                      uint64_t allowed = 0;
+                      for (size_t i = 0; i < n; ++i) {
+                          const auto &pair = pairs[next++ & (pairs.size() - 1)];
+                          allowed += permissions.can_receive(pair.first, pair.second) ? 1 : 0;
+                      }
+                      g_sink = allowed;
+                  });
+    }
+}
+
+void bench_forward_index(Suite &suite) {
+    for (const int clients : {10, 100, 1000}) {
+        // One room; about 60% of clients spoke inside the active-speaker
+        // window, and every receiver keeps the default four streams.
+        ControlServer server;
+        ClientRegistry &registry = HotPathBenchAccess::registry(server);
+        const qint64 nowMs = 10000000;
+        for (int i = 0; i < clients; ++i) {
+            const uint32_t id = 1000 + static_cast<uint32_t>(i);
+            registry.updateJoin(id, QStringLiteral("user%1").arg(i), QStringLiteral("default"),
+                                QHostAddress(QHostAddress::LocalHost), static_cast<quint16>(40000 + i), nullptr, nowMs);
+            ClientRegistry::ClientState *client = registry.find(id);
+            client->lastAudioMs = nowMs - (static_cast<qint64>(i) * 131) % 4000;
+            client->lastVoicedMs = client->lastAudioMs - (static_cast<qint64>(i) * 977) % 3000;
+        }
+        QVector<uint32_t> sources;
+        registry.forEachOnline([&](const ClientRegistry::ClientState &client) { sources.push_back(client.clientId); });
+
+        suite.run(QStringLiteral("control_server/forward_index_rebuild"),
+                  {{QStringLiteral("clients"), clients}, {QStringLiteral("max_streams"), 4}},
+                  [&](size_t n) {
+                      for (size_t i = 0; i < n; ++i) {
+                          HotPathBenchAccess::rebuild_forward_index(server, nowMs);
+                      }
+                  });
+
+        // What each inbound voice packet now costs: one lookup and a walk
+        // over the source's receivers.
+        HotPathBenchAccess::rebuild_forward_index(server, nowMs);
+        size_t next = 0;
+        suite.run(QStringLiteral("control_server/forward_targets"),
+                  {{QStringLiteral("clients"), clients}, {QStringLiteral("max_streams"), 4}},
+                  [&](size_t n) {
+                      uint64_t matched = 0;
+                      for (size_t i = 0; i < n; ++i) {
+                          const uint32_t source = sources[static_cast<int>(next++ % sources.size())];
+                          matched += HotPathBenchAccess::forward_targets(server, source, ctrlproto::kVoiceLayerHigh);
+                      }
+                      g_sink = matched;
+                  });
+    }
+}
+
+void bench_controlwire(Suite &suite) {
+    QJsonObject feedback;
+    feedback.insert(QStringLiteral("type"), QStringLiteral("voice_feedback"));
+    feedback.insert(QStringLiteral("reporter_ssrc"), 1001.0);
+    feedback.insert(QStringLiteral("source_ssrc"), 1002.0);
+    feedback.insert(QStringLiteral("loss_pct"), 3);
+    feedback.insert(QStringLiteral("jitter_ms"), 12);
+    feedback.insert(QStringLiteral("plc_pct"), 1);
+    feedback.insert(QStringLiteral("fec_pct"), 2);
+    feedback.insert(QStringLiteral("rtt_ms"), 48);
+
+    QJsonArray userList;
+    for (int i = 0; i < 50; ++i) {
+        QJsonObject user;
+        user.insert(QStringLiteral("ssrc"), static_cast<double>(1000 + i));
+        user.insert(QStringLiteral("name"), QStringLiteral("user%1").arg(i));
+        user.insert(QStringLiteral("online"), 1);
+        user.insert(QStringLiteral("room"), QStringLiteral("default"));
+        userList.push_back(user);
+    }
+    QJsonObject users;
+    users.insert(QStringLiteral("type"), QStringLiteral("users"));
+    users.insert(QStringLiteral("users"), userList);
+
+    struct Message {
+        const char *name;
+        const QJsonObject *obj;
+    };
+    struct Format {
+        const char *name;
+        ControlWireFormat format;
+    };
+    for (const Message message : {Message{"voice_feedback", &feedback}, Message{"users50", &users}}) {
+        for (const Format format : {Format{"json", ControlWireFormat::Json}, Format{"protobuf", ControlWireFormat::Protobuf}}) {
+            const QJsonObject params{{QStringLiteral("format"), QString::fromLatin1(format.name)},
+                                     {QStringLiteral("message"), QString::fromLatin1(message.name)}};
+#if !defined(NOX_HAS_PROTOBUF_CONTROL)
+            if (format.format == ControlWireFormat::Protobuf) {
+                suite.skip(QStringLiteral("controlwire/encode"), params, QStringLiteral("built without NOX_HAS_PROTOBUF_CONTROL"));
+                suite.skip(QStringLiteral("controlwire/decode"), params, QStringLiteral("built without NOX_HAS_PROTOBUF_CONTROL"));
+                suite.skip(QStringLiteral("controlwire/decode_typed"), params, QStringLiteral("built without NOX_HAS_PROTOBUF_CONTROL"));
+                continue;
+            }
+#endif
+            const QJsonObject &obj = *message.obj;
+            suite.run(QStringLiteral("controlwire/encode"), params, [&](size_t n) {
+                uint64_t bytes = 0;
+                for (size_t i = 0; i < n; ++i) {
+                    bytes += static_cast<uint64_t>(controlwire::encode(obj, format.format).size());
+                }
+                g_sink = bytes;
+            });
+
+            const QByteArray line = controlwire::encode(obj, format.format);
+            suite.run(QStringLiteral("controlwire/decode"), params, [&](size_t n) {
+                uint64_t decoded = 0;
+                ControlWireMessage out;
+                for (size_t i = 0; i < n; ++i) {
+                    decoded += controlwire::decode(line, out) ? static_cast<uint64_t>(out.json.size()) : 0;
+                }
+                g_sink = decoded;
+            });
+#if defined(NOX_HAS_PROTOBUF_CONTROL)
+            // What the server dispatches on: no QJsonObject for protobuf lines.
+            suite.run(QStringLiteral("controlwire/decode_typed"), params, [&](size_t n) {
+                uint64_t decoded = 0;
+                google::protobuf::Arena arena;
+                auto *env = google::protobuf::Arena::Create<nox::control::v1::ControlEnvelope>(&arena);
+                ControlWireFormat wireFormat = ControlWireFormat::Json;
+                for (size_t i = 0; i < n; ++i) {
+                    env->Clear();
+                    decoded += controlwire::decode(line, *env, wireFormat) ? static_cast<uint64_t>(env->payload_case()) : 0;
+                }
+                g_sink = decoded;
+            });
+#endif
+        }
+    }
+}
+
+void bench_opus(Suite &suite) {
+    OpusCodec codec;
+    const QJsonObject params{{QStringLiteral("frame_ms"), 20}};
+    if (!codec.isReady()) {
+        suite.skip(QStringLiteral("opus_codec/encode_low"), params, QStringLiteral("Opus encoder unavailable"));
+        suite.skip(QStringLiteral("opus_codec/encode_high"), params, QStringLiteral("Opus encoder unavailable"));
+        suite.skip(QStringLiteral("opus_codec/decode"), params, QStringLiteral("Opus encoder unavailable"));
+        return;
+    }
+
+    const QVector<QByteArray> pcm = pcm_frames(50, 11);
+    size_t next = 0;
+    auto encode = [&](bool low) {
+        return [&, low](size_t n) {
+            uint64_t bytes = 0;
+            QByteArray payload;
+            for (size_t i = 0; i < n; ++i) {
+                const QByteArray &frame = pcm[static_cast<int>(next++ % pcm.size())];
+                if (low ? codec.encodeFrameLow(frame, payload) : codec.encodeFrameHigh(frame, payload)) {
+                    bytes += static_cast<uint64_t>(payload.size());
+                }
+            }
+            g_sink = bytes;
+        };
+    };
+    suite.run(QStringLiteral("opus_codec/encode_low"), params, encode(true));
+    suite.run(QStringLiteral("opus_codec/encode_high"), params, encode(false));
+
+    QVector<QByteArray> packets;
+    for (const QByteArray &frame : pcm) {
+        QByteArray payload;
+        if (codec.encodeFrameHigh(frame, payload)) {
+            packets.push_back(payload);
+        }
+    }
+    suite.run(QStringLiteral("opus_codec/decode"), params, [&](size_t n) {
+        uint64_t bytes = 0;
+        QByteArray out;
+        for (size_t i = 0; i < n; ++i) {
+            if (codec.decodeFrame(77, packets[static_cast<int>(next++ % packets.size())], out)) {
+                bytes += static_cast<uint64_t>(out.size());
+            }
+        }
+        g_sink = bytes;
+    });
+}
+
+void bench_aec(Suite &suite) {
+    const QJsonObject params{{QStringLiteral("sample_rate"), 48000}, {QStringLiteral("frame_samples"), kFrameSamples}};
+    AecProcessor aec;
+    if (!aec.initialize(48000, kFrameSamples)) {
+        suite.skip(QStringLiteral("aec_processor/process_frame"), params,
+                   QStringLiteral("built without NOX_HAS_SPEEXDSP_AEC"));
+        return;
+    }
+
+    // The microphone hears the far end 30 ms late and attenuated, plus its
+    // own talker, so the adaptive filter has an echo to track.
+    const QVector<QByteArray> far = pcm_frames(50, 13);
+    const QVector<QByteArray> local = pcm_frames(50, 17);
+    QVector<QByteArray> near;
+    for (int f = 0; f < far.size(); ++f) {
+        const auto *echo = reinterpret_cast<const int16_t *>(far[(f + far.size() - 1) % far.size()].constData());
+        const auto *talk = reinterpret_cast<const int16_t *>(local[f].constData());
+        QByteArray mixed(kFrameBytes, 0);
+        auto *out = reinterpret_cast<int16_t *>(mixed.data());
+        for (int i = 0; i < kFrameSamples; ++i) {
+            const int e = echo[(i + kFrameSamples / 2) % kFrameSamples] / 3;
+            out[i] = static_cast<int16_t>(std::max(-32768, std::min(32767, e + talk[i] / 2)));
+        }
+        near.push_back(mixed);
+    }
+
+    size_t next = 0;
+    suite.run(QStringLiteral("aec_processor/process_frame"), params, [&](size_t n) {
+        uint64_t bytes = 0;
+        for (size_t i = 0; i < n; ++i, ++next) {
+            const int f = static_cast<int>(next % near.size());
+            bytes += static_cast<uint64_t>(aec.processFrame(near[f], far[f]).size());
+        }
+        g_sink = bytes;
+    });
+}
+
+void bench_resampler(Suite &suite) {
+    struct Rates {
+        int in;
+        int out;
+    };
+    for (const Rates rates : {Rates{44100, 48000}, Rates{48000, 16000}}) {
+        // Device callbacks deliver 20 ms at the input rate; playout pops
+        // 20 ms at the output rate.
+        LinearResampler resampler;
+        resampler.set_rates(rates.in, rates.out);
+        const int inFrames = rates.in / 50;
+        const int outFrames = rates.out / 50;
+        const std::vector<int16_t> input = synth_speech(static_cast<size_t>(inFrames), 19);
+        resampler.push(input.data(), inFrames);
+        resampler.push(input.data(), inFrames);
+        std::vector<int16_t> out;
+
+        suite.run(QStringLiteral("linear_resampler/pop"),
+                  {{QStringLiteral("in_rate"), rates.in}, {QStringLiteral("out_rate"), rates.out}},
+                  [&](size_t n) {
+                      uint64_t produced = 0;
+                      for (size_t i = 0; i < n; ++i) {
+                          resampler.push(input.data(), inFrames);
+                          produced += resampler.pop(outFrames, out) ? out.size() : 0;
+                      }
+                      g_sink = produced;
+                  });
+    }
+}
+
+void usage() {
+    std::fprintf(stderr,
+                 "Usage: hotpath_bench [options]\n"
+                 "  --filter TEXT         only cases whose id contains TEXT\n"
+                 "  --repetitions N       timed batches per case; the median is reported (default 5)\n"
+                 "  --min-time-ms N       minimum duration of one batch (default 50)\n"
+                 "  --json FILE           write results as JSON (\"-\" for stdout)\n"
+                 "  --baseline FILE       compare against an earlier --json run\n"
+                 "  --max-regression PCT  slowdown that fails the comparison (default 10)\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    Options options;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args[i];
+        const bool hasValue = i + 1 < args.size();
+        if (arg == QStringLiteral("--filter") && hasValue) {
+            options.filter = args[++i];
+        } else if (arg == QStringLiteral("--repetitions") && hasValue) {
+            options.repetitions = std::max(1, args[++i].toInt());
+        } else if (arg == QStringLiteral("--min-time-ms") && hasValue) {
+            options.min_time_ms = std::max(1, args[++i].toInt());
+        } else if (arg == QStringLiteral("--json") && hasValue) {
+            options.json_path = args[++i];
+        } else if (arg == QStringLiteral("--baseline") && hasValue) {
+            options.baseline_path = args[++i];
+        } else if (arg == QStringLiteral("--max-regression") && hasValue) {
+            options.max_regression_pct = args[++i].toDouble();
+        } else {
+            usage();
+            return 1;
+        }
+    }
+
+    QJsonDocument baseline;
+    if (!options.baseline_path.isEmpty()) {
+        QFile file(options.baseline_path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            std::fprintf(stderr, "cannot read baseline %s\n", qPrintable(options.baseline_path));
+            return 1;
+        }
+        baseline = QJsonDocument::fromJson(file.readAll());
+        if (!baseline.isObject()) {
+            std::fprintf(stderr, "baseline %s is not a hotpath_bench JSON document\n", qPrintable(options.baseline_path));
+            return 1;
+        }
+    }
+
+    // JSON on stdout keeps the table out of the way on stderr.
+    const bool jsonToStdout = options.json_path == QStringLiteral("-");
+    Suite suite(options, jsonToStdout ? stderr : stdout);
+
+    bench_jitter_buffer(suite);
+    bench_flush_jitter_buffer(suite);
+    bench_permission_manager(suite);
+    bench_forward_index(suite);
+    bench_controlwire(suite);
+    bench_opus(suite);
+    bench_aec(suite);
+    bench_resampler(suite);
+
+    if (!options.json_path.isEmpty()) {
+        const QByteArray json = suite.to_json().toJson(QJsonDocument::Indented);
+        if (jsonToStdout) {
+            std::fwrite(json.constData(), 1, static_cast<size_t>(json.size()), stdout);
+        } else {
+            QFile file(options.json_path);
+            if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(json) != json.size()) {
+                std::fprintf(stderr, "cannot write %s\n", qPrintable(options.json_path));
+                return 1;
+            }
+        }
+    }
+
+    if (!baseline.isNull()) {
+        const int regressions = suite.compare(baseline);
+        if (regressions > 0) {
+            std::fprintf(jsonToStdout ? stderr : stdout, "%d case(s) regressed by more than %.1f%%\n",
+                         regressions, options.max_regression_pct);
+            return 2;
+        }
+    }
+    return 0;
+}
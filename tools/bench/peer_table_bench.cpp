@@ -0,0 +1,114 @@
+// 📁 tools/bench/peer_table_bench.cpp
+// PEER TABLE BENCHMARK
+// Compares the SFU's dense PeerTable against the std::map<uint32_t, Peer> it
+// replaced: per-packet SSRC lookup and a full iteration over the hot fields,
+// for 10, 100 and 5000 peers.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sfu/peer_table.h"
+
+namespace {
+
+// Layout of the former SFU::Peer, hot and cold fields interleaved.
+struct LegacyPeer {
+    sockaddr_in addr{};
+    sockaddr_in control_addr{};
+    uint32_t ssrc = 0;
+    uint64_t last_packet_ms = 0;
+    uint64_t last_control_ms = 0;
+    uint64_t join_ms = 0;
+    std::string name;
+    bool has_control = false;
+};
+
+using Clock = std::chrono::steady_clock;
+
+double ns_per_op(Clock::time_point start, Clock::time_point end, size_t ops) {
+    return std::chrono::duration<double, std::nano>(end - start).count() / static_cast<double>(ops);
+}
+
+// Keeps results observable so the optimizer cannot drop the loops.
+volatile uint64_t g_sink = 0;
+
+void run(size_t peer_count) {
+    std::mt19937 rng(static_cast<uint32_t>(peer_count));
+    std::vector<uint32_t> ssrcs(peer_count);
+    for (uint32_t& ssrc : ssrcs) {
+        ssrc = rng();
+    }
+
+    std::map<uint32_t, LegacyPeer> legacy;
+    PeerTable table;
+    for (size_t i = 0; i < peer_count; ++i) {
+        LegacyPeer& peer = legacy[ssrcs[i]];
+        peer.ssrc = ssrcs[i];
+        peer.last_packet_ms = i;
+        peer.name = "user" + std::to_string(i);
+
+        const uint32_t slot = table.insert(ssrcs[i]);
+        table.last_packet_ms(slot) = i;
+        table.cold(slot).name = peer.name;
+    }
+
+    // Packet-arrival order: random senders from the table.
+    constexpr size_t kLookups = 2000000;
+    std::vector<uint32_t> probes(4096);
+    for (uint32_t& probe : probes) {
+        probe = ssrcs[rng() % peer_count];
+    }
+
+    uint64_t sum = 0;
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < kLookups; ++i) {
+        auto it = legacy.find(probes[i & (probes.size() - 1)]);
+        sum += it->second.last_packet_ms;
+    }
+    auto t1 = Clock::now();
+    for (size_t i = 0; i < kLookups; ++i) {
+        const uint32_t slot = table.find(probes[i & (probes.size() - 1)]);
+        sum += table.last_packet_ms(slot);
+    }
+    auto t2 = Clock::now();
+    const double map_lookup = ns_per_op(t0, t1, kLookups);
+    const double table_lookup = ns_per_op(t1, t2, kLookups);
+
+    // Full scans, as in fan-out rebuilds and timeout sweeps.
+    const size_t rounds = std::max<size_t>(1, 20000000 / peer_count);
+    t0 = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (const auto& [ssrc, peer] : legacy) {
+            sum += peer.last_packet_ms ^ ssrc;
+        }
+    }
+    t1 = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        for (uint32_t slot = 0; slot < table.size(); ++slot) {
+            sum += table.last_packet_ms(slot) ^ table.ssrc(slot);
+        }
+    }
+    t2 = Clock::now();
+    const double map_iter = ns_per_op(t0, t1, rounds * peer_count);
+    const double table_iter = ns_per_op(t1, t2, rounds * peer_count);
+    g_sink = sum;
+
+    std::printf("%6zu  %12.2f  %12.2f  %12.3f  %12.3f\n",
+                peer_count, map_lookup, table_lookup, map_iter, table_iter);
+}
+
+} // namespace
+
+int main() {
+    std::printf("%6s  %12s  %12s  %12s  %12s\n",
+                "peers", "map find ns", "table find", "map iter ns", "table iter");
+    for (size_t peers : {10, 100, 5000}) {
+        run(peers);
+    }
+    return 0;
+}
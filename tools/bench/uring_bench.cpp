@@ -0,0 +1,179 @@
+// 📁 tools/bench/uring_bench.cpp
+// IO_URING vs RECVMMSG BENCHMARK
+// Drives the SFU's two media back ends over loopback: one thread floods a
+// receive socket with audio-sized datagrams, the other receives in batches and
+// fans each one out to N sink sockets, exactly like a media worker. Reports
+// forwarded packets per second, receiver CPU per packet and syscalls per copy.
+#include <poll.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sfu/batch_io.h"
+#include "sfu/uring_io.h"
+
+namespace {
+
+constexpr size_t kBatch = 32;
+constexpr size_t kMaxFanOut = 16;
+constexpr int kPacketBytes = 120; // AudioPacket header plus a 20 ms Opus frame
+constexpr auto kRunTime = std::chrono::seconds(2);
+
+struct Result {
+    uint64_t received = 0;
+    uint64_t copies = 0;
+    uint64_t syscalls = 0;
+    double cpu_ns = 0.0;
+    double seconds = 0.0;
+};
+
+SocketHandle bound_socket(sockaddr_in& addr) {
+    SocketHandle s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    addr = sockaddr_in{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(s, reinterpret_cast<sockaddr*>(&addr), &len);
+    int size = 4 << 20;
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+    return s;
+}
+
+double thread_cpu_ns() {
+    timespec ts{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<double>(ts.tv_sec) * 1e9 + static_cast<double>(ts.tv_nsec);
+}
+
+// Receives and fans out until `stop`, through whichever back end `Io` wraps.
+template <typename Io>
+Result forward_loop(Io& io, int wait_fd, const std::vector<sockaddr_in>& sinks, std::atomic<bool>& stop) {
+    Result r;
+    const double cpu0 = thread_cpu_ns();
+    const auto t0 = std::chrono::steady_clock::now();
+    pollfd pfd{wait_fd, POLLIN, 0};
+    while (!stop.load(std::memory_order_relaxed)) {
+        if (poll(&pfd, 1, 50) <= 0) {
+            continue;
+        }
+        ++r.syscalls;
+        int received;
+        while ((received = io.receive()) > 0) {
+            for (int i = 0; i < received; ++i) {
+                const Datagram& d = io.datagram(i);
+                for (const sockaddr_in& to : sinks) {
+                    io.queue(d.data, d.len, to);
+                }
+            }
+            io.flush();
+            r.received += static_cast<uint64_t>(received);
+            r.copies += static_cast<uint64_t>(received) * sinks.size();
+        }
+    }
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    r.cpu_ns = thread_cpu_ns() - cpu0;
+    r.syscalls += io.syscalls();
+    return r;
+}
+
+struct MmsgIo {
+    SocketHandle socket;
+    BatchReceiver rx{kBatch, 2048};
+    BatchSender tx{kBatch * kMaxFanOut};
+
+    int receive() { return rx.receive(socket); }
+    const Datagram& datagram(int i) const { return rx.datagram(i); }
+    void queue(const uint8_t* data, int len, const sockaddr_in& to) { tx.queue(socket, data, len, to); }
+    void flush() { tx.flush(socket); }
+    // The final empty receive() of each drain is a syscall too.
+    uint64_t syscalls() const { return rx.stats().recv_calls + tx.stats().send_calls; }
+};
+
+struct UringIo {
+    SocketHandle socket;
+    UringMediaIo io{kBatch, kBatch * kMaxFanOut, 1024, 2048 + 64};
+
+    int receive() { return io.receive(); }
+    const Datagram& datagram(int i) const { return io.datagram(i); }
+    void queue(const uint8_t* data, int len, const sockaddr_in& to) { io.queue(socket, data, len, to); }
+    void flush() { io.flush(socket); }
+    uint64_t syscalls() const { return io.tx_stats().send_calls; }
+};
+
+Result run(bool use_uring, size_t fan_out) {
+    sockaddr_in rx_addr{};
+    SocketHandle rx_socket = bound_socket(rx_addr);
+    std::vector<SocketHandle> sink_sockets;
+    std::vector<sockaddr_in> sinks(fan_out);
+    for (sockaddr_in& sink : sinks) {
+        sink_sockets.push_back(bound_socket(sink));
+    }
+
+    std::atomic<bool> stop{false};
+    std::thread flood([&]() {
+        SocketHandle s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        uint8_t packet[kPacketBytes] = {};
+        while (!stop.load(std::memory_order_relaxed)) {
+            sendto(s, packet, sizeof(packet), 0, reinterpret_cast<const sockaddr*>(&rx_addr), sizeof(rx_addr));
+        }
+        closesocket(s);
+    });
+    std::thread timer([&]() {
+        std::this_thread::sleep_for(kRunTime);
+        stop.store(true);
+    });
+
+    Result r;
+    if (use_uring) {
+        UringIo io{rx_socket};
+        std::string error;
+        if (io.io.open(rx_socket, error)) {
+            r = forward_loop(io, io.io.fd(), sinks, stop);
+        } else {
+            std::fprintf(stderr, "io_uring unavailable: %s\n", error.c_str());
+            stop.store(true);
+        }
+    } else {
+        MmsgIo io{rx_socket};
+        r = forward_loop(io, rx_socket, sinks, stop);
+    }
+
+    timer.join();
+    flood.join();
+    closesocket(rx_socket);
+    for (SocketHandle s : sink_sockets) {
+        closesocket(s);
+    }
+    return r;
+}
+
+void report(const char* mode, size_t fan_out, const Result& r) {
+    if (r.received == 0) {
+        std::printf("%-9s %7zu  %12s\n", mode, fan_out, "n/a");
+        return;
+    }
+    std::printf("%-9s %7zu  %12.0f  %12.1f  %14.3f\n", mode, fan_out,
+                static_cast<double>(r.received) / r.seconds,
+                r.cpu_ns / static_cast<double>(r.received),
+                static_cast<double>(r.syscalls) / static_cast<double>(r.copies));
+}
+
+} // namespace
+
+int main() {
+    std::printf("%-9s %7s  %12s  %12s  %14s\n", "mode", "fan-out", "rx pkts/s", "cpu ns/pkt", "syscalls/copy");
+    for (size_t fan_out : {1, 4, 16}) {
+        report("recvmmsg", fan_out, run(false, fan_out));
+        report("io_uring", fan_out, run(true, fan_out));
+    }
+    return 0;
+}
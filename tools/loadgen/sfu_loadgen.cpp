@@ -0,0 +1,690 @@
+// 📁 tools/loadgen/sfu_loadgen.cpp
+// SYNTHETIC LOAD GENERATOR for voip_sfu (Linux)
+// Runs thousands of virtual peers from one process against a local SFU. Every
+// peer has its own UDP socket and does what a client does: JOIN and PING on
+// the control port, an endpoint probe, then 50 pps AudioPackets while its
+// talk pattern says so. Payloads carry a send timestamp and sequence number,
+// so each receiving peer measures forwarding latency, loss and reordering.
+// Load is raised level by level; each level is measured on its own.
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "constants.h"
+#include "shared/protocol/control_protocol.h"
+#include "shared/protocol/network_packet.h"
+#include "sfu/sfu_socket.h"
+
+namespace {
+
+constexpr uint32_t kSsrcBase = 0x4C470000;   // "LG" in the high bytes
+constexpr int kPingEveryTicks = 100;         // 2 s at 20 ms ticks; the SFU drops peers after 10 s
+constexpr uint64_t kLatencyRangeUs = 200000; // Histogram resolution is 1 us up to here
+constexpr size_t kRecvBatch = 32;
+constexpr uint16_t kIdleLevel = 0xFFFF;      // Level tag for traffic outside a measurement
+
+enum class Routing { Channel, Talk, Broadcast };
+enum class Pattern { All, Rotate, Burst };
+
+struct Options {
+    std::string server = "127.0.0.1";
+    std::vector<size_t> levels{50, 100, 200, 500};
+    size_t group = 8;
+    Routing routing = Routing::Channel;
+    Pattern pattern = Pattern::Rotate;
+    uint32_t turn_ms = 2000;
+    double duty = 0.3;
+    size_t payload = 80;
+    uint32_t duration_ms = 5000;
+    uint32_t settle_ms = 1000;
+    uint32_t join_rate = 1000;
+    size_t rx_threads = 2;
+    uint16_t metrics_port = 0;
+};
+
+// Leads every audio payload.
+#pragma pack(push, 1)
+struct Stamp {
+    uint64_t sent_ns;
+    uint32_t sender;
+    uint32_t seq;
+    uint16_t level;
+};
+#pragma pack(pop)
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+class LatencyHistogram {
+public:
+    LatencyHistogram() : buckets_(kLatencyRangeUs + 1, 0) {}
+
+    void record(uint64_t us) {
+        ++buckets_[std::min(us, kLatencyRangeUs)];
+        max_ = std::max(max_, us);
+        ++count_;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            buckets_[i] += other.buckets_[i];
+        }
+        max_ = std::max(max_, other.max_);
+        count_ += other.count_;
+    }
+
+    void clear() {
+        std::fill(buckets_.begin(), buckets_.end(), 0);
+        max_ = 0;
+        count_ = 0;
+    }
+
+    uint64_t percentile(double p) const {
+        if (count_ == 0) {
+            return 0;
+        }
+        const uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(count_ - 1));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            seen += buckets_[i];
+            if (seen > rank) {
+                return i;
+            }
+        }
+        return max_;
+    }
+
+    uint64_t max() const { return max_; }
+
+private:
+    std::vector<uint64_t> buckets_;
+    uint64_t max_ = 0;
+    uint64_t count_ = 0;
+};
+
+struct RxTotals {
+    uint64_t received = 0;
+    uint64_t reordered = 0;
+    uint64_t stale = 0; // Copies of packets sent outside the current level
+    LatencyHistogram latency;
+};
+
+struct Peer {
+    SocketHandle socket = INVALID_SOCKET;
+    uint32_t ssrc = 0;
+    uint32_t seq = 0;
+    // Next expected sequence per sender, indexed by the sender's position
+    // in this peer's group. Only the receive thread owning the socket
+    // touches it.
+    std::vector<uint32_t> next_seq;
+    uint16_t seq_level = kIdleLevel;
+};
+
+struct RxThread {
+    int epoll_fd = -1;
+    std::thread thread;
+    std::mutex mutex; // Guards totals between the thread and the reporter
+    RxTotals totals;
+};
+
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const Options& options) : options_(options) {
+        size_t most = 0;
+        for (size_t& level : options_.levels) {
+            level = round_level(level);
+            most = std::max(most, level);
+        }
+        peers_.resize(most);
+        std::memset(&audio_addr_, 0, sizeof(audio_addr_));
+        audio_addr_.sin_family = AF_INET;
+        inet_pton(AF_INET, options_.server.c_str(), &audio_addr_.sin_addr);
+        control_addr_ = audio_addr_;
+        audio_addr_.sin_port = htons(DEFAULT_AUDIO_PORT);
+        control_addr_.sin_port = htons(DEFAULT_CONTROL_PORT);
+    }
+
+    int run();
+
+private:
+    size_t round_level(size_t level) const {
+        if (options_.routing == Routing::Broadcast || options_.group <= 1) {
+            return std::max<size_t>(level, 2);
+        }
+        return (std::max<size_t>(level, 1) + options_.group - 1) / options_.group * options_.group;
+    }
+
+    // Peers a talker's audio should reach at the current size.
+    size_t group_size(size_t active) const {
+        return options_.routing == Routing::Broadcast ? active : options_.group;
+    }
+
+    size_t group_position(size_t index) const {
+        return options_.routing == Routing::Broadcast ? index : index % options_.group;
+    }
+
+    bool talking(size_t index, uint64_t tick, size_t active) const;
+    bool spawn_peer(size_t index);
+    void apply_routes(size_t first, size_t last);
+    void send_control(size_t index, CtrlType type, const void* body, uint16_t size);
+    void sender_loop();
+    void receiver_loop(RxThread& rx);
+    void reset_totals();
+    RxTotals collect_totals();
+    bool scrape(uint64_t& rx_packets, uint64_t& tx_packets, uint64_t& tx_errors) const;
+
+    Options options_;
+    sockaddr_in audio_addr_{};
+    sockaddr_in control_addr_{};
+    std::vector<Peer> peers_; // Sized once; peers [0, active_) are live
+    std::atomic<size_t> active_{0};
+    std::atomic<bool> sending_{false};
+    std::atomic<uint16_t> level_{kIdleLevel};
+    std::atomic<bool> stop_{false};
+    std::atomic<uint64_t> sent_packets_{0};
+    std::atomic<uint64_t> expected_copies_{0};
+    std::atomic<uint64_t> late_ticks_{0};
+    std::vector<std::unique_ptr<RxThread>> rx_threads_;
+};
+
+bool LoadGenerator::talking(size_t index, uint64_t tick, size_t active) const {
+    const uint64_t turn = tick * FRAME_MS / std::max<uint32_t>(1, options_.turn_ms);
+    switch (options_.pattern) {
+        case Pattern::All:
+            return true;
+        case Pattern::Rotate:
+            // One talker per group at a time, handing over every turn.
+            return group_position(index) == turn % group_size(active);
+        case Pattern::Burst: {
+            uint64_t h = (static_cast<uint64_t>(index) << 32) ^ turn;
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            return static_cast<double>(h % 10000) < options_.duty * 10000.0;
+        }
+    }
+    return false;
+}
+
+void LoadGenerator::send_control(size_t index, CtrlType type, const void* body, uint16_t size) {
+    uint8_t packet[CTRL_MAX_DATAGRAM];
+    const CtrlHeader hdr{type, size};
+    std::memcpy(packet, &hdr, sizeof(hdr));
+    if (size > 0) {
+        std::memcpy(packet + sizeof(hdr), body, size);
+    }
+    sendto(peers_[index].socket, packet, sizeof(hdr) + size, 0,
+           reinterpret_cast<const sockaddr*>(&control_addr_), sizeof(control_addr_));
+}
+
+bool LoadGenerator::spawn_peer(size_t index) {
+    Peer& peer = peers_[index];
+    peer.socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (peer.socket == INVALID_SOCKET) {
+        return false;
+    }
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(peer.socket, reinterpret_cast<sockaddr*>(&local), sizeof(local)) == SOCKET_ERROR) {
+        closesocket(peer.socket);
+        peer.socket = INVALID_SOCKET;
+        return false;
+    }
+    int buffer = 1 << 20;
+    setsockopt(peer.socket, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+    fcntl(peer.socket, F_SETFL, fcntl(peer.socket, F_GETFL, 0) | O_NONBLOCK);
+
+    peer.ssrc = kSsrcBase + static_cast<uint32_t>(index);
+    peer.next_seq.assign(options_.routing == Routing::Broadcast ? peers_.size() : options_.group, 0);
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u32 = static_cast<uint32_t>(index);
+    epoll_ctl(rx_threads_[index % rx_threads_.size()]->epoll_fd, EPOLL_CTL_ADD, peer.socket, &event);
+
+    // The same socket carries control and media, so the SFU sees one
+    // endpoint per peer, like a real client behind one NAT binding.
+    CtrlJoin join{};
+    join.ssrc = peer.ssrc;
+    std::snprintf(join.name, sizeof(join.name), "lg%zu", index);
+    send_control(index, CtrlType::JOIN, &join, sizeof(join));
+
+    AudioPacket probe{};
+    probe.ssrc = peer.ssrc;
+    probe.payload_len = 0;
+    sendto(peer.socket, &probe, offsetof(AudioPacket, payload), 0,
+           reinterpret_cast<const sockaddr*>(&audio_addr_), sizeof(audio_addr_));
+    return true;
+}
+
+// Paced like the joins: a burst of route changes can overrun the SFU's
+// control socket, and a peer whose route is lost falls back to broadcast.
+void LoadGenerator::apply_routes(size_t first, size_t last) {
+    const auto start = Clock::now();
+    auto pace = [&](size_t i) {
+        std::this_thread::sleep_until(start + std::chrono::microseconds(
+                                                  (i - first + 1) * 1000000ULL / std::max<uint32_t>(1, options_.join_rate)));
+    };
+    if (options_.routing == Routing::Channel) {
+        for (size_t i = first; i < last; ++i) {
+            pace(i);
+            CtrlSetChannel channel{peers_[i].ssrc, static_cast<uint32_t>(i / options_.group + 1)};
+            send_control(i, CtrlType::SET_CHANNEL, &channel, sizeof(channel));
+        }
+    } else if (options_.routing == Routing::Talk) {
+        uint8_t body[sizeof(CtrlTalk) + 64 * sizeof(uint32_t)];
+        for (size_t i = first; i < last; ++i) {
+            pace(i);
+            const size_t base = i / options_.group * options_.group;
+            CtrlTalk talk{};
+            talk.from = peers_[i].ssrc;
+            uint8_t* p = body + sizeof(talk);
+            for (size_t j = base; j < base + options_.group; ++j) {
+                if (j != i) {
+                    std::memcpy(p, &peers_[j].ssrc, sizeof(uint32_t));
+                    p += sizeof(uint32_t);
+                    ++talk.count;
+                }
+            }
+            std::memcpy(body, &talk, sizeof(talk));
+            send_control(i, CtrlType::TALK, body, static_cast<uint16_t>(p - body));
+        }
+    }
+}
+
+void LoadGenerator::sender_loop() {
+    std::vector<uint8_t> packet(offsetof(AudioPacket, payload) + std::max(options_.payload, sizeof(Stamp)), 0x55);
+    const size_t header_size = offsetof(AudioPacket, payload);
+    auto next = Clock::now();
+    for (uint64_t tick = 0; !stop_.load(std::memory_order_relaxed); ++tick) {
+        const size_t active = active_.load(std::memory_order_acquire);
+        const bool sending = sending_.load(std::memory_order_relaxed);
+        const uint16_t level = level_.load(std::memory_order_relaxed);
+        const size_t fanout = group_size(active) - 1;
+
+        for (size_t i = 0; i < active; ++i) {
+            Peer& peer = peers_[i];
+            if (i % kPingEveryTicks == tick % kPingEveryTicks) {
+                send_control(i, CtrlType::PING, nullptr, 0);
+            }
+            if (!sending || !talking(i, tick, active)) {
+                continue;
+            }
+            AudioPacket hdr{};
+            hdr.ssrc = peer.ssrc;
+            hdr.seq = static_cast<uint16_t>(peer.seq);
+            hdr.timestamp = peer.seq * FRAME_SIZE;
+            hdr.payload_len = static_cast<uint16_t>(packet.size() - header_size);
+            std::memcpy(packet.data(), &hdr, header_size);
+            const Stamp stamp{now_ns(), static_cast<uint32_t>(i), peer.seq++, level};
+            std::memcpy(packet.data() + header_size, &stamp, sizeof(stamp));
+            if (sendto(peer.socket, packet.data(), packet.size(), 0,
+                       reinterpret_cast<const sockaddr*>(&audio_addr_), sizeof(audio_addr_)) > 0) {
+                sent_packets_.fetch_add(1, std::memory_order_relaxed);
+                expected_copies_.fetch_add(fanout, std::memory_order_relaxed);
+            }
+        }
+
+        next += std::chrono::milliseconds(FRAME_MS);
+        const auto now = Clock::now();
+        if (now > next) {
+            late_ticks_.fetch_add(1, std::memory_order_relaxed);
+            if (now - next > std::chrono::milliseconds(FRAME_MS * 5)) {
+                next = now; // Too far behind to catch up; keep the 50 pps cadence from here
+            }
+        }
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void LoadGenerator::receiver_loop(RxThread& rx) {
+    std::vector<uint8_t> buffers(kRecvBatch * 2048);
+    mmsghdr msgs[kRecvBatch];
+    iovec iovs[kRecvBatch];
+    sockaddr_in from[kRecvBatch];
+    epoll_event events[64];
+    RxTotals local;
+    const size_t header_size = offsetof(AudioPacket, payload);
+
+    while (!stop_.load(std::memory_order_relaxed)) {
+        const int ready = epoll_wait(rx.epoll_fd, events, 64, 50);
+        const uint16_t level = level_.load(std::memory_order_relaxed);
+        for (int e = 0; e < ready; ++e) {
+            Peer& peer = peers_[events[e].data.u32];
+            if (peer.seq_level != level) {
+                std::fill(peer.next_seq.begin(), peer.next_seq.end(), 0);
+                peer.seq_level = level;
+            }
+            for (;;) {
+                for (size_t i = 0; i < kRecvBatch; ++i) {
+                    iovs[i] = iovec{buffers.data() + i * 2048, 2048};
+                    std::memset(&msgs[i], 0, sizeof(msgs[i]));
+                    msgs[i].msg_hdr.msg_iov = &iovs[i];
+                    msgs[i].msg_hdr.msg_iovlen = 1;
+                    msgs[i].msg_hdr.msg_name = &from[i];
+                    msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+                }
+                const int n = recvmmsg(peer.socket, msgs, kRecvBatch, MSG_DONTWAIT, nullptr);
+                if (n <= 0) {
+                    break;
+                }
+                const uint64_t arrived = now_ns();
+                for (int i = 0; i < n; ++i) {
+                    // Control replies (PONG, presence) share the socket.
+                    if (from[i].sin_port != audio_addr_.sin_port || msgs[i].msg_len < header_size + sizeof(Stamp)) {
+                        continue;
+                    }
+                    Stamp stamp;
+                    std::memcpy(&stamp, buffers.data() + i * 2048 + header_size, sizeof(stamp));
+                    if (stamp.level != level || level == kIdleLevel) {
+                        ++local.stale;
+                        continue;
+                    }
+                    ++local.received;
+                    local.latency.record(arrived > stamp.sent_ns ? (arrived - stamp.sent_ns) / 1000 : 0);
+                    uint32_t& expected = peer.next_seq[group_position(stamp.sender) % peer.next_seq.size()];
+                    if (stamp.seq < expected) {
+                        ++local.reordered;
+                    } else {
+                        expected = stamp.seq + 1;
+                    }
+                }
+            }
+        }
+        if (local.received || local.stale) {
+            std::lock_guard<std::mutex> lock(rx.mutex);
+            rx.totals.received += local.received;
+            rx.totals.reordered += local.reordered;
+            rx.totals.stale += local.stale;
+            rx.totals.latency.merge(local.latency);
+            local.received = local.reordered = local.stale = 0;
+            local.latency.clear();
+        }
+    }
+}
+
+void LoadGenerator::reset_totals() {
+    for (auto& rx : rx_threads_) {
+        std::lock_guard<std::mutex> lock(rx->mutex);
+        rx->totals.received = rx->totals.reordered = rx->totals.stale = 0;
+        rx->totals.latency.clear();
+    }
+    sent_packets_.store(0);
+    expected_copies_.store(0);
+    late_ticks_.store(0);
+}
+
+RxTotals LoadGenerator::collect_totals() {
+    RxTotals all;
+    for (auto& rx : rx_threads_) {
+        std::lock_guard<std::mutex> lock(rx->mutex);
+        all.received += rx->totals.received;
+        all.reordered += rx->totals.reordered;
+        all.stale += rx->totals.stale;
+        all.latency.merge(rx->totals.latency);
+    }
+    return all;
+}
+
+// Reads the SFU's own counters from its --metrics-port endpoint.
+bool LoadGenerator::scrape(uint64_t& rx_packets, uint64_t& tx_packets, uint64_t& tx_errors) const {
+    if (options_.metrics_port == 0) {
+        return false;
+    }
+    SocketHandle s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in addr = control_addr_;
+    addr.sin_port = htons(options_.metrics_port);
+    if (connect(s, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        closesocket(s);
+        return false;
+    }
+    const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    send(s, request, sizeof(request) - 1, MSG_NOSIGNAL);
+    std::string body;
+    char chunk[4096];
+    pollfd pfd{s, POLLIN, 0};
+    while (poll(&pfd, 1, 1000) > 0) {
+        const ssize_t n = recv(s, chunk, sizeof(chunk), 0);
+        if (n <= 0) {
+            break;
+        }
+        body.append(chunk, static_cast<size_t>(n));
+    }
+    closesocket(s);
+
+    auto value = [&body](const char* name) -> uint64_t {
+        const std::string key = std::string("\n") + name + " ";
+        const size_t at = body.find(key);
+        return at == std::string::npos ? 0 : std::strtoull(body.c_str() + at + key.size(), nullptr, 10);
+    };
+    rx_packets = value("sfu_rx_packets_total");
+    tx_packets = value("sfu_tx_packets_total");
+    tx_errors = value("sfu_tx_errors_total");
+    return body.find("sfu_rx_packets_total") != std::string::npos;
+}
+
+int LoadGenerator::run() {
+    rlimit files{};
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &files);
+    }
+    if (files.rlim_cur < peers_.size() + 64) {
+        std::fprintf(stderr, "need %zu descriptors, limit is %llu\n", peers_.size() + 64,
+                     static_cast<unsigned long long>(files.rlim_cur));
+        return 1;
+    }
+
+    for (size_t i = 0; i < std::max<size_t>(1, options_.rx_threads); ++i) {
+        auto rx = std::make_unique<RxThread>();
+        rx->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        rx_threads_.push_back(std::move(rx));
+    }
+    for (auto& rx : rx_threads_) {
+        RxThread* r = rx.get();
+        r->thread = std::thread([this, r]() { receiver_loop(*r); });
+    }
+    std::thread sender([this]() { sender_loop(); });
+
+    std::printf("%6s %7s %9s %10s %10s %7s %8s %7s %7s %7s %8s %8s %11s %11s\n",
+                "peers", "talkers", "tx pps", "expected", "received", "loss%", "reorder%",
+                "p50us", "p90us", "p99us", "p99.9us", "maxus", "sfu rx pps", "sfu tx pps");
+
+    uint16_t level_id = 0;
+    for (size_t target : options_.levels) {
+        // Ramp up at the join rate; pings start as soon as a peer exists.
+        const size_t first = active_.load();
+        const auto ramp_start = Clock::now();
+        for (size_t i = first; i < target; ++i) {
+            if (!spawn_peer(i)) {
+                std::fprintf(stderr, "could not open socket for peer %zu\n", i);
+                stop_.store(true);
+                break;
+            }
+            active_.store(i + 1, std::memory_order_release);
+            std::this_thread::sleep_until(ramp_start + std::chrono::microseconds(
+                                                           (i - first + 1) * 1000000ULL / std::max<uint32_t>(1, options_.join_rate)));
+        }
+        if (stop_.load()) {
+            break;
+        }
+        apply_routes(first, target);
+        std::this_thread::sleep_for(std::chrono::milliseconds(options_.settle_ms));
+
+        uint64_t srv_rx0 = 0, srv_tx0 = 0, srv_err0 = 0;
+        const bool scraped = scrape(srv_rx0, srv_tx0, srv_err0);
+        reset_totals();
+        level_.store(level_id);
+        sending_.store(true);
+        const auto start = Clock::now();
+        std::this_thread::sleep_for(std::chrono::milliseconds(options_.duration_ms));
+        sending_.store(false);
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        // Let copies still in flight land before counting.
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        uint64_t srv_rx1 = 0, srv_tx1 = 0, srv_err1 = 0;
+        const bool scraped_after = scraped && scrape(srv_rx1, srv_tx1, srv_err1);
+        level_.store(kIdleLevel);
+
+        const RxTotals totals = collect_totals();
+        const uint64_t sent = sent_packets_.load();
+        const uint64_t expected = expected_copies_.load();
+        const double tx_pps = static_cast<double>(sent) / seconds;
+        const double talkers = tx_pps / (1000.0 / FRAME_MS);
+        const double loss = expected ? 100.0 * (1.0 - static_cast<double>(totals.received) / expected) : 0.0;
+        const double reorder = totals.received ? 100.0 * totals.reordered / totals.received : 0.0;
+
+        char srv_rx[16] = "-", srv_tx[16] = "-";
+        if (scraped_after) {
+            std::snprintf(srv_rx, sizeof(srv_rx), "%.0f", (srv_rx1 - srv_rx0) / seconds);
+            std::snprintf(srv_tx, sizeof(srv_tx), "%.0f", (srv_tx1 - srv_tx0) / seconds);
+        }
+        std::printf("%6zu %7.0f %9.0f %10llu %10llu %7.3f %8.3f %7llu %7llu %7llu %8llu %8llu %11s %11s\n",
+                    target, talkers, tx_pps, static_cast<unsigned long long>(expected),
+                    static_cast<unsigned long long>(totals.received), loss, reorder,
+                    static_cast<unsigned long long>(totals.latency.percentile(0.50)),
+                    static_cast<unsigned long long>(totals.latency.percentile(0.90)),
+                    static_cast<unsigned long long>(totals.latency.percentile(0.99)),
+                    static_cast<unsigned long long>(totals.latency.percentile(0.999)),
+                    static_cast<unsigned long long>(totals.latency.max()), srv_rx, srv_tx);
+        if (totals.received > expected) {
+            std::printf("       (more copies than the routes allow: the SFU had not applied every route yet;"
+                        " raise --settle-ms or lower --join-rate)\n");
+        }
+        const uint64_t ticks = std::max<uint64_t>(1, static_cast<uint64_t>(seconds * 1000.0 / FRAME_MS));
+        if (late_ticks_.load() * 100 > ticks) {
+            std::printf("       (sender missed %llu of %llu ticks; the generator itself is saturated)\n",
+                        static_cast<unsigned long long>(late_ticks_.load()), static_cast<unsigned long long>(ticks));
+        }
+        if (scraped_after && srv_err1 > srv_err0) {
+            std::printf("       (sfu reported %llu send errors)\n", static_cast<unsigned long long>(srv_err1 - srv_err0));
+        }
+        std::fflush(stdout);
+        ++level_id;
+    }
+
+    // Leave cleanly so the SFU does not carry the peers until they time out.
+    const size_t active = active_.load();
+    for (size_t i = 0; i < active; ++i) {
+        CtrlLeave leave{peers_[i].ssrc};
+        send_control(i, CtrlType::LEAVE, &leave, sizeof(leave));
+    }
+    stop_.store(true);
+    sender.join();
+    for (auto& rx : rx_threads_) {
+        rx->thread.join();
+        close(rx->epoll_fd);
+    }
+    for (size_t i = 0; i < active; ++i) {
+        closesocket(peers_[i].socket);
+    }
+    return 0;
+}
+
+std::vector<size_t> parse_levels(const char* text) {
+    std::vector<size_t> levels;
+    const char* p = text;
+    while (*p) {
+        char* end = nullptr;
+        const unsigned long value = std::strtoul(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        if (value > 0) {
+            levels.push_back(value);
+        }
+        p = (*end == ',') ? end + 1 : end;
+    }
+    std::sort(levels.begin(), levels.end());
+    return levels;
+}
+
+void usage() {
+    std::fprintf(stderr,
+                 "Usage: sfu_loadgen [options]\n"
+                 "  --server IP          SFU address (default 127.0.0.1)\n"
+                 "  --peers N,N,...      load levels, in peers (default 50,100,200,500)\n"
+                 "  --group N            peers per conversation (default 8, at most 64)\n"
+                 "  --routes MODE        channel | talk | broadcast (default channel)\n"
+                 "  --pattern MODE       all | rotate | burst (default rotate)\n"
+                 "  --turn-ms N          talk turn length for rotate/burst (default 2000)\n"
+                 "  --duty F             share of peers talking per turn for burst (default 0.3)\n"
+                 "  --payload N          audio payload bytes (default 80)\n"
+                 "  --duration-ms N      measurement time per level (default 5000)\n"
+                 "  --settle-ms N        wait after joining before measuring (default 1000)\n"
+                 "  --join-rate N        peers joined per second (default 1000)\n"
+                 "  --rx-threads N       receive threads (default 2)\n"
+                 "  --metrics-port N     also read the SFU's --metrics-port counters\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--server" && has_value) {
+            options.server = argv[++i];
+        } else if (arg == "--peers" && has_value) {
+            options.levels = parse_levels(argv[++i]);
+        } else if (arg == "--group" && has_value) {
+            options.group = std::min<size_t>(64, std::max<long>(1, std::strtol(argv[++i], nullptr, 10)));
+        } else if (arg == "--routes" && has_value) {
+            const std::string mode = argv[++i];
+            options.routing = mode == "talk" ? Routing::Talk : mode == "broadcast" ? Routing::Broadcast : Routing::Channel;
+        } else if (arg == "--pattern" && has_value) {
+            const std::string mode = argv[++i];
+            options.pattern = mode == "all" ? Pattern::All : mode == "burst" ? Pattern::Burst : Pattern::Rotate;
+        } else if (arg == "--turn-ms" && has_value) {
+            options.turn_ms = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--duty" && has_value) {
+            options.duty = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--payload" && has_value) {
+            options.payload = std::min<size_t>(OPUS_MAX_PAYLOAD, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--duration-ms" && has_value) {
+            options.duration_ms = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--settle-ms" && has_value) {
+            options.settle_ms = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--join-rate" && has_value) {
+            options.join_rate = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--rx-threads" && has_value) {
+            options.rx_threads = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--metrics-port" && has_value) {
+            options.metrics_port = static_cast<uint16_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (options.levels.empty()) {
+        usage();
+        return 1;
+    }
+
+    static const char* const kRouting[] = {"channel", "talk", "broadcast"};
+    static const char* const kPattern[] = {"all", "rotate", "burst"};
+    std::printf("sfu_loadgen: server %s, routes=%s group=%zu pattern=%s payload=%zuB, %u ms per level\n",
+                options.server.c_str(), kRouting[static_cast<int>(options.routing)], options.group,
+                kPattern[static_cast<int>(options.pattern)], options.payload, options.duration_ms);
+
+    LoadGenerator generator(options);
+    return generator.run();
+}
@@ -4,7 +4,7 @@ TARGET = voip-client
 QT += core gui widgets network multimedia
 CONFIG += c++17
 
-INCLUDEPATH += $$PWD $$PWD/client $$PWD/shared/protocol $$PWD/thirdparty/opus $$PWD/local-deps/opus/include
+INCLUDEPATH += $$PWD $$PWD/client $$PWD/shared $$PWD/shared/protocol $$PWD/thirdparty/opus $$PWD/local-deps/opus/include
 DEPENDPATH += $$INCLUDEPATH
 
 SOURCES += \
@@ -12,7 +12,8 @@ SOURCES += \
     client/AudioEngine.cpp \
     client/MainWindow.cpp \
     client/OpusCodec.cpp \
-    client/control_client.cpp
+    client/control_client.cpp \
+    shared/utils/Logger.cpp
 
 HEADERS += \
     client/AudioEngine.h \
@@ -20,7 +21,8 @@ HEADERS += \
     client/OpusCodec.h \
     client/control_client.h \
     constants.h \
-    shared/protocol/control_protocol.h
+    shared/protocol/control_protocol.h \
+    shared/utils/Logger.h
 
 FORMS += \
     client/MainWindow.ui
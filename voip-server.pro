@@ -5,14 +5,41 @@ QT += core network
 CONFIG += c++17 console
 CONFIG -= app_bundle
 
-INCLUDEPATH += $$PWD $$PWD/server $$PWD/shared/protocol
+INCLUDEPATH += $$PWD $$PWD/server $$PWD/shared $$PWD/shared/protocol $$PWD/thirdparty/opus $$PWD/local-deps/opus/include
 DEPENDPATH += $$INCLUDEPATH
 
 SOURCES += \
     server/main.cpp \
-    server/control_server.cpp
+    server/control_server.cpp \
+    server/hybrid/client_registry.cpp \
+    server/hybrid/media_plane.cpp \
+    server/hybrid/room_mixer.cpp \
+    server/sfu/batch_io.cpp \
+    server/sfu/reactor.cpp \
+    shared/utils/TimerWheel.cpp
 
 HEADERS += \
     server/control_server.h \
+    server/hybrid/client_registry.h \
+    server/hybrid/media_plane.h \
+    server/hybrid/room_mixer.h \
+    server/sfu/batch_io.h \
+    server/sfu/reactor.h \
+    server/sfu/spsc_ring.h \
     constants.h \
-    shared/protocol/control_protocol.h
+    shared/protocol/control_protocol.h \
+    shared/utils/TimerWheel.h
+
+win32: LIBS += -lws2_32
+
+exists($$PWD/local-deps/opus/opus.lib) {
+    LIBS += $$PWD/local-deps/opus/opus.lib
+} else:exists($$PWD/local-deps/opus/lib/opus.lib) {
+    LIBS += $$PWD/local-deps/opus/lib/opus.lib
+} else:exists($$PWD/thirdparty/opus/opus.lib) {
+    LIBS += $$PWD/thirdparty/opus/opus.lib
+} else:exists($$PWD/thirdparty/opus/win32/opus.lib) {
+    LIBS += $$PWD/thirdparty/opus/win32/opus.lib
+} else {
+    error("Missing Opus library. Expected local-deps/opus or thirdparty/opus")
+}